@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <whitgl/aabb_tree.h>
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+
+#include "../common.h"
+
+// Builds a tree of static colliders bunched into clusters across a huge world
+// and checks region queries, raycasts and nearest queries against brute force.
+// Then moves a set of dynamic boxes a little each frame to count how many
+// leave their grown leaves. Exits non-zero if any result differs.
+
+#define BENCH_STATIC (200000)
+#define BENCH_DYNAMIC (10000)
+#define BENCH_WORLD (1000000)
+#define BENCH_CLUSTERS (64)
+#define BENCH_QUERIES (1000)
+#define BENCH_K (8)
+#define BENCH_FRAMES (60)
+
+whitgl_faabb boxes[BENCH_STATIC+BENCH_DYNAMIC];
+whitgl_fvec velocities[BENCH_DYNAMIC];
+whitgl_fvec clusters[BENCH_CLUSTERS];
+whitgl_int query_out[BENCH_STATIC];
+whitgl_aabb_tree_hit nearest_out[BENCH_K];
+whitgl_aabb_tree_hit brute_nearest[BENCH_K];
+
+// most points sit near a cluster, the rest anywhere
+whitgl_fvec random_point(whitgl_random_seed* seed)
+{
+	whitgl_fvec p;
+	if(whitgl_random_float(seed) < 0.1)
+	{
+		p.x = whitgl_random_float(seed)*BENCH_WORLD;
+		p.y = whitgl_random_float(seed)*BENCH_WORLD;
+		return p;
+	}
+	whitgl_fvec centre = clusters[whitgl_random_int(seed, BENCH_CLUSTERS)];
+	p.x = centre.x + (whitgl_random_float(seed)+whitgl_random_float(seed)-1)*5000;
+	p.y = centre.y + (whitgl_random_float(seed)+whitgl_random_float(seed)-1)*5000;
+	return p;
+}
+
+whitgl_faabb random_box(whitgl_random_seed* seed)
+{
+	whitgl_faabb box;
+	box.a = random_point(seed);
+	box.b.x = box.a.x + 1 + whitgl_random_float(seed)*40;
+	box.b.y = box.a.y + 1 + whitgl_random_float(seed)*40;
+	return box;
+}
+
+whitgl_float sqdistance(whitgl_faabb box, whitgl_fvec p)
+{
+	whitgl_float dx = whitgl_fmax(whitgl_fmax(box.a.x-p.x, p.x-box.b.x), 0);
+	whitgl_float dy = whitgl_fmax(whitgl_fmax(box.a.y-p.y, p.y-box.b.y), 0);
+	return dx*dx + dy*dy;
+}
+
+void fail(const char* what, whitgl_int query)
+{
+	printf("%s %d differs from brute force\n", what, (int)query);
+	bench_failures++;
+}
+
+whitgl_aabb_tree_hit brute_raycast(whitgl_int count, whitgl_fvec start, whitgl_fvec speed, whitgl_float max_t)
+{
+	whitgl_aabb_tree_hit hit = whitgl_aabb_tree_hit_zero;
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_float t1, t2;
+		if(!whitgl_ray_faabb_intersect(boxes[i], start, speed, &t1, &t2))
+			continue;
+		if(t2 < 0 || t1 > max_t)
+			continue;
+		t1 = whitgl_fmax(t1, 0);
+		if(hit.id == -1 || t1 < hit.t)
+		{
+			hit.id = i;
+			hit.t = t1;
+		}
+	}
+	return hit;
+}
+
+void brute_nearest_k(whitgl_int count, whitgl_fvec p)
+{
+	whitgl_int found = 0;
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_float d = sqdistance(boxes[i], p);
+		if(found == BENCH_K && d >= brute_nearest[BENCH_K-1].t)
+			continue;
+		whitgl_int j = found < BENCH_K ? found++ : BENCH_K-1;
+		while(j > 0 && brute_nearest[j-1].t > d)
+		{
+			brute_nearest[j] = brute_nearest[j-1];
+			j--;
+		}
+		brute_nearest[j].id = i;
+		brute_nearest[j].t = d;
+	}
+	for(i=0; i<found; i++)
+		brute_nearest[i].t = whitgl_fsqrt(brute_nearest[i].t);
+}
+
+int main()
+{
+	whitgl_random_seed seed = whitgl_random_seed_init(7);
+	whitgl_int i, q;
+	for(i=0; i<BENCH_CLUSTERS; i++)
+	{
+		clusters[i].x = whitgl_random_float(&seed)*BENCH_WORLD;
+		clusters[i].y = whitgl_random_float(&seed)*BENCH_WORLD;
+	}
+	for(i=0; i<BENCH_STATIC; i++)
+		boxes[i] = random_box(&seed);
+
+	whitgl_aabb_tree_setup setup = whitgl_aabb_tree_setup_zero;
+	setup.max_objects = BENCH_STATIC+BENCH_DYNAMIC;
+	setup.margin = 0;
+	whitgl_aabb_tree* tree = whitgl_aabb_tree_create(setup);
+	uint64_t start = whitgl_profile_now_ns();
+	for(i=0; i<BENCH_STATIC; i++)
+		whitgl_aabb_tree_insert(tree, i, boxes[i]);
+	printf("%d static boxes  build %7.2fms  height %d\n", BENCH_STATIC, bench_ms_since(start), (int)whitgl_aabb_tree_height(tree));
+
+	whitgl_float tree_ms = 0;
+	whitgl_float brute_ms = 0;
+	for(q=0; q<BENCH_QUERIES; q++)
+	{
+		whitgl_faabb region;
+		region.a = random_point(&seed);
+		region.b.x = region.a.x + whitgl_random_float(&seed)*2000;
+		region.b.y = region.a.y + whitgl_random_float(&seed)*2000;
+		start = whitgl_profile_now_ns();
+		whitgl_int found = whitgl_aabb_tree_query_region(tree, region, query_out, BENCH_STATIC);
+		tree_ms += bench_ms_since(start);
+		start = whitgl_profile_now_ns();
+		whitgl_int expected = 0;
+		for(i=0; i<BENCH_STATIC; i++)
+			if(whitgl_faabb_intersects(boxes[i], region))
+				expected++;
+		brute_ms += bench_ms_since(start);
+		if(found != expected)
+			fail("region query", q);
+	}
+	printf("%d region queries  %7.2fms  brute %8.2fms  x%7.1f\n", BENCH_QUERIES, tree_ms, brute_ms, brute_ms/tree_ms);
+
+	tree_ms = 0;
+	brute_ms = 0;
+	whitgl_int hits = 0;
+	for(q=0; q<BENCH_QUERIES; q++)
+	{
+		whitgl_fvec from = random_point(&seed);
+		whitgl_fvec speed = whitgl_angle_to_fvec(whitgl_random_float(&seed)*whitgl_tau);
+		whitgl_float length = whitgl_random_float(&seed)*20000;
+		whitgl_aabb_tree_hit hit;
+		start = whitgl_profile_now_ns();
+		hits += whitgl_aabb_tree_raycast(tree, from, speed, length, &hit);
+		tree_ms += bench_ms_since(start);
+		start = whitgl_profile_now_ns();
+		whitgl_aabb_tree_hit expected = brute_raycast(BENCH_STATIC, from, speed, length);
+		brute_ms += bench_ms_since(start);
+		if(hit.id != expected.id || hit.t != expected.t)
+			fail("raycast", q);
+	}
+	printf("%d raycasts %d hit  %7.2fms  brute %8.2fms  x%7.1f\n", BENCH_QUERIES, (int)hits, tree_ms, brute_ms, brute_ms/tree_ms);
+
+	tree_ms = 0;
+	brute_ms = 0;
+	for(q=0; q<BENCH_QUERIES; q++)
+	{
+		whitgl_fvec p = random_point(&seed);
+		start = whitgl_profile_now_ns();
+		whitgl_int found = whitgl_aabb_tree_nearest(tree, p, nearest_out, BENCH_K);
+		tree_ms += bench_ms_since(start);
+		start = whitgl_profile_now_ns();
+		brute_nearest_k(BENCH_STATIC, p);
+		brute_ms += bench_ms_since(start);
+		if(found != BENCH_K)
+			fail("nearest count", q);
+		for(i=0; i<found; i++)
+			if(nearest_out[i].id != brute_nearest[i].id || nearest_out[i].t != brute_nearest[i].t)
+				break;
+		if(i != found)
+			fail("nearest", q);
+	}
+	printf("%d nearest %d  %7.2fms  brute %8.2fms  x%7.1f\n", BENCH_QUERIES, BENCH_K, tree_ms, brute_ms, brute_ms/tree_ms);
+
+	// dynamic boxes moving up to 2 units a frame, against the default margin
+	whitgl_aabb_tree_destroy(tree);
+	setup.margin = whitgl_aabb_tree_setup_zero.margin;
+	tree = whitgl_aabb_tree_create(setup);
+	for(i=0; i<BENCH_STATIC; i++)
+		whitgl_aabb_tree_insert(tree, i, boxes[i]);
+	for(i=0; i<BENCH_DYNAMIC; i++)
+	{
+		whitgl_int id = BENCH_STATIC+i;
+		boxes[id] = random_box(&seed);
+		velocities[i] = whitgl_fvec_scale_val(whitgl_angle_to_fvec(whitgl_random_float(&seed)*whitgl_tau), whitgl_random_float(&seed)*2);
+		whitgl_aabb_tree_insert(tree, id, boxes[id]);
+	}
+	whitgl_int reinserts = 0;
+	start = whitgl_profile_now_ns();
+	whitgl_int frame;
+	for(frame=0; frame<BENCH_FRAMES; frame++)
+	{
+		for(i=0; i<BENCH_DYNAMIC; i++)
+		{
+			whitgl_int id = BENCH_STATIC+i;
+			boxes[id] = whitgl_faabb_add(boxes[id], velocities[i]);
+			reinserts += whitgl_aabb_tree_update(tree, id, boxes[id]);
+		}
+	}
+	whitgl_float update_ms = bench_ms_since(start);
+	printf("%d dynamic boxes %d frames  update %7.2fms  reinserted %.1f%%  height %d\n",
+		BENCH_DYNAMIC, BENCH_FRAMES, update_ms, reinserts*100.0/(BENCH_DYNAMIC*BENCH_FRAMES), (int)whitgl_aabb_tree_height(tree));
+	for(q=0; q<BENCH_QUERIES/10; q++)
+	{
+		whitgl_fvec p = random_point(&seed);
+		whitgl_int found = whitgl_aabb_tree_query_point(tree, p, query_out, BENCH_STATIC);
+		whitgl_int expected = 0;
+		for(i=0; i<BENCH_STATIC+BENCH_DYNAMIC; i++)
+			if(whitgl_fvec_point_in_rect(p, boxes[i]))
+				expected++;
+		if(found != expected)
+			fail("point query", q);
+		whitgl_fvec speed = whitgl_angle_to_fvec(whitgl_random_float(&seed)*whitgl_tau);
+		whitgl_aabb_tree_hit hit;
+		whitgl_aabb_tree_raycast(tree, p, speed, 5000, &hit);
+		whitgl_aabb_tree_hit brute = brute_raycast(BENCH_STATIC+BENCH_DYNAMIC, p, speed, 5000);
+		if(hit.id != brute.id || hit.t != brute.t)
+			fail("moving raycast", q);
+	}
+	whitgl_aabb_tree_destroy(tree);
+
+	return bench_exit("results differ");
+}
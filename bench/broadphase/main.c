@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <whitgl/broadphase.h>
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+
+#include "../common.h"
+
+// Finds overlapping pairs among randomly placed boxes with the broadphase and
+// by testing every pair, at a few object counts with the same density. Also
+// checks region and point queries against brute force. Above BENCH_BRUTE_MAX
+// objects only the pairs of a sample of objects are checked, and the brute
+// force isn't timed. Exits non-zero if any result differs.
+
+#define BENCH_MAX_PAIRS_PER_OBJECT (8)
+#define BENCH_QUERIES (1000)
+#define BENCH_BRUTE_MAX (10000)
+#define BENCH_SAMPLE (1000)
+
+whitgl_faabb* boxes;
+whitgl_broadphase_pair* pairs;
+whitgl_broadphase_pair* brute_pairs;
+whitgl_bool* checked;
+whitgl_int query_out[4096];
+
+int pair_compare(const void* a, const void* b)
+{
+	const whitgl_broadphase_pair* pa = a;
+	const whitgl_broadphase_pair* pb = b;
+	if(pa->a != pb->a)
+		return pa->a < pb->a ? -1 : 1;
+	if(pa->b != pb->b)
+		return pa->b < pb->b ? -1 : 1;
+	return 0;
+}
+
+// Every pair with a checked object in it, in order
+whitgl_int brute_force_pairs(whitgl_int count, whitgl_int max_out)
+{
+	whitgl_int found = 0;
+	whitgl_int i, j;
+	for(i=0; i<count; i++)
+	{
+		if(!checked[i])
+			continue;
+		for(j=0; j<count; j++)
+		{
+			if(j == i || (checked[j] && j < i))
+				continue;
+			if(!whitgl_faabb_intersects(boxes[i], boxes[j]))
+				continue;
+			if(found < max_out)
+			{
+				brute_pairs[found].a = whitgl_imin(i, j);
+				brute_pairs[found].b = whitgl_imax(i, j);
+			}
+			found++;
+		}
+	}
+	if(found <= max_out)
+		qsort(brute_pairs, found, sizeof(whitgl_broadphase_pair), pair_compare);
+	return found;
+}
+
+void fail(const char* what, whitgl_int count)
+{
+	printf("%d objects: %s differs from brute force\n", (int)count, what);
+	bench_failures++;
+}
+
+void bench(whitgl_int count)
+{
+	// about one box per 24x24 area whatever the count
+	whitgl_float world = whitgl_fsqrt(count)*24;
+	whitgl_random_seed seed = whitgl_random_seed_init(count);
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_fvec size = {4+whitgl_random_float(&seed)*8, 4+whitgl_random_float(&seed)*8};
+		boxes[i].a.x = whitgl_random_float(&seed)*world;
+		boxes[i].a.y = whitgl_random_float(&seed)*world;
+		boxes[i].b = whitgl_fvec_add(boxes[i].a, size);
+	}
+	whitgl_broadphase_setup setup = whitgl_broadphase_setup_zero;
+	setup.cell_size = 16;
+	setup.num_buckets = count*2;
+	setup.max_objects = count;
+	whitgl_broadphase* bp = whitgl_broadphase_create(setup);
+	whitgl_int max_pairs = count*BENCH_MAX_PAIRS_PER_OBJECT;
+
+	uint64_t start = whitgl_profile_now_ns();
+	for(i=0; i<count; i++)
+		whitgl_broadphase_insert(bp, i, boxes[i]);
+	whitgl_float insert_ms = bench_ms_since(start);
+
+	// one step of movement, most boxes stay in the same cells
+	start = whitgl_profile_now_ns();
+	for(i=0; i<count; i++)
+	{
+		whitgl_fvec move = {(i%3)-1, ((i/3)%3)-1};
+		boxes[i] = whitgl_faabb_add(boxes[i], move);
+		whitgl_broadphase_update(bp, i, boxes[i]);
+	}
+	whitgl_float update_ms = bench_ms_since(start);
+
+	start = whitgl_profile_now_ns();
+	whitgl_int num_pairs = whitgl_broadphase_pairs(bp, pairs, max_pairs);
+	whitgl_float pairs_ms = bench_ms_since(start);
+
+	whitgl_bool sampled = count > BENCH_BRUTE_MAX;
+	for(i=0; i<count; i++)
+		checked[i] = !sampled || i%(count/BENCH_SAMPLE) == 0;
+	start = whitgl_profile_now_ns();
+	whitgl_int num_brute = brute_force_pairs(count, max_pairs);
+	whitgl_float brute_ms = bench_ms_since(start);
+
+	// keep the grid's pairs the brute force also looked at
+	whitgl_int num_checked = 0;
+	for(i=0; i<num_pairs && i<max_pairs; i++)
+		if(checked[pairs[i].a] || checked[pairs[i].b])
+			pairs[num_checked++] = pairs[i];
+	if(num_checked != num_brute || num_pairs > max_pairs)
+		fail("pair count", count);
+	else
+	{
+		qsort(pairs, num_checked, sizeof(whitgl_broadphase_pair), pair_compare);
+		for(i=0; i<num_checked; i++)
+			if(pairs[i].a != brute_pairs[i].a || pairs[i].b != brute_pairs[i].b)
+				break;
+		if(i != num_checked)
+			fail("pair list", count);
+	}
+
+	whitgl_float query_ms = 0;
+	whitgl_float brute_query_ms = 0;
+	for(i=0; i<BENCH_QUERIES; i++)
+	{
+		whitgl_faabb region;
+		region.a.x = whitgl_random_float(&seed)*world;
+		region.a.y = whitgl_random_float(&seed)*world;
+		region.b.x = region.a.x + whitgl_random_float(&seed)*64;
+		region.b.y = region.a.y + whitgl_random_float(&seed)*64;
+		start = whitgl_profile_now_ns();
+		whitgl_int found = whitgl_broadphase_query_region(bp, region, query_out, 4096);
+		query_ms += bench_ms_since(start);
+		start = whitgl_profile_now_ns();
+		whitgl_int expected = 0;
+		whitgl_int j;
+		for(j=0; j<count; j++)
+			if(whitgl_faabb_intersects(boxes[j], region))
+				expected++;
+		brute_query_ms += bench_ms_since(start);
+		if(found != expected)
+		{
+			fail("region query", count);
+			break;
+		}
+		whitgl_fvec point = region.a;
+		found = whitgl_broadphase_query_point(bp, point, query_out, 4096);
+		expected = 0;
+		for(j=0; j<count; j++)
+			if(whitgl_fvec_point_in_rect(point, boxes[j]))
+				expected++;
+		if(found != expected)
+		{
+			fail("point query", count);
+			break;
+		}
+	}
+
+	printf("%6d objects %6d pairs  insert %7.2fms  update %7.2fms  pairs %7.2fms",
+		(int)count, (int)num_pairs, insert_ms, update_ms, pairs_ms);
+	if(sampled)
+		printf("  brute checked %d objects\n", (int)BENCH_SAMPLE);
+	else
+		printf("  brute %9.2fms  x%7.1f\n", brute_ms, brute_ms/pairs_ms);
+	printf("%6d objects %d region queries  %7.2fms  brute %9.2fms  x%7.1f\n",
+		(int)count, BENCH_QUERIES, query_ms, brute_query_ms, brute_query_ms/query_ms);
+	whitgl_broadphase_destroy(bp);
+}
+
+int main()
+{
+	const whitgl_int counts[] = {1000, 10000, 100000};
+	const whitgl_int max_count = 100000;
+	boxes = malloc(sizeof(whitgl_faabb)*max_count);
+	pairs = malloc(sizeof(whitgl_broadphase_pair)*max_count*BENCH_MAX_PAIRS_PER_OBJECT);
+	brute_pairs = malloc(sizeof(whitgl_broadphase_pair)*max_count*BENCH_MAX_PAIRS_PER_OBJECT);
+	checked = malloc(sizeof(whitgl_bool)*max_count);
+	whitgl_int i;
+	for(i=0; i<(whitgl_int)(sizeof(counts)/sizeof(counts[0])); i++)
+		bench(counts[i]);
+	free(boxes);
+	free(pairs);
+	free(brute_pairs);
+	free(checked);
+	return bench_exit("results differ");
+}
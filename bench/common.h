@@ -0,0 +1,47 @@
+#ifndef WHITGL_BENCH_COMMON_H_
+#define WHITGL_BENCH_COMMON_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+
+// Timing and pass/fail bookkeeping for the benchmarks that check their
+// results. Include from one file per benchmark.
+
+static int bench_failures = 0;
+
+static inline whitgl_float bench_ns_per(uint64_t start, whitgl_int ops)
+{
+	return (whitgl_profile_now_ns()-start)/(whitgl_float)ops;
+}
+
+static inline whitgl_float bench_ms_since(uint64_t start)
+{
+	return (whitgl_profile_now_ns()-start)/1000000.0;
+}
+
+// Counts a failed check and passes the result through
+static inline whitgl_bool bench_expect(whitgl_bool ok)
+{
+	if(!ok)
+		bench_failures++;
+	return ok;
+}
+
+// Start of a result line timing a kernel against its reference
+static inline void bench_print_speedup(const char* name, whitgl_float ref_ns, whitgl_float ns)
+{
+	printf("%-22s ref %7.2fns  now %7.2fns  x%5.2f", name, ref_ns, ns, ref_ns/ns);
+}
+
+// Exit status for main, printing how many checks failed if any did
+static inline int bench_exit(const char* failed)
+{
+	if(bench_failures)
+		printf("%d %s\n", bench_failures, failed);
+	return bench_failures ? 1 : 0;
+}
+
+#endif // WHITGL_BENCH_COMMON_H_
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+
+#include "../common.h"
+
+// Times the matrix kernels in math.c against plain C references, and checks
+// they agree. Exits non-zero if any result is out of tolerance.
+
+#define BENCH_COUNT (5000)
+#define BENCH_REPEATS (200)
+
+whitgl_fmat mats_a[BENCH_COUNT];
+whitgl_fmat mats_b[BENCH_COUNT];
+whitgl_fmat mats_out[BENCH_COUNT];
+whitgl_fmat mats_ref[BENCH_COUNT];
+whitgl_fvec3 points[BENCH_COUNT];
+whitgl_fvec3 points_out[BENCH_COUNT];
+whitgl_fvec3 points_ref[BENCH_COUNT];
+whitgl_fvec3 positions[BENCH_COUNT];
+whitgl_quat rotations[BENCH_COUNT];
+whitgl_fvec3 scales[BENCH_COUNT];
+
+__attribute__((noinline)) whitgl_fmat ref_multiply(whitgl_fmat a, whitgl_fmat b)
+{
+	whitgl_fmat o;
+	whitgl_int i, j, k;
+	for(j=0; j<4; j++)
+	{
+		for(i=0; i<4; i++)
+		{
+			float sum = a.mat[i] * b.mat[j*4];
+			for(k=1; k<4; k++)
+				sum = sum + a.mat[k*4+i] * b.mat[j*4+k];
+			o.mat[j*4+i] = sum;
+		}
+	}
+	return o;
+}
+
+// Gauss-Jordan in double as an independent check
+__attribute__((noinline)) whitgl_fmat ref_invert(whitgl_fmat m)
+{
+	double a[4][8];
+	whitgl_int r, c, k;
+	for(r=0; r<4; r++)
+		for(c=0; c<4; c++)
+		{
+			a[r][c] = m.mat[c*4+r];
+			a[r][c+4] = r == c ? 1 : 0;
+		}
+	for(c=0; c<4; c++)
+	{
+		whitgl_int pivot = c;
+		for(r=c+1; r<4; r++)
+			if(whitgl_fabs(a[r][c]) > whitgl_fabs(a[pivot][c]))
+				pivot = r;
+		for(k=0; k<8; k++)
+		{
+			double t = a[c][k]; a[c][k] = a[pivot][k]; a[pivot][k] = t;
+		}
+		double inv = 1.0/a[c][c];
+		for(k=0; k<8; k++)
+			a[c][k] *= inv;
+		for(r=0; r<4; r++)
+		{
+			if(r == c)
+				continue;
+			double f = a[r][c];
+			for(k=0; k<8; k++)
+				a[r][k] -= f*a[c][k];
+		}
+	}
+	whitgl_fmat o;
+	for(r=0; r<4; r++)
+		for(c=0; c<4; c++)
+			o.mat[c*4+r] = a[r][c+4];
+	return o;
+}
+
+__attribute__((noinline)) whitgl_fvec3 ref_apply(whitgl_fvec3 v, whitgl_fmat m)
+{
+	whitgl_fvec3 out;
+	out.x = m.mat[0]*v.x + m.mat[4]*v.y + m.mat[8]*v.z + m.mat[12];
+	out.y = m.mat[1]*v.x + m.mat[5]*v.y + m.mat[9]*v.z + m.mat[13];
+	out.z = m.mat[2]*v.x + m.mat[6]*v.y + m.mat[10]*v.z + m.mat[14];
+	return out;
+}
+
+whitgl_float max_error(const float* a, const float* b, whitgl_int count)
+{
+	whitgl_float worst = 0;
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_float scale = whitgl_fmax(1, whitgl_fabs(b[i]));
+		worst = whitgl_fmax(worst, whitgl_fabs(a[i]-b[i])/scale);
+	}
+	return worst;
+}
+
+whitgl_float max_error_fvec3(const whitgl_fvec3* a, const whitgl_fvec3* b, whitgl_int count)
+{
+	whitgl_float worst = 0;
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		worst = whitgl_fmax(worst, whitgl_fabs(a[i].x-b[i].x));
+		worst = whitgl_fmax(worst, whitgl_fabs(a[i].y-b[i].y));
+		worst = whitgl_fmax(worst, whitgl_fabs(a[i].z-b[i].z));
+	}
+	return worst;
+}
+
+void report(const char* name, whitgl_float ref_ns, whitgl_float ns, whitgl_float error, whitgl_float tolerance)
+{
+	whitgl_bool ok = bench_expect(error <= tolerance);
+	bench_print_speedup(name, ref_ns, ns);
+	printf("  error %.2g %s\n", error, ok ? "ok" : "OUT OF TOLERANCE");
+}
+
+int main()
+{
+	whitgl_random_seed seed = whitgl_random_seed_init(42);
+	whitgl_int i, r;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		whitgl_fvec3 axis = {whitgl_random_float(&seed)-0.5, whitgl_random_float(&seed)-0.5, whitgl_random_float(&seed)+0.1};
+		axis = whitgl_fvec3_normalize(axis);
+		rotations[i] = whitgl_quat_rotate(whitgl_random_float(&seed)*whitgl_tau, axis);
+		positions[i].x = whitgl_random_float(&seed)*200-100;
+		positions[i].y = whitgl_random_float(&seed)*200-100;
+		positions[i].z = whitgl_random_float(&seed)*200-100;
+		scales[i].x = whitgl_random_float(&seed)*2+0.5;
+		scales[i].y = whitgl_random_float(&seed)*2+0.5;
+		scales[i].z = whitgl_random_float(&seed)*2+0.5;
+		points[i].x = whitgl_random_float(&seed)*20-10;
+		points[i].y = whitgl_random_float(&seed)*20-10;
+		points[i].z = whitgl_random_float(&seed)*20-10;
+	}
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		whitgl_fmat m = whitgl_fmat_translate(positions[i]);
+		m = whitgl_fmat_multiply(m, whitgl_quat_to_fmat(rotations[i]));
+		mats_ref[i] = whitgl_fmat_multiply(m, whitgl_fmat_scale(scales[i]));
+	}
+	whitgl_fmat_model_array(positions, rotations, scales, mats_a, BENCH_COUNT);
+	whitgl_float model_error = max_error(mats_a[0].mat, mats_ref[0].mat, 16*BENCH_COUNT);
+	printf("%-22s error %.2g %s\n", "model_array check", model_error, bench_expect(model_error <= 1e-5) ? "ok" : "OUT OF TOLERANCE");
+
+	whitgl_fmat camera = whitgl_fmat_multiply(whitgl_fmat_perspective(whitgl_pi/3, 1.5, 0.1, 100), whitgl_fmat_rot_y(0.3));
+	for(i=0; i<BENCH_COUNT; i++)
+		mats_b[i] = mats_a[(i*7)%BENCH_COUNT];
+
+	uint64_t start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			mats_ref[i] = ref_multiply(mats_a[i], mats_b[i]);
+	whitgl_float ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			mats_out[i] = whitgl_fmat_multiply(mats_a[i], mats_b[i]);
+	report("fmat_multiply", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error(mats_out[0].mat, mats_ref[0].mat, 16*BENCH_COUNT), 0);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		whitgl_fmat_multiply_array(mats_a, mats_b, mats_out, BENCH_COUNT);
+	report("fmat_multiply_array", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error(mats_out[0].mat, mats_ref[0].mat, 16*BENCH_COUNT), 0);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		whitgl_fmat_premultiply_array(camera, mats_a, mats_out, BENCH_COUNT);
+	for(i=0; i<BENCH_COUNT; i++)
+		mats_ref[i] = ref_multiply(camera, mats_a[i]);
+	report("fmat_premultiply_array", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error(mats_out[0].mat, mats_ref[0].mat, 16*BENCH_COUNT), 0);
+
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			mats_ref[i] = ref_invert(mats_a[i]);
+	ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			mats_out[i] = whitgl_fmat_invert(mats_a[i]);
+	report("fmat_invert", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error(mats_out[0].mat, mats_ref[0].mat, 16*BENCH_COUNT), 1e-4);
+
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			points_ref[i] = ref_apply(points[i], mats_a[0]);
+	ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			points_out[i] = whitgl_fvec3_apply_fmat(points[i], mats_a[0]);
+	report("fvec3_apply_fmat", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error_fvec3(points_out, points_ref, BENCH_COUNT), 0);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		whitgl_fvec3_apply_fmat_array(points, points_out, BENCH_COUNT, &mats_a[0]);
+	report("fvec3_apply_fmat_array", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error_fvec3(points_out, points_ref, BENCH_COUNT), 0);
+
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+		{
+			whitgl_fmat m = ref_multiply(whitgl_fmat_translate(positions[i]), whitgl_quat_to_fmat(rotations[i]));
+			mats_ref[i] = ref_multiply(m, whitgl_fmat_scale(scales[i]));
+		}
+	ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		whitgl_fmat_model_array(positions, rotations, scales, mats_out, BENCH_COUNT);
+	report("fmat_model_array", ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), max_error(mats_out[0].mat, mats_ref[0].mat, 16*BENCH_COUNT), 1e-5);
+
+	return bench_exit("kernels out of tolerance");
+}
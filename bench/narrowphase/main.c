@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <whitgl/math.h>
+#include <whitgl/narrowphase.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+#include <whitgl/soa.h>
+
+#include "../common.h"
+
+// Times the narrowphase kernels against loops of the scalar ray functions in
+// math.c, and checks they agree. Cases so close to grazing that float and
+// double may disagree are skipped. Exits non-zero if any result differs.
+
+#define BENCH_COUNT (4099) // not a whole number of lanes
+#define BENCH_REPEATS (200)
+#define BENCH_WORLD (1000)
+// BENCH_GRAZE is how far shapes are grown and shrunk to find grazing cases,
+// BENCH_TOLERANCE how far along the path hits may differ. The float
+// references lose precision on long paths, whitgl_ray_circle_intersect can
+// be wrong about a hit up to about 0.1 from grazing.
+#ifdef WHITGL_MATH_FLOAT32
+#define BENCH_GRAZE (0.25)
+#define BENCH_TOLERANCE (0.25)
+#else
+#define BENCH_GRAZE (1e-3)
+#define BENCH_TOLERANCE (1e-2)
+#endif
+
+whitgl_fvec starts[BENCH_COUNT];
+whitgl_fvec speeds[BENCH_COUNT];
+whitgl_faabb boxes[BENCH_COUNT];
+whitgl_fcircle circles[BENCH_COUNT];
+float sizes[BENCH_COUNT];
+float t_out[BENCH_COUNT];
+whitgl_float t_ref[BENCH_COUNT];
+whitgl_float t_sink[BENCH_COUNT];
+whitgl_float lengths[BENCH_COUNT]; // of each path, to turn t errors into distances
+
+// inputs are rounded to float so the kernels and references see the same
+whitgl_float random_coord(whitgl_random_seed* seed, whitgl_float range)
+{
+	return (float)(whitgl_random_float(seed)*range);
+}
+
+whitgl_faabb grow(whitgl_faabb box, whitgl_float by)
+{
+	whitgl_fvec v = {by, by};
+	box.a = whitgl_fvec_sub(box.a, v);
+	box.b = whitgl_fvec_add(box.b, v);
+	return box;
+}
+
+// References return -1 for a miss
+whitgl_float ref_ray_circle(whitgl_fcircle circle, whitgl_fvec start, whitgl_fvec speed)
+{
+	whitgl_float t1, t2;
+	if(speed.x == 0 && speed.y == 0)
+		return whitgl_fvec_sqmagnitude(whitgl_fvec_sub(start, circle.pos)) < circle.size*circle.size ? 0 : -1;
+	if(!whitgl_ray_circle_intersect(circle, start, speed, &t1, &t2))
+		return -1;
+	if(t2 < 0 || t1 > 1)
+		return -1;
+	return whitgl_fmax(t1, 0);
+}
+
+whitgl_float ref_segment_box(whitgl_faabb box, whitgl_fvec start, whitgl_fvec speed)
+{
+	whitgl_float t1, t2;
+	if(!whitgl_ray_faabb_intersect(box, start, speed, &t1, &t2))
+		return -1;
+	if(t2 < 0 || t1 > 1)
+		return -1;
+	return whitgl_fmax(t1, 0);
+}
+
+// The box grown by a circle is two crossed boxes plus a circle on each corner,
+// so the first hit is the first hit on any of those
+whitgl_float ref_swept_circle_box(whitgl_faabb box, whitgl_float size, whitgl_fvec start, whitgl_fvec speed)
+{
+	whitgl_faabb sorted = {{whitgl_fmin(box.a.x, box.b.x), whitgl_fmin(box.a.y, box.b.y)}, {whitgl_fmax(box.a.x, box.b.x), whitgl_fmax(box.a.y, box.b.y)}};
+	box = sorted;
+	whitgl_faabb wide = {{box.a.x-size, box.a.y}, {box.b.x+size, box.b.y}};
+	whitgl_faabb tall = {{box.a.x, box.a.y-size}, {box.b.x, box.b.y+size}};
+	whitgl_float best = ref_segment_box(wide, start, speed);
+	whitgl_float t = ref_segment_box(tall, start, speed);
+	if(t >= 0 && (best < 0 || t < best))
+		best = t;
+	whitgl_int corner;
+	for(corner=0; corner<4; corner++)
+	{
+		whitgl_fcircle circle = {{corner & 1 ? box.b.x : box.a.x, corner & 2 ? box.b.y : box.a.y}, size};
+		t = ref_ray_circle(circle, start, speed);
+		if(t >= 0 && (best < 0 || t < best))
+			best = t;
+	}
+	return best;
+}
+
+void check(const char* name, whitgl_int hits, whitgl_float ref_ns, whitgl_float ns, whitgl_int skipped)
+{
+	whitgl_int ref_hits = 0;
+	whitgl_int wrong = 0;
+	whitgl_int i;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		if(t_ref[i] == -2)
+			continue;
+		whitgl_bool ref_hit = t_ref[i] >= 0;
+		whitgl_bool hit = t_out[i] != WHITGL_NARROWPHASE_MISS;
+		ref_hits += ref_hit;
+		if(hit != ref_hit)
+			wrong++;
+		else if(hit && whitgl_fabs(t_out[i]-t_ref[i])*lengths[i] > BENCH_TOLERANCE)
+			wrong++;
+	}
+	whitgl_int counted = 0;
+	for(i=0; i<BENCH_COUNT; i++)
+		counted += t_out[i] != WHITGL_NARROWPHASE_MISS;
+	if(counted != hits)
+		wrong++;
+	bench_expect(wrong == 0);
+	bench_print_speedup(name, ref_ns, ns);
+	printf("  hits %4d/%d  grazing %d %s\n", (int)ref_hits, BENCH_COUNT, (int)skipped, wrong ? "DIFFERS" : "ok");
+}
+
+int main()
+{
+	whitgl_random_seed seed = whitgl_random_seed_init(42);
+	whitgl_fvec_soa soa_start = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_fvec_soa soa_speed = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_fvec_soa soa_box_a = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_fvec_soa soa_box_b = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_fvec_soa soa_circles = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_int i, r;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		starts[i].x = random_coord(&seed, BENCH_WORLD);
+		starts[i].y = random_coord(&seed, BENCH_WORLD);
+		speeds[i].x = random_coord(&seed, 400)-200;
+		speeds[i].y = random_coord(&seed, 400)-200;
+		// a few stand still or move along one axis only
+		if(i%17 == 0)
+			speeds[i].x = 0;
+		if(i%23 == 0)
+			speeds[i].y = 0;
+		// boxes near the path so about half are hit, some given flipped
+		whitgl_fvec near = whitgl_fvec_add(starts[i], whitgl_fvec_scale_val(speeds[i], whitgl_random_float(&seed)));
+		boxes[i].a.x = near.x + random_coord(&seed, 80)-60;
+		boxes[i].a.y = near.y + random_coord(&seed, 80)-60;
+		boxes[i].b.x = boxes[i].a.x + random_coord(&seed, 40)+1;
+		boxes[i].b.y = boxes[i].a.y + random_coord(&seed, 40)+1;
+		if(i%5 == 0)
+		{
+			whitgl_float swap = boxes[i].a.x;
+			boxes[i].a.x = boxes[i].b.x;
+			boxes[i].b.x = swap;
+		}
+		sizes[i] = random_coord(&seed, 20)+1;
+		circles[i].pos.x = random_coord(&seed, BENCH_WORLD);
+		circles[i].pos.y = random_coord(&seed, BENCH_WORLD);
+		circles[i].size = sizes[i];
+		whitgl_fvec_soa_push(&soa_start, starts[i]);
+		whitgl_fvec_soa_push(&soa_speed, speeds[i]);
+		whitgl_fvec_soa_push(&soa_box_a, boxes[i].a);
+		whitgl_fvec_soa_push(&soa_box_b, boxes[i].b);
+		whitgl_fvec_soa_push(&soa_circles, circles[i].pos);
+	}
+
+	// one long ray through the whole field of circles
+	whitgl_fvec ray_start = {-10, 37};
+	whitgl_fvec ray_speed = {BENCH_WORLD+20, BENCH_WORLD*0.9};
+	whitgl_int skipped = 0;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		whitgl_fcircle bigger = circles[i];
+		whitgl_fcircle smaller = circles[i];
+		bigger.size += BENCH_GRAZE;
+		smaller.size -= BENCH_GRAZE;
+		t_ref[i] = ref_ray_circle(circles[i], ray_start, ray_speed);
+		if((ref_ray_circle(bigger, ray_start, ray_speed) >= 0) != (ref_ray_circle(smaller, ray_start, ray_speed) >= 0))
+		{
+			t_ref[i] = -2;
+			skipped++;
+		}
+	}
+	uint64_t start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			t_sink[i] = ref_ray_circle(circles[i], ray_start, ray_speed);
+	whitgl_float ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	whitgl_int hits = 0;
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		hits = whitgl_narrowphase_ray_circles(ray_start, ray_speed, &soa_circles, sizes, t_out);
+	for(i=0; i<BENCH_COUNT; i++)
+		lengths[i] = whitgl_fvec_magnitude(ray_speed);
+	check("ray_circles", hits, ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), skipped);
+	for(i=0; i<BENCH_COUNT; i++)
+		lengths[i] = whitgl_fvec_magnitude(speeds[i]);
+
+	skipped = 0;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		t_ref[i] = ref_swept_circle_box(boxes[i], sizes[i], starts[i], speeds[i]);
+		whitgl_bool hit_big = ref_swept_circle_box(grow(boxes[i], BENCH_GRAZE), sizes[i], starts[i], speeds[i]) >= 0;
+		whitgl_bool hit_small = ref_swept_circle_box(grow(boxes[i], -BENCH_GRAZE), sizes[i], starts[i], speeds[i]) >= 0;
+		if(hit_big != hit_small)
+		{
+			t_ref[i] = -2;
+			skipped++;
+		}
+	}
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			t_sink[i] = ref_swept_circle_box(boxes[i], sizes[i], starts[i], speeds[i]);
+	ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		hits = whitgl_narrowphase_swept_circles_faabbs(&soa_start, &soa_speed, sizes, &soa_box_a, &soa_box_b, t_out);
+	check("swept_circles_faabbs", hits, ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), skipped);
+
+	skipped = 0;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		t_ref[i] = ref_segment_box(boxes[i], starts[i], speeds[i]);
+		whitgl_bool hit_big = ref_segment_box(grow(boxes[i], BENCH_GRAZE), starts[i], speeds[i]) >= 0;
+		whitgl_bool hit_small = ref_segment_box(grow(boxes[i], -BENCH_GRAZE), starts[i], speeds[i]) >= 0;
+		if(hit_big != hit_small)
+		{
+			t_ref[i] = -2;
+			skipped++;
+		}
+	}
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		for(i=0; i<BENCH_COUNT; i++)
+			t_sink[i] = ref_segment_box(boxes[i], starts[i], speeds[i]);
+	ref_ns = bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(r=0; r<BENCH_REPEATS; r++)
+		hits = whitgl_narrowphase_segments_faabbs(&soa_start, &soa_speed, &soa_box_a, &soa_box_b, t_out);
+	check("segments_faabbs", hits, ref_ns, bench_ns_per(start, BENCH_REPEATS*BENCH_COUNT), skipped);
+
+	whitgl_fvec_soa_destroy(&soa_start);
+	whitgl_fvec_soa_destroy(&soa_speed);
+	whitgl_fvec_soa_destroy(&soa_box_a);
+	whitgl_fvec_soa_destroy(&soa_box_b);
+	whitgl_fvec_soa_destroy(&soa_circles);
+	return bench_exit("kernels differ");
+}
@@ -0,0 +1,549 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WHITGL_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <whitgl/debug.h>
+#include <whitgl/logging.h>
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+#include <whitgl/raster.h>
+#include <whitgl/sys.h>
+
+// Scripted render scenarios, each drawn for a fixed number of frames with the
+// same inputs every run. Results are written as JSON for
+// scripts/bench_compare.py to check against a stored baseline.
+
+#define BENCH_SIZE_X (320)
+#define BENCH_SIZE_Y (240)
+#define BENCH_NUM_TEXTURES (16)
+#define BENCH_FONT_IMAGE (BENCH_NUM_TEXTURES)
+#define BENCH_MAX_ITEMS (4096)
+#define BENCH_CUBE_MODEL (0)
+
+typedef struct
+{
+	whitgl_fvec pos;
+	whitgl_fvec vel;
+	whitgl_int frame;
+} bench_item;
+bench_item items[BENCH_MAX_ITEMS];
+whitgl_fvec_soa soa_pos = {NULL, NULL, 0, 0};
+whitgl_fvec_soa soa_vel = {NULL, NULL, 0, 0};
+// Post-process captures are window sized, which is doubled on high-DPI displays
+whitgl_sys_color capture_data[BENCH_SIZE_X*BENCH_SIZE_Y*4];
+
+typedef struct
+{
+	const char* name;
+	void (*draw)(whitgl_int frame);
+} bench_scenario;
+
+typedef struct
+{
+	const char* name;
+	whitgl_int frames;
+	whitgl_float fps;
+	whitgl_float cpu_ms;
+	whitgl_float draw_calls;
+	whitgl_float vertices;
+	whitgl_float upload_bytes;
+	whitgl_float program_switches;
+	whitgl_float flushes;
+} bench_result;
+
+// CPU time of this thread only, so waits on the GPU don't count
+uint64_t bench_thread_ns()
+{
+#ifdef WHITGL_WINDOWS
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	uint64_t k = ((uint64_t)kernel.dwHighDateTime<<32) | kernel.dwLowDateTime;
+	uint64_t u = ((uint64_t)user.dwHighDateTime<<32) | user.dwLowDateTime;
+	return (k+u)*100;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Images go to the rasterizer too, for bench_check_raster
+void bench_add_image(whitgl_int id, whitgl_ivec size, unsigned char* data)
+{
+	whitgl_sys_add_image_from_data(id, size, data);
+	whitgl_raster_add_image_from_data(id, size, data);
+}
+
+void bench_make_images()
+{
+	static unsigned char data[64*64*4];
+	whitgl_int i, x, y;
+	for(i=0; i<BENCH_NUM_TEXTURES; i++)
+	{
+		for(y=0; y<64; y++)
+		{
+			for(x=0; x<64; x++)
+			{
+				unsigned char* p = &data[(x+y*64)*4];
+				p[0] = (x*4+i*16)&0xff;
+				p[1] = (y*4)&0xff;
+				p[2] = ((x^y)*8+i*32)&0xff;
+				p[3] = ((x/4+y/4)%3) ? 0xff : 0x80;
+			}
+		}
+		whitgl_ivec size = {64, 64};
+		bench_add_image(i, size, data);
+	}
+
+	// 14x7 grid of 6x8 glyph cells, in the layout whitgl_sys_draw_text expects
+	static unsigned char font[84*56*4];
+	for(y=0; y<56; y++)
+	{
+		for(x=0; x<84; x++)
+		{
+			whitgl_int glyph = x/6+(y/8)*14;
+			unsigned char on = ((x%6)+(y%8)*3+glyph)%4 == 0 ? 0xff : 0x00;
+			unsigned char* p = &font[(x+y*84)*4];
+			p[0] = p[1] = p[2] = 0xff;
+			p[3] = on;
+		}
+	}
+	whitgl_ivec font_size = {84, 56};
+	bench_add_image(BENCH_FONT_IMAGE, font_size, font);
+}
+
+void bench_make_cube()
+{
+	// pos, texturepos, colour, normal
+	static float data[36*11];
+	static const float corners[8][3] = {{-1,-1,-1},{1,-1,-1},{1,1,-1},{-1,1,-1},{-1,-1,1},{1,-1,1},{1,1,1},{-1,1,1}};
+	static const int faces[6][4] = {{0,1,2,3},{5,4,7,6},{4,0,3,7},{1,5,6,2},{3,2,6,7},{4,5,1,0}};
+	static const float normals[6][3] = {{0,0,-1},{0,0,1},{-1,0,0},{1,0,0},{0,1,0},{0,-1,0}};
+	static const int tri[6] = {0,1,2,0,2,3};
+	whitgl_int f, v, k;
+	float* out = data;
+	for(f=0; f<6; f++)
+	{
+		for(v=0; v<6; v++)
+		{
+			const float* c = corners[faces[f][tri[v]]];
+			for(k=0; k<3; k++) *out++ = c[k];
+			*out++ = 0; *out++ = 0;
+			*out++ = 0.5+f*0.1; *out++ = 0.5; *out++ = 1.0-f*0.1;
+			for(k=0; k<3; k++) *out++ = normals[f][k];
+		}
+	}
+	whitgl_sys_update_model_from_data(BENCH_CUBE_MODEL, 36, (const char*)data);
+}
+
+void bench_seed_items(whitgl_int seed_value)
+{
+	whitgl_random_seed seed = whitgl_random_seed_init(seed_value);
+	whitgl_int i;
+	for(i=0; i<BENCH_MAX_ITEMS; i++)
+	{
+		items[i].pos.x = whitgl_random_float(&seed)*BENCH_SIZE_X;
+		items[i].pos.y = whitgl_random_float(&seed)*BENCH_SIZE_Y;
+		items[i].vel.x = whitgl_random_float(&seed)*2-1;
+		items[i].vel.y = whitgl_random_float(&seed)*2-1;
+		items[i].frame = whitgl_random_int(&seed, 16);
+	}
+}
+
+whitgl_ivec bench_item_pos(whitgl_int i, whitgl_int frame)
+{
+	whitgl_ivec pos;
+	pos.x = ((whitgl_int)(items[i].pos.x+items[i].vel.x*frame)%BENCH_SIZE_X+BENCH_SIZE_X)%BENCH_SIZE_X;
+	pos.y = ((whitgl_int)(items[i].pos.y+items[i].vel.y*frame)%BENCH_SIZE_Y+BENCH_SIZE_Y)%BENCH_SIZE_Y;
+	return pos;
+}
+
+void bench_draw_sprites(whitgl_int frame, whitgl_int count, whitgl_int num_textures)
+{
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_sprite sprite = {i%num_textures, {0,0}, {16,16}};
+		whitgl_ivec sprite_frame = {items[i].frame%4, items[i].frame/4};
+		whitgl_sys_draw_sprite(sprite, sprite_frame, bench_item_pos(i, frame));
+	}
+}
+
+void bench_sprites_1(whitgl_int frame) { bench_draw_sprites(frame, 2000, 1); }
+void bench_sprites_4(whitgl_int frame) { bench_draw_sprites(frame, 2000, 4); }
+void bench_sprites_16(whitgl_int frame) { bench_draw_sprites(frame, 2000, 16); }
+
+// Same items moved with the soa kernels and drawn in one call
+void bench_sprites_soa(whitgl_int frame)
+{
+	whitgl_int i;
+	if(frame == 0)
+	{
+		whitgl_fvec_soa_resize(&soa_pos, 2000);
+		whitgl_fvec_soa_resize(&soa_vel, 2000);
+		for(i=0; i<2000; i++)
+		{
+			whitgl_fvec_soa_set(&soa_pos, i, items[i].pos);
+			whitgl_fvec_soa_set(&soa_vel, i, items[i].vel);
+		}
+	}
+	whitgl_faabb world = {{0, 0}, {BENCH_SIZE_X, BENCH_SIZE_Y}};
+	whitgl_fvec_soa_add(&soa_pos, &soa_vel, &soa_pos);
+	whitgl_fvec_soa_bound(&soa_pos, world, &soa_pos);
+	whitgl_sprite sprite = {0, {0,0}, {16,16}};
+	whitgl_sys_draw_sprite_soa(sprite, whitgl_ivec_zero, &soa_pos);
+}
+
+void bench_text_wall(whitgl_int frame)
+{
+	whitgl_sprite font = {BENCH_FONT_IMAGE, {0,0}, {6,8}};
+	char line[BENCH_SIZE_X/6+1];
+	whitgl_int row, i;
+	for(row=0; row<BENCH_SIZE_Y/8; row++)
+	{
+		for(i=0; i<BENCH_SIZE_X/6; i++)
+			line[i] = ' '+1+(row*7+i+frame)%94;
+		line[BENCH_SIZE_X/6] = '\0';
+		whitgl_ivec pos = {0, row*8};
+		whitgl_sys_draw_text(font, line, pos);
+	}
+}
+
+void bench_circles(whitgl_int frame)
+{
+	whitgl_int i;
+	for(i=0; i<500; i++)
+	{
+		whitgl_sys_color col = {i*37, i*91, i*13, 0xc0};
+		whitgl_fcircle circle = {whitgl_ivec_to_fvec(bench_item_pos(i, frame)), 4+items[i].frame};
+		whitgl_sys_draw_fcircle(circle, col, 16);
+	}
+}
+
+void bench_lines(whitgl_int frame)
+{
+	whitgl_int i;
+	for(i=0; i<500; i++)
+	{
+		whitgl_sys_color col = {i*53, i*29, i*71, 0xff};
+		whitgl_iaabb line = {bench_item_pos(i, frame), bench_item_pos(i+500, frame)};
+		whitgl_sys_draw_line(line, col);
+		whitgl_sys_draw_thick_line(whitgl_ivec_to_fvec(line.a), whitgl_ivec_to_fvec(bench_item_pos(i+1000, frame)), 3, col);
+	}
+}
+
+void bench_models(whitgl_int frame)
+{
+	whitgl_fmat perspective = whitgl_fmat_perspective(whitgl_pi/3, (float)BENCH_SIZE_X/BENCH_SIZE_Y, 0.1f, 100.0f);
+	whitgl_fvec3 up = {0,1,0};
+	whitgl_fvec3 eye = {0,0,-30};
+	whitgl_fmat view = whitgl_fmat_lookAt(eye, whitgl_fvec3_zero, up);
+	whitgl_sys_enable_depth(true);
+	whitgl_int i;
+	for(i=0; i<256; i++)
+	{
+		whitgl_fvec3 offset = {(i%16)*2.5-19, (i/16)*2.5-19, items[i].vel.x*5};
+		whitgl_fmat model = whitgl_fmat_multiply(whitgl_fmat_translate(offset), whitgl_fmat_rot_y(frame*0.02+i));
+		whitgl_sys_draw_model(BENCH_CUBE_MODEL, WHITGL_SHADER_MODEL, model, view, perspective);
+	}
+	whitgl_sys_enable_depth(false);
+}
+
+void bench_post_chain(whitgl_int frame)
+{
+	// Sprites into framebuffer 1, copied through 2 and back into 0 before the post pass
+	whitgl_fmat ortho = whitgl_fmat_orthographic(0, BENCH_SIZE_X, 0, BENCH_SIZE_Y, -1, 1);
+	whitgl_fvec3 pane[4] = {{0,0,0}, {BENCH_SIZE_X,0,0}, {0,BENCH_SIZE_Y,0}, {BENCH_SIZE_X,BENCH_SIZE_Y,0}};
+	whitgl_sys_draw_init(1);
+	bench_draw_sprites(frame, 500, 4);
+	whitgl_sys_draw_init(2);
+	whitgl_sys_draw_buffer_pane(1, pane, WHITGL_SHADER_TEXTURE, whitgl_fmat_identity, whitgl_fmat_identity, ortho);
+	whitgl_sys_draw_init(0);
+	whitgl_sys_draw_buffer_pane(2, pane, WHITGL_SHADER_TEXTURE, whitgl_fmat_identity, whitgl_fmat_identity, ortho);
+}
+
+void bench_capture(whitgl_int frame)
+{
+	bench_draw_sprites(frame, 200, 1);
+	whitgl_sys_capture_frame_to_data(capture_data, true, 0);
+}
+
+void bench_capture_post(whitgl_int frame)
+{
+	bench_draw_sprites(frame, 200, 1);
+	whitgl_sys_capture_frame_to_data(capture_data, false, 0);
+}
+
+const bench_scenario scenarios[] =
+{
+	{"sprites_1_texture", bench_sprites_1},
+	{"sprites_4_textures", bench_sprites_4},
+	{"sprites_16_textures", bench_sprites_16},
+	{"sprites_soa", bench_sprites_soa},
+	{"text_wall", bench_text_wall},
+	{"circles", bench_circles},
+	{"lines", bench_lines},
+	{"models", bench_models},
+	{"post_chain", bench_post_chain},
+	{"capture", bench_capture},
+	{"capture_post", bench_capture_post},
+};
+#define BENCH_NUM_SCENARIOS ((whitgl_int)(sizeof(scenarios)/sizeof(scenarios[0])))
+
+// Draws the same integer aligned sprites, text, rects and thick lines through
+// GL and the software rasterizer and counts pixels that differ. Blend rounding is up to
+// the driver, so channels may be one apart.
+whitgl_int bench_check_raster()
+{
+	whitgl_sys_color clear = {0x20, 0x30, 0x40, 0xff};
+	whitgl_sys_set_clear_color(clear);
+	whitgl_raster_set_clear_color(clear);
+	bench_seed_items(4321);
+	whitgl_sys_draw_init(0);
+	whitgl_raster_draw_init();
+	whitgl_int i;
+	for(i=0; i<300; i++)
+	{
+		whitgl_sprite sprite = {i%BENCH_NUM_TEXTURES, {0,0}, {16,16}};
+		whitgl_ivec sprite_frame = {items[i].frame%4, items[i].frame/4};
+		whitgl_ivec pos = bench_item_pos(i, 0);
+		whitgl_sys_draw_sprite(sprite, sprite_frame, pos);
+		whitgl_raster_draw_sprite(sprite, sprite_frame, pos);
+	}
+	for(i=0; i<20; i++)
+	{
+		whitgl_ivec a = bench_item_pos(300+i, 0);
+		whitgl_iaabb rect = {a, {a.x+10+i*3, a.y+8+i*2}};
+		whitgl_sys_color col = {(i*40)&0xff, 0x80, (0xff-i*12)&0xff, i%2 ? 0xff : 0x60};
+		whitgl_sys_draw_iaabb(rect, col);
+		whitgl_raster_draw_iaabb(rect, col);
+	}
+	// axis aligned, so no pixel centre lands on an edge, and run both ways
+	// along each axis as culling depends on the winding
+	for(i=0; i<20; i++)
+	{
+		whitgl_ivec a = bench_item_pos(320+i, 0);
+		whitgl_fvec from = whitgl_ivec_to_fvec(a);
+		whitgl_fvec to = from;
+		whitgl_float length = (i%2 ? -1 : 1)*(12+i*2);
+		if(i%4 < 2)
+			to.x += length;
+		else
+			to.y += length;
+		whitgl_sys_color col = {0xff, (i*50)&0xff, 0x40, i%3 ? 0xff : 0x80};
+		whitgl_sys_draw_thick_line(from, to, 2+(i%3)*2, col);
+		whitgl_raster_draw_thick_line(from, to, 2+(i%3)*2, col);
+	}
+	whitgl_sprite font = {BENCH_FONT_IMAGE, {0,0}, {6,8}};
+	whitgl_ivec text_pos = {4, 4};
+	whitgl_sys_draw_text(font, "RASTER CHECK 0123456789", text_pos);
+	whitgl_raster_draw_text(font, "RASTER CHECK 0123456789", text_pos);
+	whitgl_sys_capture_frame_to_data(capture_data, true, 0);
+	whitgl_sys_draw_finish();
+	whitgl_raster_draw_finish();
+
+	const whitgl_sys_color* raster = whitgl_raster_get_pixels();
+	whitgl_int differ = 0;
+	for(i=0; i<BENCH_SIZE_X*BENCH_SIZE_Y; i++)
+	{
+		whitgl_sys_color g = capture_data[i];
+		whitgl_sys_color r = raster[i];
+		if(abs(g.r-r.r) > 1 || abs(g.g-r.g) > 1 || abs(g.b-r.b) > 1)
+			differ++;
+	}
+	WHITGL_LOG("raster_match: %s, %d of %d pixels differ", differ ? "FAIL" : "pass", (int)differ, BENCH_SIZE_X*BENCH_SIZE_Y);
+	return differ;
+}
+
+// The overlay draws its panel and GPU bars through the colour batch, check
+// they reach the frame. A tiny target stretches every bar to full width.
+whitgl_int bench_check_overlay()
+{
+	whitgl_sys_color clear = {0x20, 0x30, 0x40, 0xff};
+	whitgl_sys_set_clear_color(clear);
+	whitgl_sprite font = {BENCH_FONT_IMAGE, {0,0}, {6,8}};
+	whitgl_ivec pos = {4, 4};
+	whitgl_debug_overlay_init(pos, font);
+	whitgl_debug_overlay_set_target(0.000001);
+	whitgl_debug_overlay_set_active(true);
+	// GPU sections come back a few frames late, if the driver has timers
+	const whitgl_profile_gpu_result* results;
+	whitgl_int num_results = 0;
+	whitgl_int frame;
+	for(frame=0; frame<16 && num_results == 0; frame++)
+	{
+		num_results = whitgl_profile_gpu_results(&results);
+		whitgl_sys_draw_init(0);
+		whitgl_profile_gpu_section("overlay_check");
+		whitgl_debug_overlay_draw();
+		whitgl_sys_capture_frame_to_data(capture_data, true, 0);
+		whitgl_sys_draw_finish();
+	}
+	whitgl_debug_overlay_set_active(false);
+
+	// Right of the text on the memory line, and on the first GPU line
+	whitgl_int x = pos.x+font.size.x*31-3;
+	whitgl_int text_top = pos.y+font.size.y*4+1;
+	whitgl_sys_color backing = capture_data[x+(text_top+font.size.y*6+4)*BENCH_SIZE_X];
+	whitgl_sys_color bar = capture_data[x+(text_top+font.size.y*7+4)*BENCH_SIZE_X];
+	whitgl_int failed = 0;
+	if(backing.r >= clear.r || backing.g >= clear.g || backing.b >= clear.b)
+		failed++;
+	if(num_results > 0 && bar.b < backing.b+0x40)
+		failed++;
+	WHITGL_LOG("overlay_drawn: %s, backing %s, bars %s", failed ? "FAIL" : "pass",
+		backing.b < clear.b ? "drawn" : "missing", num_results == 0 ? "no GPU timers" : bar.b >= backing.b+0x40 ? "drawn" : "missing");
+	return failed;
+}
+
+bench_result bench_run(const bench_scenario* scenario, whitgl_int warmup, whitgl_int frames)
+{
+	bench_result result;
+	memset(&result, 0, sizeof(result));
+	result.name = scenario->name;
+	result.frames = frames;
+	bench_seed_items(1234);
+	whitgl_int frame;
+	uint64_t start_ns = 0;
+	uint64_t start_cpu = 0;
+	for(frame=0; frame<warmup+frames; frame++)
+	{
+		if(frame == warmup)
+		{
+			start_ns = whitgl_profile_now_ns();
+			start_cpu = bench_thread_ns();
+		}
+		whitgl_sys_draw_init(0);
+		scenario->draw(frame);
+		whitgl_sys_draw_finish();
+		if(frame < warmup)
+			continue;
+		whitgl_sys_stats stats = whitgl_sys_get_stats();
+		result.draw_calls += stats.draw_calls;
+		result.vertices += stats.vertices;
+		result.upload_bytes += stats.upload_bytes;
+		result.program_switches += stats.program_switches;
+		result.flushes += stats.flushes;
+	}
+	whitgl_float seconds = (whitgl_profile_now_ns()-start_ns)/1000000000.0;
+	whitgl_float cpu_seconds = (bench_thread_ns()-start_cpu)/1000000000.0;
+	result.fps = frames/seconds;
+	result.cpu_ms = cpu_seconds*1000/frames;
+	result.draw_calls /= frames;
+	result.vertices /= frames;
+	result.upload_bytes /= frames;
+	result.program_switches /= frames;
+	result.flushes /= frames;
+	return result;
+}
+
+void bench_write_json(FILE* f, const bench_result* results, whitgl_int num_results, whitgl_int warmup)
+{
+	fprintf(f, "{\n\t\"version\": 1,\n\t\"warmup\": %d,\n\t\"scenarios\": [\n", (int)warmup);
+	whitgl_int i;
+	for(i=0; i<num_results; i++)
+	{
+		const bench_result* r = &results[i];
+		fprintf(f, "\t\t{\"name\": \"%s\", \"frames\": %d, \"fps\": %.2f, \"cpu_ms\": %.4f, \"draw_calls\": %.2f, \"vertices\": %.1f, \"upload_bytes\": %.1f, \"program_switches\": %.2f, \"flushes\": %.2f}%s\n",
+			r->name, (int)r->frames, r->fps, r->cpu_ms, r->draw_calls, r->vertices, r->upload_bytes, r->program_switches, r->flushes, i < num_results-1 ? "," : "");
+	}
+	fprintf(f, "\t]\n}\n");
+}
+
+void bench_usage()
+{
+	printf("usage: render_bench [--frames N] [--warmup N] [--only NAME] [--window] [--out FILE]\n");
+}
+
+int main(int argc, char** argv)
+{
+	whitgl_int frames = 300;
+	whitgl_int warmup = 30;
+	const char* only = NULL;
+	const char* out = NULL;
+	whitgl_bool window = false;
+	int i;
+	for(i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+			frames = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--warmup") == 0 && i+1 < argc)
+			warmup = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--only") == 0 && i+1 < argc)
+			only = argv[++i];
+		else if(strcmp(argv[i], "--out") == 0 && i+1 < argc)
+			out = argv[++i];
+		else if(strcmp(argv[i], "--window") == 0)
+			window = true;
+		else
+		{
+			bench_usage();
+			return 1;
+		}
+	}
+	if(frames < 1)
+		frames = 1;
+
+	whitgl_sys_setup setup = whitgl_sys_setup_zero;
+	setup.name = "render_bench";
+	setup.size.x = BENCH_SIZE_X;
+	setup.size.y = BENCH_SIZE_Y;
+	setup.pixel_size = 1;
+	setup.resolution_mode = RESOLUTION_EXACT;
+	setup.vsync = false;
+	setup.start_focused = false;
+	setup.start_hidden = window;
+	setup.headless = !window;
+	setup.num_framebuffers = 3;
+	setup.max_frames_in_flight = 2;
+	if(!whitgl_sys_init(&setup))
+		return 1;
+	whitgl_profile_should_report(false);
+	whitgl_raster_setup raster_setup = whitgl_raster_setup_zero;
+	raster_setup.size = setup.size;
+	if(!whitgl_raster_init(raster_setup))
+		return 1;
+
+	bench_make_images();
+	bench_make_cube();
+
+	bench_result results[BENCH_NUM_SCENARIOS];
+	whitgl_int num_results = 0;
+	whitgl_int s;
+	for(s=0; s<BENCH_NUM_SCENARIOS; s++)
+	{
+		if(only && strcmp(only, scenarios[s].name) != 0)
+			continue;
+		WHITGL_LOG("Running %s", scenarios[s].name);
+		results[num_results++] = bench_run(&scenarios[s], warmup, frames);
+	}
+	whitgl_int raster_differ = bench_check_raster();
+	whitgl_int overlay_failed = bench_check_overlay();
+	whitgl_raster_close();
+	whitgl_sys_close();
+
+	if(num_results == 0)
+	{
+		WHITGL_LOG("No scenario named %s", only);
+		return 1;
+	}
+	FILE* f = out ? fopen(out, "w") : stdout;
+	if(!f)
+	{
+		WHITGL_LOG("Couldn't open %s", out);
+		return 1;
+	}
+	bench_write_json(f, results, num_results, warmup);
+	if(out)
+		fclose(f);
+	return raster_differ || overlay_failed ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+#include <whitgl/soa.h>
+
+#include "../common.h"
+
+// Steps a particle simulation written with whitgl_fvec arrays and again
+// with the soa kernels, then checks each kernel against the whitgl_fvec
+// function it mirrors. Exits non-zero if any result is out of tolerance.
+
+#define BENCH_COUNT (100000)
+#define BENCH_STEPS (50)
+
+whitgl_fvec pos[BENCH_COUNT];
+whitgl_fvec vel[BENCH_COUNT];
+whitgl_fvec other[BENCH_COUNT];
+whitgl_fvec expected[BENCH_COUNT];
+float lengths[BENCH_COUNT];
+
+const whitgl_faabb world = {{0, 0}, {640, 480}};
+const whitgl_fvec gravity = {0, 9.8};
+const whitgl_float max_speed = 40;
+const whitgl_float dt = 1/60.0;
+
+void step_array()
+{
+	whitgl_int i;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		whitgl_fvec v = whitgl_fvec_add(vel[i], whitgl_fvec_scale_val(gravity, dt));
+		if(whitgl_fvec_magnitude(v) > max_speed)
+			v = whitgl_fvec_scale_val(whitgl_fvec_normalize(v), max_speed);
+		vel[i] = v;
+		pos[i] = whitgl_fvec_bound(whitgl_fvec_add(pos[i], whitgl_fvec_scale_val(v, dt)), world);
+	}
+}
+
+void step_soa(whitgl_fvec_soa* p, whitgl_fvec_soa* v)
+{
+	whitgl_fvec_soa_offset(v, whitgl_fvec_scale_val(gravity, dt), v);
+	whitgl_fvec_soa_clamp_magnitude(v, max_speed, v);
+	whitgl_fvec_soa_add_scaled(p, v, dt, p);
+	whitgl_fvec_soa_bound(p, world, p);
+}
+
+void check(const char* name, const whitgl_fvec_soa* soa, const whitgl_fvec* want, whitgl_float tolerance)
+{
+	whitgl_float worst = 0;
+	whitgl_int i;
+	for(i=0; i<soa->count; i++)
+	{
+		whitgl_fvec got = whitgl_fvec_soa_get(soa, i);
+		whitgl_float scale = whitgl_fmax(1, whitgl_fmax(whitgl_fabs(want[i].x), whitgl_fabs(want[i].y)));
+		worst = whitgl_fmax(worst, whitgl_fabs(got.x-want[i].x)/scale);
+		worst = whitgl_fmax(worst, whitgl_fabs(got.y-want[i].y)/scale);
+	}
+	whitgl_bool ok = bench_expect(worst <= tolerance);
+	printf("%-22s error %.2g %s\n", name, worst, ok ? "ok" : "OUT OF TOLERANCE");
+}
+
+int main()
+{
+	whitgl_random_seed seed = whitgl_random_seed_init(42);
+	whitgl_int i, s;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		// rounded to float so both versions start from the same values
+		pos[i].x = (float)(whitgl_random_float(&seed)*world.b.x);
+		pos[i].y = (float)(whitgl_random_float(&seed)*world.b.y);
+		vel[i].x = (float)(whitgl_random_float(&seed)*100-50);
+		vel[i].y = (float)(whitgl_random_float(&seed)*100-50);
+		other[i].x = (float)(whitgl_random_float(&seed)*2000-1000);
+		other[i].y = (float)(whitgl_random_float(&seed)*2000-1000);
+	}
+	if(BENCH_COUNT > 0)
+		vel[0] = whitgl_fvec_zero; // normalize leaves zero alone
+	whitgl_fvec_soa p = whitgl_fvec_soa_create(BENCH_COUNT);
+	whitgl_fvec_soa v = whitgl_fvec_soa_create(0);
+	whitgl_fvec_soa o = whitgl_fvec_soa_zero;
+	whitgl_fvec_soa out = whitgl_fvec_soa_zero;
+	whitgl_fvec_soa_from_array(&p, pos, BENCH_COUNT);
+	whitgl_fvec_soa_from_array(&v, vel, BENCH_COUNT);
+	whitgl_fvec_soa_from_array(&o, other, BENCH_COUNT);
+
+	// kernels against whitgl_fvec, within float rounding
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_add(pos[i], other[i]);
+	whitgl_fvec_soa_add(&p, &o, &out);
+	check("add", &out, expected, 1e-6);
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_add(pos[i], whitgl_fvec_scale_val(vel[i], 0.3));
+	whitgl_fvec_soa_add_scaled(&p, &v, 0.3, &out);
+	check("add_scaled", &out, expected, 1e-6);
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_scale(pos[i], vel[i]);
+	whitgl_fvec_soa_scale(&p, &v, &out);
+	check("scale", &out, expected, 1e-6);
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_normalize(vel[i]);
+	whitgl_fvec_soa_normalize(&v, &out);
+	check("normalize", &out, expected, 1e-6);
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_bound(other[i], world);
+	whitgl_fvec_soa_bound(&o, world, &out);
+	check("bound", &out, expected, 0);
+	for(i=0; i<BENCH_COUNT; i++) expected[i] = whitgl_fvec_interpolate(pos[i], other[i], 0.25);
+	whitgl_fvec_soa_interpolate(&p, &o, 0.25, &out);
+	check("interpolate", &out, expected, 1e-5); // terms can cancel
+	whitgl_fvec_soa_magnitude(&o, lengths);
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		expected[i].x = whitgl_fvec_magnitude(other[i]);
+		expected[i].y = lengths[i];
+	}
+	whitgl_fvec_soa_from_array(&out, expected, BENCH_COUNT);
+	for(i=0; i<BENCH_COUNT; i++)
+		expected[i].x = expected[i].y;
+	check("magnitude", &out, expected, 1e-6);
+
+	uint64_t start = whitgl_profile_now_ns();
+	for(s=0; s<BENCH_STEPS; s++)
+		step_array();
+	whitgl_float array_ns = bench_ns_per(start, BENCH_STEPS*BENCH_COUNT);
+	start = whitgl_profile_now_ns();
+	for(s=0; s<BENCH_STEPS; s++)
+		step_soa(&p, &v);
+	whitgl_float soa_ns = bench_ns_per(start, BENCH_STEPS*BENCH_COUNT);
+	check("simulation positions", &p, pos, 1e-4);
+	printf("particle step  fvec %6.2fns  soa %6.2fns  x%5.2f\n", array_ns, soa_ns, array_ns/soa_ns);
+
+	whitgl_fvec_soa_destroy(&p);
+	whitgl_fvec_soa_destroy(&v);
+	whitgl_fvec_soa_destroy(&o);
+	whitgl_fvec_soa_destroy(&out);
+	return bench_exit("kernels out of tolerance");
+}
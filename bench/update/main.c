@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <whitgl/math.h>
+#include <whitgl/profile.h>
+#include <whitgl/random.h>
+
+#include "../common.h"
+#include "update.h"
+
+// Runs the same entity update loop built against the out of line math
+// helpers and against the WHITGL_MATH_INLINE ones, and checks both end in
+// the same state. Build with float32 to compare scalar precisions.
+
+#define BENCH_COUNT (200000)
+#define BENCH_STEPS (25)
+
+whitgl_fvec start_pos[BENCH_COUNT];
+whitgl_fvec start_vel[BENCH_COUNT];
+whitgl_fvec call_pos[BENCH_COUNT];
+whitgl_fvec call_vel[BENCH_COUNT];
+whitgl_fvec inline_pos[BENCH_COUNT];
+whitgl_fvec inline_vel[BENCH_COUNT];
+
+typedef void (*update_func)(whitgl_fvec* pos, whitgl_fvec* vel, whitgl_int count, whitgl_faabb world, whitgl_float dt);
+
+whitgl_float run(update_func update, whitgl_fvec* pos, whitgl_fvec* vel, whitgl_faabb world)
+{
+	memcpy(pos, start_pos, sizeof(start_pos));
+	memcpy(vel, start_vel, sizeof(start_vel));
+	uint64_t start = whitgl_profile_now_ns();
+	whitgl_int i;
+	for(i=0; i<BENCH_STEPS; i++)
+		update(pos, vel, BENCH_COUNT, world, 1/60.0);
+	return bench_ns_per(start, BENCH_STEPS*BENCH_COUNT);
+}
+
+int main()
+{
+	whitgl_faabb world = {{0, 0}, {640, 480}};
+	whitgl_random_seed seed = whitgl_random_seed_init(42);
+	whitgl_int i;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		start_pos[i].x = whitgl_random_float(&seed)*world.b.x;
+		start_pos[i].y = whitgl_random_float(&seed)*world.b.y;
+		start_vel[i].x = whitgl_random_float(&seed)*80-40;
+		start_vel[i].y = whitgl_random_float(&seed)*80-40;
+	}
+
+	// warm up caches and clocks
+	run(update_step_call, call_pos, call_vel, world);
+	whitgl_float call_ns = run(update_step_call, call_pos, call_vel, world);
+	whitgl_float inline_ns = run(update_step_inline, inline_pos, inline_vel, world);
+
+	// Compilers may contract multiply-adds differently once inlined, so allow
+	// for rounding rather than demanding identical bits
+	whitgl_float worst = 0;
+	for(i=0; i<BENCH_COUNT; i++)
+	{
+		worst = whitgl_fmax(worst, whitgl_fabs(call_pos[i].x-inline_pos[i].x));
+		worst = whitgl_fmax(worst, whitgl_fabs(call_pos[i].y-inline_pos[i].y));
+		worst = whitgl_fmax(worst, whitgl_fabs(call_vel[i].x-inline_vel[i].x));
+		worst = whitgl_fmax(worst, whitgl_fabs(call_vel[i].y-inline_vel[i].y));
+	}
+	whitgl_bool ok = bench_expect(worst <= 1e-6);
+	printf("%s scalars, %d byte fvec, %dKB of entities\n", sizeof(whitgl_float) == 4 ? "float32" : "float64", (int)sizeof(whitgl_fvec), (int)(sizeof(start_pos)+sizeof(start_vel))/1024);
+	printf("entity update  call %6.2fns  inline %6.2fns  x%5.2f  error %.2g %s\n", call_ns, inline_ns, call_ns/inline_ns, worst, ok ? "ok" : "MISMATCH");
+	return bench_exit("results differ");
+}
@@ -0,0 +1,9 @@
+#ifndef UPDATE_H_
+#define UPDATE_H_
+
+#include <whitgl/math.h>
+
+void update_step_call(whitgl_fvec* pos, whitgl_fvec* vel, whitgl_int count, whitgl_faabb world, whitgl_float dt);
+void update_step_inline(whitgl_fvec* pos, whitgl_fvec* vel, whitgl_int count, whitgl_faabb world, whitgl_float dt);
+
+#endif // UPDATE_H_
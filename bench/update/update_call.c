@@ -0,0 +1,9 @@
+// Always calls into math.c, even in builds that define WHITGL_MATH_INLINE
+#undef WHITGL_MATH_INLINE
+
+#include <whitgl/math.h>
+
+#include "update.h"
+
+#define UPDATE_STEP update_step_call
+#include "update_step.h"
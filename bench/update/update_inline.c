@@ -0,0 +1,10 @@
+#ifndef WHITGL_MATH_INLINE
+#define WHITGL_MATH_INLINE
+#endif
+
+#include <whitgl/math.h>
+
+#include "update.h"
+
+#define UPDATE_STEP update_step_inline
+#include "update_step.h"
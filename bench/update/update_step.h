@@ -0,0 +1,27 @@
+// Included by update_call.c and update_inline.c to build the same loop
+// against the out of line and the inline math helpers.
+
+void UPDATE_STEP(whitgl_fvec* pos, whitgl_fvec* vel, whitgl_int count, whitgl_faabb world, whitgl_float dt)
+{
+	whitgl_fvec gravity = {0, 9.8};
+	whitgl_float max_speed = 40;
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		whitgl_fvec v = whitgl_fvec_add(vel[i], whitgl_fvec_scale_val(gravity, dt));
+		if(whitgl_fvec_sqmagnitude(v) > max_speed*max_speed)
+			v = whitgl_fvec_scale_val(whitgl_fvec_normalize(v), max_speed);
+		whitgl_fvec p = whitgl_fvec_add(pos[i], whitgl_fvec_scale_val(v, dt));
+		whitgl_fvec bounded = whitgl_fvec_bound(p, world);
+		if(!whitgl_fvec_eq(p, bounded))
+		{
+			if(bounded.x != p.x)
+				v.x = -v.x*0.8;
+			if(bounded.y != p.y)
+				v.y = -v.y*0.8;
+		}
+		v.x = whitgl_fclamp(v.x, -max_speed, max_speed);
+		pos[i] = bounded;
+		vel[i] = v;
+	}
+}
@@ -14,13 +14,23 @@ joinp = os.path.join
 def flags(input_dir):
   cflags = '-Iinc -Wall -Wextra -Werror'
   optimizing = False
+  inline_math = False
+  float32 = False
   for arg in sys.argv:
     if arg == 'optimize':
       optimizing = True
+    if arg == 'inline_math':
+      inline_math = True
+    if arg == 'float32':
+      float32 = True
   if optimizing:
     cflags += ' -O2'
   else:
     cflags += ' -g'
+  if inline_math:
+    cflags += ' -D WHITGL_MATH_INLINE'
+  if float32:
+    cflags += ' -D WHITGL_MATH_FLOAT32'
   ldflags = ''
   if plat == 'Windows':
     cflags += ' -D WHITGL_WINDOWS -I_INPUT_/glfw/include -I_INPUT_/libpng -I_INPUT_/zlib -I_INPUT_/glew/include  -I_INPUT_/irrklang/include -I_INPUT_/TinyMT'
@@ -61,7 +71,7 @@ def rules(n):
     description='MODEL $in $out')
   n.newline()
 
-def walk_src(n, path, objdir):
+def walk_src(n, path, objdir, variables=None):
   obj = []
   for (dirpath, dirnames, filenames) in os.walk(path):
     for f in filenames:
@@ -69,11 +79,11 @@ def walk_src(n, path, objdir):
       if ext == '.c':
         s = os.path.relpath(joinp(dirpath, f), path)
         o = s.replace('.c', '.o')
-        obj += n.build(joinp(objdir, o), 'cxx', joinp(path, s))
+        obj += n.build(joinp(objdir, o), 'cxx', joinp(path, s), variables=variables)
       if ext == '.cpp':
         s = os.path.relpath(joinp(dirpath, f), path)
         o = s.replace('.cpp', '.o')
-        obj += n.build(joinp(objdir, o), 'cxx', joinp(path, s))
+        obj += n.build(joinp(objdir, o), 'cxx', joinp(path, s), variables=variables)
   n.newline()
   return obj
 
@@ -207,6 +217,42 @@ def main():
 
   n.build('all', 'phony', targets)
   n.default('all')
+  n.newline()
+
+  # Benchmarks, not built by default: ninja -f build/build.ninja bench
+  # The render baseline holds the batching counters only, timings are local
+  # to a machine, see scripts/bench_compare.py
+  benchdir = joinp(builddir, 'bench')
+  n.rule('bench',
+    command='(cd $benchdir && ./$exe --out $result) && python $scriptsdir/bench_compare.py $baseline $benchdir/$result',
+    description='BENCH $exe',
+    pool='console')
+  obj = walk_src(n, joinp('bench', 'render'), joinp(objdir, 'bench', 'render'))
+  benchlibs = copy_libs(n, inputdir, benchdir)
+  bench = n.build(joinp(benchdir, 'render_bench'), 'link', obj+staticlib)
+  bench += benchlibs
+  # the output is never written, so the benchmark runs every time
+  runs = n.build('bench_render', 'bench', bench,
+    variables={'benchdir': benchdir, 'exe': 'render_bench', 'result': 'render.json', 'baseline': joinp('bench', 'render', 'baseline.json')})
+  n.rule('bench_check',
+    command='cd $benchdir && ./$exe',
+    description='BENCH $exe',
+    pool='console')
+  # checks exit non-zero if any result is wrong, and also run against a
+  # float32 build of the library unless that's the main build already
+  variants = [('', staticlib, None)]
+  if 'float32' not in sys.argv:
+    float32 = {'cflags': cflags + ' -D WHITGL_MATH_FLOAT32'}
+    float32lib = n.build(joinp(libdir, 'float32', target), 'static', walk_src(n, srcdir, joinp(objdir, 'float32'), float32))
+    variants.append(('_float32', float32lib, float32))
+  for suffix, lib, variables in variants:
+    for name in ['math', 'update', 'soa', 'broadphase', 'aabb_tree', 'narrowphase']:
+      obj = walk_src(n, joinp('bench', name), joinp(objdir, 'bench'+suffix, name), variables)
+      bench = n.build(joinp(benchdir, name+'_bench'+suffix), 'link', obj+lib)
+      bench += benchlibs
+      runs += n.build('bench_'+name+suffix, 'bench_check', bench,
+        variables={'benchdir': benchdir, 'exe': name+'_bench'+suffix})
+  n.build('bench', 'phony', runs)
 
 if __name__ == '__main__':
   main()
@@ -0,0 +1,58 @@
+#ifndef WHITGL_AABB_TREE_H_
+#define WHITGL_AABB_TREE_H_
+
+#include <whitgl/math.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Dynamic bounding volume tree over boxes, for worlds too large or too uneven
+// for the grid in broadphase.h. Leaves hold each box grown by margin, so an
+// object that moves a little stays put in the tree. Inserts descend by
+// perimeter cost and the tree is kept balanced with rotations. Overlap is
+// tested with the same rule as whitgl_faabb_intersects.
+typedef struct
+{
+	whitgl_float margin;
+	whitgl_int max_objects; // ids run from 0 to max_objects-1
+} whitgl_aabb_tree_setup;
+static const whitgl_aabb_tree_setup whitgl_aabb_tree_setup_zero = {2, 1024};
+
+typedef struct
+{
+	whitgl_int id;
+	whitgl_float t; // ray time for raycasts, distance for nearest
+} whitgl_aabb_tree_hit;
+static const whitgl_aabb_tree_hit whitgl_aabb_tree_hit_zero = {-1, 0};
+
+typedef struct whitgl_aabb_tree whitgl_aabb_tree;
+
+whitgl_aabb_tree* whitgl_aabb_tree_create(whitgl_aabb_tree_setup setup);
+void whitgl_aabb_tree_destroy(whitgl_aabb_tree* tree);
+void whitgl_aabb_tree_clear(whitgl_aabb_tree* tree);
+
+// insert on an id already present moves it, update only touches the tree if
+// the box left its grown leaf and returns whether it did
+void whitgl_aabb_tree_insert(whitgl_aabb_tree* tree, whitgl_int id, whitgl_faabb box);
+whitgl_bool whitgl_aabb_tree_update(whitgl_aabb_tree* tree, whitgl_int id, whitgl_faabb box);
+void whitgl_aabb_tree_remove(whitgl_aabb_tree* tree, whitgl_int id);
+whitgl_bool whitgl_aabb_tree_contains(const whitgl_aabb_tree* tree, whitgl_int id);
+whitgl_int whitgl_aabb_tree_count(const whitgl_aabb_tree* tree);
+whitgl_int whitgl_aabb_tree_height(const whitgl_aabb_tree* tree);
+
+// Queries test the real boxes, not the grown ones. Like the broadphase they
+// write up to max_out results, return the total and allocate nothing.
+whitgl_int whitgl_aabb_tree_query_region(whitgl_aabb_tree* tree, whitgl_faabb region, whitgl_int* out, whitgl_int max_out);
+whitgl_int whitgl_aabb_tree_query_point(whitgl_aabb_tree* tree, whitgl_fvec p, whitgl_int* out, whitgl_int max_out);
+// First box hit by start+speed*t for t in [0,max_t], t is 0 if start is inside
+whitgl_bool whitgl_aabb_tree_raycast(whitgl_aabb_tree* tree, whitgl_fvec start, whitgl_fvec speed, whitgl_float max_t, whitgl_aabb_tree_hit* hit);
+// Up to k boxes closest to p, nearest first, returns how many were written
+whitgl_int whitgl_aabb_tree_nearest(whitgl_aabb_tree* tree, whitgl_fvec p, whitgl_aabb_tree_hit* out, whitgl_int k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHITGL_AABB_TREE_H_
@@ -0,0 +1,57 @@
+#ifndef WHITGL_BROADPHASE_H_
+#define WHITGL_BROADPHASE_H_
+
+#include <whitgl/math.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Uniform grid spatial hash for finding which of many boxes overlap. Each box
+// is stored in every cell it touches. Overlap is tested with the same rule as
+// whitgl_faabb_intersects, so boxes that only share an edge don't overlap.
+// Pick a cell size around the size of a typical box. Inserting a box over
+// more than WHITGL_BROADPHASE_MAX_CELLS cells panics.
+#define WHITGL_BROADPHASE_MAX_CELLS (4096)
+typedef struct
+{
+	whitgl_float cell_size;
+	whitgl_int num_buckets; // rounded up to a power of two
+	whitgl_int max_objects; // ids run from 0 to max_objects-1
+} whitgl_broadphase_setup;
+static const whitgl_broadphase_setup whitgl_broadphase_setup_zero = {32, 4096, 1024};
+
+typedef struct
+{
+	whitgl_int a, b; // a < b
+} whitgl_broadphase_pair;
+
+typedef struct whitgl_broadphase whitgl_broadphase;
+
+whitgl_broadphase* whitgl_broadphase_create(whitgl_broadphase_setup setup);
+void whitgl_broadphase_destroy(whitgl_broadphase* bp);
+void whitgl_broadphase_clear(whitgl_broadphase* bp);
+
+// insert on an id already present moves it, update only touches the grid if
+// the box moved to other cells
+void whitgl_broadphase_insert(whitgl_broadphase* bp, whitgl_int id, whitgl_faabb box);
+void whitgl_broadphase_update(whitgl_broadphase* bp, whitgl_int id, whitgl_faabb box);
+void whitgl_broadphase_remove(whitgl_broadphase* bp, whitgl_int id);
+whitgl_bool whitgl_broadphase_contains(const whitgl_broadphase* bp, whitgl_int id);
+whitgl_int whitgl_broadphase_count(const whitgl_broadphase* bp);
+void whitgl_broadphase_insert_iaabb(whitgl_broadphase* bp, whitgl_int id, whitgl_iaabb box);
+void whitgl_broadphase_update_iaabb(whitgl_broadphase* bp, whitgl_int id, whitgl_iaabb box);
+
+// Queries write up to max_out results and return how many there were in
+// total, which can be more than max_out. Nothing is allocated.
+whitgl_int whitgl_broadphase_query_region(whitgl_broadphase* bp, whitgl_faabb region, whitgl_int* out, whitgl_int max_out);
+whitgl_int whitgl_broadphase_query_region_iaabb(whitgl_broadphase* bp, whitgl_iaabb region, whitgl_int* out, whitgl_int max_out);
+whitgl_int whitgl_broadphase_query_point(whitgl_broadphase* bp, whitgl_fvec p, whitgl_int* out, whitgl_int max_out); // boxes with p inside
+whitgl_int whitgl_broadphase_pairs(const whitgl_broadphase* bp, whitgl_broadphase_pair* out, whitgl_int max_out); // each overlapping pair once
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHITGL_BROADPHASE_H_
@@ -42,4 +42,14 @@ whitgl_debug_menu whitgl_debug_menu_add_bool(whitgl_debug_menu debug, const char
 whitgl_debug_menu whitgl_debug_menu_add_button(whitgl_debug_menu debug, const char* name, whitgl_bool* trigger);
 void whitgl_debug_menu_draw(whitgl_debug_menu debug);
 
+// Perf overlay with a scrolling frame time graph, GPU sections, renderer
+// counters and memory use. Shapes go in one batch and text in another.
+#define WHITGL_DEBUG_OVERLAY_SAMPLES (128)
+void whitgl_debug_overlay_init(whitgl_ivec pos, whitgl_sprite text_sprite);
+void whitgl_debug_overlay_set_active(whitgl_bool active);
+whitgl_bool whitgl_debug_overlay_active();
+void whitgl_debug_overlay_set_target(whitgl_float seconds); // 1/60 by default
+// Call once per frame even when inactive, so the graph has no gaps when shown
+void whitgl_debug_overlay_draw();
+
 #endif // WHITGL_DEBUG_H_
@@ -56,6 +56,7 @@ typedef enum
 void whitgl_input_init();
 void whitgl_input_shutdown();
 void whitgl_input_update();
+void whitgl_input_update_cursor();
 bool whitgl_input_held(whitgl_input input);
 bool whitgl_input_pressed(whitgl_input input);
 whitgl_ivec whitgl_input_mouse_pos(int pixel_size);
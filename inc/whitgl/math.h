@@ -7,8 +7,15 @@
 #include <limits.h>
 
 typedef bool whitgl_bool;
+// WHITGL_MATH_FLOAT32 builds with float and int32_t scalars, halving the size
+// of every vector and aabb. The library and the game must be built the same.
+#ifdef WHITGL_MATH_FLOAT32
+typedef int32_t whitgl_int;
+typedef float whitgl_float;
+#else
 typedef int64_t whitgl_int;
 typedef double whitgl_float;
+#endif
 
 typedef struct
 {
@@ -67,6 +74,9 @@ typedef struct
 } whitgl_quat;
 static const whitgl_quat whitgl_quat_identity = {0,0,0,1};
 
+#ifdef WHITGL_MATH_INLINE
+#include <whitgl/math_inline.h>
+#else
 whitgl_int whitgl_imin(whitgl_int a, whitgl_int b);
 whitgl_int whitgl_imax(whitgl_int a, whitgl_int b);
 whitgl_int whitgl_iclamp(whitgl_int a, whitgl_int min, whitgl_int max);
@@ -152,6 +162,7 @@ whitgl_faabb whitgl_faabb_intersection(whitgl_faabb a, whitgl_faabb b);
 whitgl_bool whitgl_faabb_intersects(whitgl_faabb a, whitgl_faabb b);
 whitgl_faabb whitgl_faabb_incorporate(whitgl_faabb a, whitgl_faabb b);
 whitgl_float whitgl_faabb_area(whitgl_faabb a);
+#endif // WHITGL_MATH_INLINE
 
 whitgl_fmat whitgl_fmat_multiply(whitgl_fmat a, whitgl_fmat b);
 whitgl_fmat whitgl_fmat_invert(whitgl_fmat m);
@@ -166,6 +177,12 @@ whitgl_fmat whitgl_fmat_translate(whitgl_fvec3 off);
 whitgl_bool whitgl_fmat_eq(whitgl_fmat a, whitgl_fmat b);
 whitgl_fvec whitgl_fvec_apply_fmat(whitgl_fvec v, whitgl_fmat m);
 whitgl_fvec3 whitgl_fvec3_apply_fmat(whitgl_fvec3 v, whitgl_fmat m);
+// Batched transforms, outputs may alias inputs
+void whitgl_fvec3_apply_fmat_array(const whitgl_fvec3* in, whitgl_fvec3* out, whitgl_int count, const whitgl_fmat* m);
+void whitgl_fmat_multiply_array(const whitgl_fmat* a, const whitgl_fmat* b, whitgl_fmat* out, whitgl_int count); // out[i] = a[i]*b[i]
+void whitgl_fmat_premultiply_array(whitgl_fmat a, const whitgl_fmat* b, whitgl_fmat* out, whitgl_int count); // out[i] = a*b[i]
+// translate*rotate*scale, any of the inputs may be NULL
+void whitgl_fmat_model_array(const whitgl_fvec3* pos, const whitgl_quat* rot, const whitgl_fvec3* scale, whitgl_fmat* out, whitgl_int count);
 
 whitgl_quat whitgl_quat_multiply(whitgl_quat a, whitgl_quat b);
 whitgl_quat whitgl_quat_rotate(whitgl_float angle, whitgl_fvec3 axis);
@@ -195,6 +212,7 @@ whitgl_ivec whitgl_facing8_to_ivec(whitgl_int dir8);
 whitgl_fvec whitgl_facing8_to_fvec(whitgl_int dir8);
 
 bool whitgl_ray_circle_intersect(whitgl_fcircle circ, whitgl_fvec start, whitgl_fvec speed, whitgl_float* t1, whitgl_float* t2);
+bool whitgl_ray_faabb_intersect(whitgl_faabb box, whitgl_fvec start, whitgl_fvec speed, whitgl_float* t1, whitgl_float* t2); // grazing an edge misses
 whitgl_fvec whitgl_rotate_point_around_point(whitgl_fvec src, whitgl_fvec pivot, whitgl_float angle);
 
 whitgl_float whitgl_angle_lerp(whitgl_float a, whitgl_float b, whitgl_float amount);
@@ -204,7 +222,12 @@ whitgl_ivec whitgl_camera(whitgl_ivec pos, whitgl_ivec world_size, whitgl_ivec s
 
 static const whitgl_float whitgl_tau = 6.28318530718;
 static const whitgl_float whitgl_pi = 3.14159265359;
+#ifdef WHITGL_MATH_FLOAT32
+static const whitgl_float whitgl_float_max = FLT_MAX;
+static const whitgl_int whitgl_int_max = 2147483647; // INT32_MAX
+#else
 static const whitgl_float whitgl_float_max = DBL_MAX;
 static const whitgl_int whitgl_int_max = 9223372036854775807LL; // INT64_MAX
+#endif
 
 #endif // WHITGL_MATH_H_
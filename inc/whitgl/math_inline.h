@@ -0,0 +1,507 @@
+#ifndef WHITGL_MATH_INLINE_H_
+#define WHITGL_MATH_INLINE_H_
+
+// Definitions of the small scalar, vector and aabb helpers. math.h includes
+// this when WHITGL_MATH_INLINE is defined so calls inline without LTO, and
+// math.c includes it to build the same functions out of line.
+
+#include <math.h>
+
+#include <whitgl/logging.h>
+
+#ifndef WHITGL_MATH_API
+#define WHITGL_MATH_API static inline
+#endif
+
+WHITGL_MATH_API whitgl_int whitgl_imin(whitgl_int a, whitgl_int b)
+{
+	if(a < b) return a;
+	return b;
+}
+WHITGL_MATH_API whitgl_int whitgl_imax(whitgl_int a, whitgl_int b)
+{
+	if(a > b) return a;
+	return b;
+}
+WHITGL_MATH_API whitgl_int whitgl_iclamp(whitgl_int a, whitgl_int min, whitgl_int max)
+{
+	if(min > max) WHITGL_PANIC("ERR min > than max!");
+	if(a < min) return min;
+	if(a > max) return max;
+	return a;
+}
+WHITGL_MATH_API whitgl_int whitgl_iwrap(whitgl_int a, whitgl_int min, whitgl_int max)
+{
+	whitgl_int size = max-min;
+	a = ((a-min)%size)+min;
+	while(a < min)
+		a += size;
+	while(a >= max)
+		a -= size;
+	return a;
+}
+WHITGL_MATH_API whitgl_int whitgl_ipow(whitgl_int a, whitgl_int b)
+{
+	return pow(a,b);
+}
+
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_bound(whitgl_ivec a, whitgl_iaabb bounds)
+{
+	if(bounds.a.x > bounds.b.x)
+	{
+		whitgl_int swap = bounds.a.x;
+		bounds.a.x = bounds.b.x;
+		bounds.b.x = swap;
+	}
+	if(bounds.a.y > bounds.b.y)
+	{
+		whitgl_int swap = bounds.a.y;
+		bounds.a.y = bounds.b.y;
+		bounds.b.y = swap;
+	}
+	if(a.x < bounds.a.x)
+		a.x = bounds.a.x;
+	if(a.x > bounds.b.x)
+		a.x = bounds.b.x;
+	if(a.y < bounds.a.y)
+		a.y = bounds.a.y;
+	if(a.y > bounds.b.y)
+		a.y = bounds.b.y;
+	return a;
+}
+
+WHITGL_MATH_API whitgl_float whitgl_fmin(whitgl_float a, whitgl_float b)
+{
+	if(a < b) return a;
+	return b;
+}
+WHITGL_MATH_API whitgl_float whitgl_fmax(whitgl_float a, whitgl_float b)
+{
+	if(a > b) return a;
+	return b;
+}
+WHITGL_MATH_API whitgl_float whitgl_fclamp(whitgl_float a, whitgl_float min, whitgl_float max)
+{
+	if(min > max) WHITGL_LOG("ERR min > than max!");
+	if(a < min) return min;
+	if(a > max) return max;
+	return a;
+}
+WHITGL_MATH_API whitgl_float whitgl_fsqrt(whitgl_float a)
+{
+	return sqrt(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fwrap(whitgl_float a, whitgl_float min, whitgl_float max)
+{
+	float size = max-min;
+	a = fmod(a-min, size)+min;
+	while(a < min)
+		a += size;
+	while(a >= max)
+		a -= size;
+	return a;
+}
+WHITGL_MATH_API whitgl_float whitgl_fsin(whitgl_float a)
+{
+	return sin(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fcos(whitgl_float a)
+{
+	return cos(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_ftan(whitgl_float a)
+{
+	return tan(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fasin(whitgl_float a)
+{
+	return asin(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_facos(whitgl_float a)
+{
+	return acos(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fatan(whitgl_float a)
+{
+	return atan(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fpow(whitgl_float a, whitgl_float b)
+{
+	return pow(a,b);
+}
+WHITGL_MATH_API whitgl_float whitgl_finterpolate(whitgl_float a, whitgl_float b, whitgl_float ratio)
+{
+	return a*(1-ratio) + b*ratio;
+}
+WHITGL_MATH_API whitgl_float whitgl_fabs(whitgl_float a)
+{
+	return fabs(a);
+}
+WHITGL_MATH_API whitgl_float whitgl_fmod(whitgl_float a, whitgl_float b)
+{
+	return fmod(a, b);
+}
+WHITGL_MATH_API whitgl_float whitgl_fnearest(whitgl_float a, whitgl_float b)
+{
+	return floor(a/b+0.5)*b;
+}
+WHITGL_MATH_API whitgl_float whitgl_fsmoothstep(float a, whitgl_float min, whitgl_float max)
+{
+	a = whitgl_fclamp((a - min)/(max - min), 0.0, 1.0);
+	return a*a*(3-2*a);
+}
+
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_val(whitgl_int a)
+{
+	whitgl_ivec out = {a, a};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_add(whitgl_ivec a, whitgl_ivec b)
+{
+	whitgl_ivec out = {a.x + b.x, a.y + b.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_sub(whitgl_ivec a, whitgl_ivec b)
+{
+	whitgl_ivec out = {a.x - b.x, a.y - b.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_inverse(whitgl_ivec a)
+{
+	whitgl_ivec out = {-a.x, -a.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_scale(whitgl_ivec a, whitgl_ivec s)
+{
+	whitgl_ivec out = {a.x * s.x, a.y * s.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_scale_val(whitgl_ivec a, whitgl_int s)
+{
+	whitgl_ivec out = {a.x * s, a.y * s};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_divide(whitgl_ivec a, whitgl_ivec s)
+{
+	whitgl_ivec out = {a.x / s.x, a.y / s.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_ivec whitgl_ivec_divide_val(whitgl_ivec a, whitgl_int s)
+{
+	whitgl_ivec out = {a.x / s, a.y / s};
+	return out;
+}
+WHITGL_MATH_API whitgl_int whitgl_ivec_dot(whitgl_ivec a, whitgl_ivec b)
+{
+	return a.x*b.x + a.y*b.y;
+}
+WHITGL_MATH_API whitgl_int whitgl_ivec_sqmagnitude(whitgl_ivec a)
+{
+	return a.x * a.x + a.y * a.y;
+}
+WHITGL_MATH_API whitgl_bool whitgl_ivec_eq(whitgl_ivec a, whitgl_ivec b)
+{
+	return a.x == b.x && a.y == b.y;
+}
+
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_val(whitgl_float a)
+{
+	whitgl_fvec out = {a, a};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_add(whitgl_fvec a, whitgl_fvec b)
+{
+	whitgl_fvec out = {a.x + b.x, a.y + b.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_sub(whitgl_fvec a, whitgl_fvec b)
+{
+	whitgl_fvec out = {a.x - b.x, a.y - b.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_inverse(whitgl_fvec a)
+{
+	whitgl_fvec out = {-a.x, -a.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_scale(whitgl_fvec a, whitgl_fvec s)
+{
+	whitgl_fvec out = {a.x * s.x, a.y * s.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_scale_val(whitgl_fvec a, whitgl_float s)
+{
+	whitgl_fvec out = {a.x * s, a.y * s};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_divide(whitgl_fvec a, whitgl_fvec s)
+{
+	whitgl_fvec out = {a.x / s.x, a.y / s.y};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_divide_val(whitgl_fvec a, whitgl_float s)
+{
+	whitgl_fvec out = {a.x / s, a.y / s};
+	return out;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec_sqmagnitude(whitgl_fvec a)
+{
+	return a.x * a.x + a.y * a.y;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec_magnitude(whitgl_fvec a)
+{
+	return whitgl_fsqrt(whitgl_fvec_sqmagnitude(a));
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_normalize(whitgl_fvec a)
+{
+	whitgl_float mag = sqrt(whitgl_fvec_sqmagnitude(a));
+	if(mag == 0)
+		return a;
+	whitgl_float mag_1 = 1/mag;
+	a.x = a.x*mag_1;
+	a.y = a.y*mag_1;
+	return a;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec_dot(whitgl_fvec a, whitgl_fvec b)
+{
+	return a.x*b.x + a.y*b.y;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_bound(whitgl_fvec a, whitgl_faabb bounds)
+{
+	if(bounds.a.x > bounds.b.x)
+	{
+		whitgl_float swap = bounds.a.x;
+		bounds.a.x = bounds.b.x;
+		bounds.b.x = swap;
+	}
+	if(bounds.a.y > bounds.b.y)
+	{
+		whitgl_float swap = bounds.a.y;
+		bounds.a.y = bounds.b.y;
+		bounds.b.y = swap;
+	}
+	if(a.x < bounds.a.x)
+		a.x = bounds.a.x;
+	if(a.x > bounds.b.x)
+		a.x = bounds.b.x;
+	if(a.y < bounds.a.y)
+		a.y = bounds.a.y;
+	if(a.y > bounds.b.y)
+		a.y = bounds.b.y;
+	return a;
+}
+WHITGL_MATH_API whitgl_fvec whitgl_fvec_interpolate(whitgl_fvec a, whitgl_fvec b, whitgl_float ratio)
+{
+	whitgl_fvec out = whitgl_fvec_zero;
+	out.x = a.x*(1-ratio) + b.x*ratio;
+	out.y = a.y*(1-ratio) + b.y*ratio;
+	return out;
+}
+WHITGL_MATH_API whitgl_bool whitgl_fvec_eq(whitgl_fvec a, whitgl_fvec b)
+{
+	return a.x == b.x && a.y == b.y;
+}
+
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_val(whitgl_float a)
+{
+	whitgl_fvec3 out = {a, a, a};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_add(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	whitgl_fvec3 out = {a.x + b.x, a.y + b.y, a.z + b.z};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_sub(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	whitgl_fvec3 out = {a.x - b.x, a.y - b.y, a.z - b.z};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_inverse(whitgl_fvec3 a)
+{
+	whitgl_fvec3 out = {-a.x,-a.y,-a.z};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_scale(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	whitgl_fvec3 out = {a.x * b.x, a.y * b.y, a.z * b.z};
+	return out;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_scale_val(whitgl_fvec3 a, whitgl_float s)
+{
+	whitgl_fvec3 out = {a.x * s, a.y * s, a.z * s};
+	return out;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec3_sqmagnitude(whitgl_fvec3 a)
+{
+	return a.x*a.x + a.y*a.y + a.z*a.z;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec3_magnitude(whitgl_fvec3 a)
+{
+	return whitgl_fsqrt(whitgl_fvec3_sqmagnitude(a));
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_normalize(whitgl_fvec3 a)
+{
+	whitgl_float s = whitgl_fvec3_magnitude(a);
+	return whitgl_fvec3_scale_val(a, 1/s);
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_cross(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	whitgl_fvec3 o;
+	o.x = (a.y * b.z) - (a.z * b.y);
+	o.y = (a.z * b.x) - (a.x * b.z);
+	o.z = (a.x * b.y) - (a.y * b.x);
+	return o;
+}
+WHITGL_MATH_API whitgl_float whitgl_fvec3_dot(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+WHITGL_MATH_API whitgl_fvec3 whitgl_fvec3_interpolate(whitgl_fvec3 a, whitgl_fvec3 b, whitgl_float ratio)
+{
+	whitgl_fvec3 out = whitgl_fvec3_zero;
+	out.x = a.x*(1-ratio) + b.x*ratio;
+	out.y = a.y*(1-ratio) + b.y*ratio;
+	out.z = a.z*(1-ratio) + b.z*ratio;
+	return out;
+}
+WHITGL_MATH_API whitgl_bool whitgl_fvec3_eq(whitgl_fvec3 a, whitgl_fvec3 b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_add(whitgl_iaabb a, whitgl_ivec b)
+{
+	whitgl_iaabb out;
+	out.a.x = a.a.x + b.x;
+	out.a.y = a.a.y + b.y;
+	out.b.x = a.b.x + b.x;
+	out.b.y = a.b.y + b.y;
+	return out;
+}
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_sub(whitgl_iaabb a, whitgl_ivec b)
+{
+	whitgl_iaabb out;
+	out.a.x = a.a.x - b.x;
+	out.a.y = a.a.y - b.y;
+	out.b.x = a.b.x - b.x;
+	out.b.y = a.b.y - b.y;
+	return out;
+}
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_scale(whitgl_iaabb a, whitgl_ivec s)
+{
+	whitgl_iaabb out;
+	out.a = whitgl_ivec_scale(a.a, s);
+	out.b = whitgl_ivec_scale(a.b, s);
+	return out;
+}
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_divide(whitgl_iaabb a, whitgl_ivec s)
+{
+	whitgl_iaabb out;
+	out.a = whitgl_ivec_divide(a.a, s);
+	out.b = whitgl_ivec_divide(a.b, s);
+	return out;
+}
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_intersection(whitgl_iaabb a, whitgl_iaabb b)
+{
+	whitgl_iaabb out;
+	out.a.x = whitgl_imax(whitgl_imin(a.a.x, a.b.x), whitgl_imin(b.a.x, b.b.x));
+	out.a.y = whitgl_imax(whitgl_imin(a.a.y, a.b.y), whitgl_imin(b.a.y, b.b.y));
+	out.b.x = whitgl_imin(whitgl_imax(a.a.x, a.b.x), whitgl_imax(b.a.x, b.b.x));
+	out.b.y = whitgl_imin(whitgl_imax(a.a.y, a.b.y), whitgl_imax(b.a.y, b.b.y));
+	if(out.a.x > out.b.x)
+		out.b.x = out.a.x;
+	if(out.a.y > out.b.y)
+		out.b.y = out.a.y;
+	return out;
+}
+WHITGL_MATH_API bool whitgl_iaabb_intersects(whitgl_iaabb a, whitgl_iaabb b)
+{
+	if(a.a.x >= b.b.x) return false;
+	if(b.a.x >= a.b.x) return false;
+	if(a.a.y >= b.b.y) return false;
+	if(b.a.y >= a.b.y) return false;
+	return true;
+}
+WHITGL_MATH_API whitgl_iaabb whitgl_iaabb_incorporate(whitgl_iaabb a, whitgl_iaabb b)
+{
+	whitgl_iaabb out;
+	out.a.x = whitgl_imin(whitgl_imin(a.a.x, a.b.x), whitgl_imin(b.a.x, b.b.x));
+	out.a.y = whitgl_imin(whitgl_imin(a.a.y, a.b.y), whitgl_imin(b.a.y, b.b.y));
+	out.b.x = whitgl_imax(whitgl_imax(a.a.x, a.b.x), whitgl_imax(b.a.x, b.b.x));
+	out.b.y = whitgl_imax(whitgl_imax(a.a.y, a.b.y), whitgl_imax(b.a.y, b.b.y));
+	return out;
+}
+WHITGL_MATH_API whitgl_int whitgl_iaabb_area(whitgl_iaabb r)
+{
+	return (r.b.x-r.a.x)*(r.b.y-r.a.y);
+}
+
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_add(whitgl_faabb a, whitgl_fvec b)
+{
+	whitgl_faabb out;
+	out.a.x = a.a.x + b.x;
+	out.a.y = a.a.y + b.y;
+	out.b.x = a.b.x + b.x;
+	out.b.y = a.b.y + b.y;
+	return out;
+}
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_sub(whitgl_faabb a, whitgl_fvec b)
+{
+	whitgl_faabb out;
+	out.a.x = a.a.x - b.x;
+	out.a.y = a.a.y - b.y;
+	out.b.x = a.b.x - b.x;
+	out.b.y = a.b.y - b.y;
+	return out;
+}
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_scale(whitgl_faabb a, whitgl_fvec s)
+{
+	whitgl_faabb out;
+	out.a = whitgl_fvec_scale(a.a, s);
+	out.b = whitgl_fvec_scale(a.b, s);
+	return out;
+}
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_divide(whitgl_faabb a, whitgl_fvec s)
+{
+	whitgl_faabb out;
+	out.a = whitgl_fvec_divide(a.a, s);
+	out.b = whitgl_fvec_divide(a.b, s);
+	return out;
+}
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_intersection(whitgl_faabb a, whitgl_faabb b)
+{
+	whitgl_faabb out;
+	out.a.x = whitgl_fmax(whitgl_fmin(a.a.x, a.b.x), whitgl_fmin(b.a.x, b.b.x));
+	out.a.y = whitgl_fmax(whitgl_fmin(a.a.y, a.b.y), whitgl_fmin(b.a.y, b.b.y));
+	out.b.x = whitgl_fmin(whitgl_fmax(a.a.x, a.b.x), whitgl_fmax(b.a.x, b.b.x));
+	out.b.y = whitgl_fmin(whitgl_fmax(a.a.y, a.b.y), whitgl_fmax(b.a.y, b.b.y));
+	if(out.a.x > out.b.x)
+		out.b.x = out.a.x;
+	if(out.a.y > out.b.y)
+		out.b.y = out.a.y;
+	return out;
+}
+WHITGL_MATH_API whitgl_bool whitgl_faabb_intersects(whitgl_faabb a, whitgl_faabb b)
+{
+	if(a.a.x >= b.b.x) return false;
+	if(b.a.x >= a.b.x) return false;
+	if(a.a.y >= b.b.y) return false;
+	if(b.a.y >= a.b.y) return false;
+	return true;
+}
+WHITGL_MATH_API whitgl_faabb whitgl_faabb_incorporate(whitgl_faabb a, whitgl_faabb b)
+{
+	whitgl_faabb out;
+	out.a.x = whitgl_fmin(whitgl_fmin(a.a.x, a.b.x), whitgl_fmin(b.a.x, b.b.x));
+	out.a.y = whitgl_fmin(whitgl_fmin(a.a.y, a.b.y), whitgl_fmin(b.a.y, b.b.y));
+	out.b.x = whitgl_fmax(whitgl_fmax(a.a.x, a.b.x), whitgl_fmax(b.a.x, b.b.x));
+	out.b.y = whitgl_fmax(whitgl_fmax(a.a.y, a.b.y), whitgl_fmax(b.a.y, b.b.y));
+	return out;
+}
+WHITGL_MATH_API whitgl_float whitgl_faabb_area(whitgl_faabb r)
+{
+	return (r.b.x-r.a.x)*(r.b.y-r.a.y);
+}
+
+#endif // WHITGL_MATH_INLINE_H_
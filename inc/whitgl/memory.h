@@ -0,0 +1,60 @@
+#ifndef WHITGL_MEMORY_H_
+#define WHITGL_MEMORY_H_
+
+#include <stdint.h>
+
+#include <whitgl/math.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Byte counts for resources held by each subsystem, keyed by the id the
+// resource was created with. GPU sizes are estimates from formats and
+// dimensions, drivers may pad or keep extra copies. Counts are 64 bit
+// whatever the size of whitgl_int.
+typedef enum
+{
+	WHITGL_MEMORY_TEXTURE,
+	WHITGL_MEMORY_MODEL,
+	WHITGL_MEMORY_FRAMEBUFFER, // colour and depth, the headless target is id -1
+	WHITGL_MEMORY_STATIC_BATCH,
+	WHITGL_MEMORY_TILEMAP,
+	WHITGL_MEMORY_SOUND,
+	WHITGL_MEMORY_LOOP,
+	WHITGL_MEMORY_DECODE, // short lived CPU buffers while loading, mostly seen in the peak
+	WHITGL_MEMORY_NUM_SUBSYSTEMS,
+} whitgl_memory_subsystem;
+
+typedef struct
+{
+	int64_t bytes;
+	int64_t peak;
+	whitgl_int resources;
+	int64_t budget; // 0 for none
+} whitgl_memory_usage;
+static const whitgl_memory_usage whitgl_memory_usage_zero = {0, 0, 0, 0};
+
+// Replaces any earlier size for the same id, 0 bytes releases it
+void whitgl_memory_set(whitgl_memory_subsystem subsystem, whitgl_int id, int64_t bytes);
+void whitgl_memory_release(whitgl_memory_subsystem subsystem, whitgl_int id);
+int64_t whitgl_memory_get(whitgl_memory_subsystem subsystem, whitgl_int id);
+
+whitgl_memory_usage whitgl_memory_get_usage(whitgl_memory_subsystem subsystem);
+whitgl_memory_usage whitgl_memory_get_total();
+const char* whitgl_memory_subsystem_name(whitgl_memory_subsystem subsystem);
+
+// Logs a warning each time usage goes over budget
+void whitgl_memory_set_budget(whitgl_memory_subsystem subsystem, int64_t bytes);
+void whitgl_memory_set_total_budget(int64_t bytes);
+
+void whitgl_memory_set_log_interval(whitgl_int frames); // 0 to disable, the default
+void whitgl_memory_frame(); // called by whitgl_sys_draw_finish
+void whitgl_memory_log();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHITGL_MEMORY_H_
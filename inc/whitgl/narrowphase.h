@@ -0,0 +1,32 @@
+#ifndef WHITGL_NARROWPHASE_H_
+#define WHITGL_NARROWPHASE_H_
+
+#include <whitgl/math.h>
+#include <whitgl/soa.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Batched sweep tests over soa inputs, for many fast movers at once. Movement
+// is start+speed*t for t in [0,1], so speed is the distance covered in the
+// step. Each kernel writes the time of first contact for every element to t,
+// 0 if it already overlaps at the start, or WHITGL_NARROWPHASE_MISS. Returns
+// the number of hits. As in whitgl_ray_faabb_intersect, grazing an edge
+// misses. Float arrays are the caller's and need no padding.
+#define WHITGL_NARROWPHASE_MISS (FLT_MAX)
+
+// one ray against pos->count circles with radii size
+whitgl_int whitgl_narrowphase_ray_circles(whitgl_fvec start, whitgl_fvec speed, const whitgl_fvec_soa* pos, const float* size, float* t);
+// circle i of radius size[i] swept from start[i] by speed[i] against the box
+// from box_a[i] to box_b[i]
+whitgl_int whitgl_narrowphase_swept_circles_faabbs(const whitgl_fvec_soa* start, const whitgl_fvec_soa* speed, const float* size, const whitgl_fvec_soa* box_a, const whitgl_fvec_soa* box_b, float* t);
+// segment i from start[i] to start[i]+speed[i] against box i
+whitgl_int whitgl_narrowphase_segments_faabbs(const whitgl_fvec_soa* start, const whitgl_fvec_soa* speed, const whitgl_fvec_soa* box_a, const whitgl_fvec_soa* box_b, float* t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHITGL_NARROWPHASE_H_
@@ -1,14 +1,78 @@
 #ifndef WHITGL_PROFILE_H_
 #define WHITGL_PROFILE_H_
 
+#include <stdint.h>
+
 #include <whitgl/math.h>
 
+// Scoped CPU zones for the trace, compiled out with WHITGL_NO_PROFILE.
+// Names must outlive the trace, string literals are best.
+#ifdef WHITGL_NO_PROFILE
+#define WHITGL_PROFILE_BEGIN(name)
+#define WHITGL_PROFILE_END()
+#else
+#define WHITGL_PROFILE_BEGIN(name) whitgl_profile_zone_begin(name)
+#define WHITGL_PROFILE_END() whitgl_profile_zone_end()
+#endif
+
+typedef struct
+{
+	const char* name;
+	whitgl_int depth;
+	whitgl_float start; // seconds from the first section of the frame
+	whitgl_float duration;
+} whitgl_profile_gpu_result;
+
+typedef enum
+{
+	WHITGL_PROFILE_FRAME, // between the ends of consecutive frames
+	WHITGL_PROFILE_UPDATE,
+	WHITGL_PROFILE_GPU,
+	WHITGL_PROFILE_NUM_METRICS,
+} whitgl_profile_metric;
+
+// Over the last 1024 samples, in seconds
+typedef struct
+{
+	whitgl_float mean;
+	whitgl_float p50;
+	whitgl_float p90;
+	whitgl_float p99;
+	whitgl_float max;
+	whitgl_int count;
+	whitgl_int stutters;
+	whitgl_int total_stutters; // since init
+} whitgl_profile_distribution;
+static const whitgl_profile_distribution whitgl_profile_distribution_zero = {0, 0, 0, 0, 0, 0, 0, 0};
+
 void whitgl_profile_init();
 void whitgl_profile_start_frame();
 void whitgl_profile_start_drawing();
 void whitgl_profile_gpu_section(const char* name);
+void whitgl_profile_gpu_push(const char* name);
+void whitgl_profile_gpu_pop();
 void whitgl_profile_end_frame();
 void whitgl_profile_should_report(whitgl_bool report);
+// Sections of the most recent frame the GPU has finished, in the order they began
+whitgl_int whitgl_profile_gpu_results(const whitgl_profile_gpu_result** results);
+whitgl_int whitgl_profile_gpu_results_frame();
+whitgl_int whitgl_profile_dropped_frames();
+
+whitgl_profile_distribution whitgl_profile_get_distribution(whitgl_profile_metric metric);
+void whitgl_profile_set_stutter_threshold(whitgl_float seconds); // 1/30 by default
+void whitgl_profile_dump_distributions();
+void whitgl_profile_dump_at_shutdown(whitgl_bool dump);
 void whitgl_profile_shutdown();
 
+uint64_t whitgl_profile_now_ns();
+void whitgl_profile_zone_begin(const char* name);
+void whitgl_profile_zone_end();
+void whitgl_profile_trace_name_thread(const char* name);
+void whitgl_profile_trace_enable(whitgl_bool enable);
+void whitgl_profile_trace_reset();
+// Chrome trace JSON with CPU zones from every thread and GPU sections
+whitgl_bool whitgl_profile_trace_save(const char* filename);
+// Zones lost to full per-thread buffers since the last reset
+whitgl_int whitgl_profile_trace_dropped();
+
 #endif // WHITGL_PROFILE_H_
@@ -0,0 +1,44 @@
+#ifndef WHITGL_RASTER_H_
+#define WHITGL_RASTER_H_
+
+#include <whitgl/math.h>
+#include <whitgl/sys.h>
+
+// Software renderer for the 2D subset of sys.h, for use without any GL.
+// Draws are queued and rasterized in tiles at draw_finish, shared with worker
+// threads that init starts and close stops.
+// Integer aligned sprites match the GL output exactly.
+
+typedef struct
+{
+	whitgl_ivec size;
+	whitgl_int num_threads; // 0 to use one per core
+	whitgl_sys_color clear_color;
+} whitgl_raster_setup;
+static const whitgl_raster_setup whitgl_raster_setup_zero = {{120, 80}, 0, {0,0,0,0xff}};
+
+bool whitgl_raster_init(whitgl_raster_setup setup);
+void whitgl_raster_close();
+
+void whitgl_raster_set_clear_color(whitgl_sys_color col);
+void whitgl_raster_add_image_from_data(int id, whitgl_ivec size, const unsigned char* data);
+whitgl_ivec whitgl_raster_get_image_size(whitgl_int id);
+
+void whitgl_raster_draw_init();
+void whitgl_raster_draw_finish();
+
+void whitgl_raster_draw_iaabb(whitgl_iaabb rectangle, whitgl_sys_color col);
+void whitgl_raster_draw_hollow_iaabb(whitgl_iaabb rect, whitgl_int width, whitgl_sys_color col);
+void whitgl_raster_draw_line(whitgl_iaabb line, whitgl_sys_color col);
+void whitgl_raster_draw_thick_line(whitgl_fvec a, whitgl_fvec b, whitgl_float width, whitgl_sys_color col);
+void whitgl_raster_draw_fcircle(whitgl_fcircle circle, whitgl_sys_color col, int tris);
+void whitgl_raster_draw_tex_iaabb(int id, whitgl_iaabb src, whitgl_iaabb dest);
+void whitgl_raster_draw_sprite(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos);
+void whitgl_raster_draw_sprite_sized(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos, whitgl_ivec dest_size);
+void whitgl_raster_draw_text(whitgl_sprite sprite, const char* string, whitgl_ivec pos);
+
+// Top row first, valid after draw_finish
+const whitgl_sys_color* whitgl_raster_get_pixels();
+void whitgl_raster_capture_frame_to_data(whitgl_sys_color* data);
+
+#endif // WHITGL_RASTER_H_
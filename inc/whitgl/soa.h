@@ -0,0 +1,53 @@
+#ifndef WHITGL_SOA_H_
+#define WHITGL_SOA_H_
+
+#include <whitgl/math.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Large sets of 2D vectors as separate float arrays of x and y. Both arrays
+// are aligned and padded to WHITGL_SOA_ALIGN bytes so the kernels below run
+// whole vector registers at a time.
+#define WHITGL_SOA_ALIGN (32)
+
+typedef struct
+{
+	float* x;
+	float* y;
+	whitgl_int count;
+	whitgl_int capacity;
+} whitgl_fvec_soa;
+static const whitgl_fvec_soa whitgl_fvec_soa_zero = {NULL, NULL, 0, 0};
+
+whitgl_fvec_soa whitgl_fvec_soa_create(whitgl_int capacity);
+void whitgl_fvec_soa_destroy(whitgl_fvec_soa* soa);
+void whitgl_fvec_soa_resize(whitgl_fvec_soa* soa, whitgl_int count); // new elements are zero
+void whitgl_fvec_soa_push(whitgl_fvec_soa* soa, whitgl_fvec v);
+void whitgl_fvec_soa_remove(whitgl_fvec_soa* soa, whitgl_int index); // moves the last element into index
+whitgl_fvec whitgl_fvec_soa_get(const whitgl_fvec_soa* soa, whitgl_int index);
+void whitgl_fvec_soa_set(whitgl_fvec_soa* soa, whitgl_int index, whitgl_fvec v);
+void whitgl_fvec_soa_from_array(whitgl_fvec_soa* soa, const whitgl_fvec* in, whitgl_int count);
+void whitgl_fvec_soa_to_array(const whitgl_fvec_soa* soa, whitgl_fvec* out);
+
+// Kernels over every element, matching the whitgl_fvec functions of the same
+// name. out is resized to match and may be the same as any input.
+void whitgl_fvec_soa_add(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_add_scaled(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_float s, whitgl_fvec_soa* out); // a+b*s
+void whitgl_fvec_soa_offset(const whitgl_fvec_soa* a, whitgl_fvec b, whitgl_fvec_soa* out); // a+b
+void whitgl_fvec_soa_scale(const whitgl_fvec_soa* a, const whitgl_fvec_soa* s, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_scale_val(const whitgl_fvec_soa* a, whitgl_float s, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_normalize(const whitgl_fvec_soa* a, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_clamp_magnitude(const whitgl_fvec_soa* a, whitgl_float max, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_bound(const whitgl_fvec_soa* a, whitgl_faabb bounds, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_interpolate(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_float ratio, whitgl_fvec_soa* out);
+void whitgl_fvec_soa_magnitude(const whitgl_fvec_soa* a, float* out); // out holds a->count floats
+void whitgl_fvec_soa_sqmagnitude(const whitgl_fvec_soa* a, float* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHITGL_SOA_H_
@@ -5,6 +5,7 @@
 #include <stddef.h>
 
 #include <whitgl/math.h>
+#include <whitgl/soa.h>
 
 typedef enum
 {
@@ -35,6 +36,10 @@ typedef struct
 	whitgl_bool clear_buffer;
 	whitgl_int num_framebuffers;
 	whitgl_bool resizable;
+	const char* shader_cache_dir; // directory for linked program binaries, NULL to disable
+	whitgl_bool headless; // no window system, frames are presented to an offscreen buffer
+	whitgl_int max_frames_in_flight; // frames the GPU may queue behind the CPU, 0 for no limit
+	whitgl_bool late_input_sampling; // poll events again just before drawing starts
 } whitgl_sys_setup;
 static const whitgl_sys_setup whitgl_sys_setup_zero =
 {
@@ -50,6 +55,10 @@ static const whitgl_sys_setup whitgl_sys_setup_zero =
 	true,
 	1,
 	false,
+	NULL,
+	false,
+	0,
+	false,
 };
 
 typedef struct
@@ -83,6 +92,7 @@ typedef enum
 	WHITGL_SHADER_EXTRA_5,
 	WHITGL_SHADER_EXTRA_6,
 	WHITGL_SHADER_EXTRA_7,
+	WHITGL_SHADER_COLOR,
 	WHITGL_SHADER_MAX,
 } whitgl_shader_slot;
 
@@ -95,6 +105,7 @@ typedef enum
 	WHITGL_UNIFORM_IMAGE,
 	WHITGL_UNIFORM_FRAMEBUFFER,
 	WHITGL_UNIFORM_MATRIX,
+	WHITGL_UNIFORM_BLOCK,
 } whitgl_uniform_type;
 #define WHITGL_MAX_SHADER_UNIFORMS (32)
 typedef struct
@@ -118,6 +129,7 @@ void whitgl_sys_close();
 void whitgl_sys_set_clear_color(whitgl_sys_color col);
 
 bool whitgl_change_shader(whitgl_shader_slot type, whitgl_shader shader);
+bool whitgl_change_shaders(whitgl_int count, const whitgl_shader_slot* types, const whitgl_shader* shaders);
 void whitgl_set_shader_float(whitgl_shader_slot type, whitgl_int uniform, float value);
 void whitgl_set_shader_fvec(whitgl_shader_slot type, whitgl_int uniform, whitgl_fvec value);
 void whitgl_set_shader_fvec3(whitgl_shader_slot type, whitgl_int uniform, whitgl_fvec3 value);
@@ -125,9 +137,19 @@ void whitgl_set_shader_color(whitgl_shader_slot type, whitgl_int uniform, whitgl
 void whitgl_set_shader_image(whitgl_shader_slot type, whitgl_int uniform, whitgl_int index);
 void whitgl_set_shader_framebuffer(whitgl_shader_slot type, whitgl_int uniform, whitgl_int index);
 void whitgl_set_shader_matrix(whitgl_shader_slot type, whitgl_int matrix, whitgl_fmat fmat);
+void whitgl_set_shader_block(whitgl_shader_slot type, whitgl_int uniform, whitgl_int id);
+
+// Uniform blocks are std140 buffers shared between programs. Every built-in
+// vertex shader declares "whitgl_camera { mat4 m_view; mat4 m_perspective; }",
+// which is uploaded once per distinct camera. Custom shaders may declare the
+// same block, or bind their own with WHITGL_UNIFORM_BLOCK uniforms.
+void whitgl_sys_update_uniform_block(whitgl_int id, size_t size, const void* data);
 
 void whitgl_sys_draw_init(whitgl_int framebuffer_id);
 void whitgl_sys_draw_finish();
+// Forgets cached GL state such as the bound program. Call it after using GL
+// directly mid-frame, it's done at the start of every frame anyway.
+void whitgl_sys_invalidate_gl_state();
 
 void whitgl_sys_add_image_from_data(int id, whitgl_ivec size, unsigned char* data);
 void whitgl_sys_update_image_from_data(int id, whitgl_ivec size, unsigned char* data);
@@ -140,11 +162,44 @@ void whitgl_sys_image_from_data(int id, whitgl_ivec size, const unsigned char* d
 void whitgl_sys_draw_iaabb(whitgl_iaabb rectangle, whitgl_sys_color col);
 void whitgl_sys_draw_hollow_iaabb(whitgl_iaabb rect, whitgl_int width, whitgl_sys_color col);
 void whitgl_sys_draw_line(whitgl_iaabb line, whitgl_sys_color col);
+typedef enum
+{
+	WHITGL_LINE_JOIN_MITER,
+	WHITGL_LINE_JOIN_BEVEL,
+} whitgl_sys_line_join;
+// Lines of any width, batched as triangles. Sharp miters fall back to bevels.
+void whitgl_sys_draw_polyline(const whitgl_fvec* points, whitgl_int num_points, whitgl_float width, whitgl_sys_line_join join, whitgl_bool closed, whitgl_sys_color col);
+void whitgl_sys_draw_polyline_colored(const whitgl_fvec* points, const whitgl_sys_color* colors, whitgl_int num_points, whitgl_float width, whitgl_sys_line_join join, whitgl_bool closed);
+void whitgl_sys_draw_thick_line(whitgl_fvec a, whitgl_fvec b, whitgl_float width, whitgl_sys_color col);
+// Circles, ellipses, rings and polylines take a per-vertex colour and are drawn
+// with WHITGL_SHADER_COLOR rather than WHITGL_SHADER_FLAT, so replace that slot
+// to restyle them.
 void whitgl_sys_draw_fcircle(whitgl_fcircle circle, whitgl_sys_color col, int tris);
+void whitgl_sys_draw_fellipse(whitgl_fvec pos, whitgl_fvec radius, whitgl_sys_color col, int tris);
+void whitgl_sys_draw_fring(whitgl_fcircle circle, whitgl_float thickness, whitgl_sys_color col, int tris);
 void whitgl_sys_draw_tex_iaabb(int id, whitgl_iaabb src, whitgl_iaabb dest);
 void whitgl_sys_draw_sprite(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos);
 void whitgl_sys_draw_sprite_sized(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos, whitgl_ivec dest_size);
+// One sprite at each position, straight into the sprite batch
+void whitgl_sys_draw_sprite_soa(whitgl_sprite sprite, whitgl_ivec frame, const whitgl_fvec_soa* pos);
 void whitgl_sys_draw_text(whitgl_sprite sprite, const char* string, whitgl_ivec pos);
+
+// A tilemap is a grid of frame indices into a sprite sheet, laid out in rows like
+// whitgl_sys_draw_sprite frames. Negative tiles are empty. It is kept on the GPU
+// in chunks which are only rebuilt when their tiles change.
+void whitgl_sys_update_tilemap(whitgl_int id, whitgl_sprite sheet, whitgl_ivec size, const whitgl_int* tiles);
+void whitgl_sys_set_tilemap_tile(whitgl_int id, whitgl_ivec pos, whitgl_int tile);
+whitgl_int whitgl_sys_get_tilemap_tile(whitgl_int id, whitgl_ivec pos);
+void whitgl_sys_draw_tilemap(whitgl_int id, whitgl_ivec offset);
+
+// Between begin and end, 2D draws (sprites, text, rects, lines and circles) are
+// recorded into a static batch instead of drawn. Draws with the same texture
+// (or flat colour) are grouped into one draw unless something drawn between
+// them overlaps, and replay uses the shaders' uniforms at replay time.
+// Models, tilemaps and buffer panes are drawn immediately as usual.
+void whitgl_sys_begin_static_batch(whitgl_int id);
+void whitgl_sys_end_static_batch();
+void whitgl_sys_draw_static_batch(whitgl_int id, whitgl_fmat m_model);
 void whitgl_sys_draw_buffer_pane(whitgl_int id, whitgl_fvec3 verts[4], whitgl_shader_slot shader, whitgl_fmat m_model, whitgl_fmat m_view, whitgl_fmat m_perspective);
 void whitgl_resize_framebuffer(whitgl_int i, whitgl_ivec size, whitgl_bool one_color);
 
@@ -154,7 +209,7 @@ whitgl_bool whitgl_load_model(whitgl_int id, const char* filename);
 
 whitgl_ivec whitgl_sys_get_image_size(whitgl_int id);
 
-whitgl_float whitgl_sys_get_time();
+double whitgl_sys_get_time(); // seconds, double even with WHITGL_MATH_FLOAT32
 
 whitgl_sys_color whitgl_sys_color_blend(whitgl_sys_color a, whitgl_sys_color b, whitgl_float factor);
 whitgl_sys_color whitgl_sys_color_multiply(whitgl_sys_color a, whitgl_sys_color b);
@@ -162,6 +217,35 @@ whitgl_sys_color whitgl_sys_color_multiply(whitgl_sys_color a, whitgl_sys_color
 whitgl_bool whitgl_sys_window_focused();
 
 void whitgl_sys_enable_depth(whitgl_bool enable);
+
+// Draws entirely outside the render area (2D) or the view frustum (models)
+// are skipped on the CPU. Culled draws are counted per frame.
+void whitgl_sys_enable_cpu_culling(whitgl_bool enable);
+whitgl_int whitgl_sys_get_culled_draws();
+
+typedef enum
+{
+	WHITGL_FLUSH_TEXTURE, // sprite from a different image
+	WHITGL_FLUSH_UNIFORM, // shader uniform or block changed
+	WHITGL_FLUSH_PRIMITIVE, // unbatched draw, or switch between textured and coloured
+	WHITGL_FLUSH_FULL,
+	WHITGL_FLUSH_FRAME, // draw_init, draw_finish or static batch recording
+	WHITGL_FLUSH_NUM_REASONS,
+} whitgl_sys_flush_reason;
+typedef struct
+{
+	whitgl_int draw_calls;
+	whitgl_int flushes;
+	whitgl_int flush_reasons[WHITGL_FLUSH_NUM_REASONS];
+	whitgl_int vertices;
+	whitgl_int upload_bytes; // through glBufferData, glBufferSubData and glTexImage2D
+	whitgl_int program_switches;
+	whitgl_int framebuffer_binds;
+	whitgl_int culled_draws;
+} whitgl_sys_stats;
+static const whitgl_sys_stats whitgl_sys_stats_zero = {0, 0, {0}, 0, 0, 0, 0, 0};
+// Counters for the last finished frame
+whitgl_sys_stats whitgl_sys_get_stats();
 void whitgl_sys_cull_side(whitgl_bool cull_front);
 
 void whitgl_set_clipboard(const char* string);
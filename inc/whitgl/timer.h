@@ -10,4 +10,12 @@ whitgl_int whitgl_timer_fps();
 whitgl_float whitgl_timer_frame_completage(whitgl_float fps);
 void whitgl_timer_sleep(whitgl_float seconds);
 
+// Frame pacing to a fixed period, in seconds
+void whitgl_timer_pacer_init(whitgl_float period);
+void whitgl_timer_pacer_set_period(whitgl_float period);
+whitgl_float whitgl_timer_pacer_wait(); // returns how late this frame started
+whitgl_float whitgl_timer_pacer_budget(); // time left before the next deadline
+whitgl_float whitgl_timer_pacer_lateness();
+whitgl_int whitgl_timer_pacer_missed();
+
 #endif // WHITGL_TIMER_H_
@@ -0,0 +1,103 @@
+#!/usr/bin/python
+
+from __future__ import print_function
+
+import argparse
+import json
+import os.path
+import sys
+
+# Counters are deterministic, so any growth is a change in batching.
+# Timings are noisy and only fail past the tolerance. They are also local to
+# one machine, so the committed baseline holds counters only, and timings are
+# compared only against a baseline stored with --update --timings.
+counters = ['draw_calls', 'vertices', 'upload_bytes', 'program_switches', 'flushes']
+timings = ['fps', 'cpu_ms']
+
+def load(filename):
+        file = open(filename)
+        results = json.load(file)
+        file.close()
+        return dict((s['name'], s) for s in results['scenarios'])
+
+def store(current, baseline, keep_timings):
+        file = open(current)
+        results = json.load(file)
+        file.close()
+        if not keep_timings:
+                for s in results['scenarios']:
+                        for t in timings:
+                                s.pop(t, None)
+        file = open(baseline, 'w')
+        file.write('{\n\t"version": %d,\n\t"warmup": %d,\n\t"scenarios": [\n' % (results['version'], results['warmup']))
+        lines = []
+        for s in results['scenarios']:
+                keys = ['name', 'frames'] + [k for k in timings+counters if k in s]
+                lines.append('\t\t{' + ', '.join('"%s": %s' % (k, json.dumps(s[k])) for k in keys) + '}')
+        file.write(',\n'.join(lines) + '\n\t]\n}\n')
+        file.close()
+
+def compare(baseline, current, tolerance):
+        regressions = 0
+        for name in sorted(current):
+                now = current[name]
+                if name not in baseline:
+                        print('%-22s new, fps %.1f cpu %.3fms draws %.1f' % (name, now['fps'], now['cpu_ms'], now['draw_calls']))
+                        continue
+                old = baseline[name]
+                problems = []
+                timed = 'fps' in old and 'cpu_ms' in old
+                if timed and now['fps'] < old['fps']*(1-tolerance):
+                        problems.append('fps %.1f -> %.1f' % (old['fps'], now['fps']))
+                if timed and now['cpu_ms'] > old['cpu_ms']*(1+tolerance):
+                        problems.append('cpu %.3fms -> %.3fms' % (old['cpu_ms'], now['cpu_ms']))
+                for c in counters:
+                        if now[c] > old[c]+0.01:
+                                problems.append('%s %.1f -> %.1f' % (c, old[c], now[c]))
+                if problems:
+                        regressions += 1
+                        print('%-22s REGRESSED %s' % (name, ', '.join(problems)))
+                elif timed:
+                        print('%-22s ok, fps %.1f (%+.1f%%) cpu %.3fms (%+.1f%%)' % (name, now['fps'], (now['fps']/old['fps']-1)*100, now['cpu_ms'], (now['cpu_ms']/old['cpu_ms']-1)*100))
+                else:
+                        print('%-22s ok, fps %.1f cpu %.3fms draws %.1f' % (name, now['fps'], now['cpu_ms'], now['draw_calls']))
+        return regressions
+
+# A scenario that stops running would otherwise pass unnoticed
+def missing(baseline, current):
+        names = sorted(name for name in baseline if name not in current)
+        for name in names:
+                print('%-22s MISSING from the current run' % name)
+        return len(names)
+
+def main():
+        parser = argparse.ArgumentParser(description='Compare render_bench results against a stored baseline.')
+        parser.add_argument('baseline', help='baseline json file')
+        parser.add_argument('current', help='json file from render_bench')
+        parser.add_argument('--tolerance', type=float, default=0.1, help='allowed fraction of fps or cpu time lost')
+        parser.add_argument('--update', action='store_true', help='replace the baseline with the current counters')
+        parser.add_argument('--timings', action='store_true', help='with --update, also store fps and cpu time, for a baseline kept on one machine')
+        parser.add_argument('--allow-missing', action='store_true', help='don\'t fail on baseline scenarios absent from the current run, for --only runs')
+        args = parser.parse_args()
+
+        if args.update:
+                store(args.current, args.baseline, args.timings)
+                print('Updated baseline %s' % args.baseline)
+                return 0
+        if not os.path.isfile(args.baseline):
+                print('No baseline at %s, run with --update to store one' % args.baseline)
+                return 1
+        baseline = load(args.baseline)
+        current = load(args.current)
+        regressions = compare(baseline, current, args.tolerance)
+        absent = missing(baseline, current)
+        if regressions:
+                print('%d scenarios regressed' % regressions)
+        if absent:
+                print('%d baseline scenarios missing' % absent)
+        if regressions or (absent and not args.allow_missing):
+                return 1
+        return 0
+
+if __name__ == "__main__":
+        sys.exit(main())
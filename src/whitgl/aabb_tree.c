@@ -0,0 +1,489 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <whitgl/aabb_tree.h>
+#include <whitgl/logging.h>
+
+#include "math_internal.h"
+
+// Nodes live in one pool, unused ones chained through parent. Leaves have no
+// children and height 0.
+typedef struct
+{
+	whitgl_faabb box; // grown by margin on leaves
+	whitgl_int parent;
+	whitgl_int child1, child2;
+	whitgl_int height; // -1 when unused
+	whitgl_int id;
+} whitgl_aabb_tree_node;
+
+typedef struct
+{
+	whitgl_faabb box; // a is the min corner
+	whitgl_int leaf; // -1 when not in the tree
+} whitgl_aabb_tree_object;
+
+struct whitgl_aabb_tree
+{
+	whitgl_aabb_tree_setup setup;
+	whitgl_aabb_tree_object* objects;
+	whitgl_int num_objects;
+	whitgl_aabb_tree_node* nodes;
+	whitgl_int max_nodes;
+	whitgl_int free_node;
+	whitgl_int root;
+	whitgl_int* stack;
+	whitgl_int max_stack;
+};
+
+// boxes here are already normalized, so skip the flips in faabb_incorporate
+whitgl_faabb _whitgl_aabb_tree_union(whitgl_faabb a, whitgl_faabb b)
+{
+	whitgl_faabb out;
+	out.a.x = whitgl_fmin(a.a.x, b.a.x);
+	out.a.y = whitgl_fmin(a.a.y, b.a.y);
+	out.b.x = whitgl_fmax(a.b.x, b.b.x);
+	out.b.y = whitgl_fmax(a.b.y, b.b.y);
+	return out;
+}
+
+whitgl_float _whitgl_aabb_tree_perimeter(whitgl_faabb box)
+{
+	return 2*((box.b.x-box.a.x) + (box.b.y-box.a.y));
+}
+
+whitgl_bool _whitgl_aabb_tree_encloses(whitgl_faabb outer, whitgl_faabb inner)
+{
+	return outer.a.x <= inner.a.x && outer.a.y <= inner.a.y && outer.b.x >= inner.b.x && outer.b.y >= inner.b.y;
+}
+
+whitgl_float _whitgl_aabb_tree_sqdistance(whitgl_faabb box, whitgl_fvec p)
+{
+	whitgl_float dx = whitgl_fmax(whitgl_fmax(box.a.x-p.x, p.x-box.b.x), 0);
+	whitgl_float dy = whitgl_fmax(whitgl_fmax(box.a.y-p.y, p.y-box.b.y), 0);
+	return dx*dx + dy*dy;
+}
+
+// The pool grows on insert, never during a query
+whitgl_int _whitgl_aabb_tree_allocate(whitgl_aabb_tree* tree)
+{
+	if(tree->free_node == -1)
+	{
+		whitgl_int old_max = tree->max_nodes;
+		tree->max_nodes = whitgl_imax(256, old_max*2);
+		tree->nodes = realloc(tree->nodes, sizeof(whitgl_aabb_tree_node)*tree->max_nodes);
+		if(!tree->nodes)
+			WHITGL_PANIC("failed to grow aabb tree to %d nodes", (int)tree->max_nodes);
+		whitgl_int i;
+		for(i=old_max; i<tree->max_nodes; i++)
+		{
+			tree->nodes[i].parent = i+1 < tree->max_nodes ? i+1 : -1;
+			tree->nodes[i].height = -1;
+		}
+		tree->free_node = old_max;
+	}
+	whitgl_int n = tree->free_node;
+	whitgl_aabb_tree_node* node = &tree->nodes[n];
+	tree->free_node = node->parent;
+	node->parent = -1;
+	node->child1 = -1;
+	node->child2 = -1;
+	node->height = 0;
+	node->id = -1;
+	return n;
+}
+
+void _whitgl_aabb_tree_release(whitgl_aabb_tree* tree, whitgl_int n)
+{
+	tree->nodes[n].parent = tree->free_node;
+	tree->nodes[n].height = -1;
+	tree->free_node = n;
+}
+
+// A depth first walk never holds more than height+1 nodes
+void _whitgl_aabb_tree_reserve_stack(whitgl_aabb_tree* tree)
+{
+	whitgl_int needed = tree->nodes[tree->root].height+2;
+	if(needed <= tree->max_stack)
+		return;
+	tree->max_stack = whitgl_imax(64, needed*2);
+	tree->stack = realloc(tree->stack, sizeof(whitgl_int)*tree->max_stack);
+	if(!tree->stack)
+		WHITGL_PANIC("failed to grow aabb tree stack");
+}
+
+void _whitgl_aabb_tree_refit(whitgl_aabb_tree* tree, whitgl_int n)
+{
+	whitgl_aabb_tree_node* node = &tree->nodes[n];
+	const whitgl_aabb_tree_node* child1 = &tree->nodes[node->child1];
+	const whitgl_aabb_tree_node* child2 = &tree->nodes[node->child2];
+	node->height = 1 + whitgl_imax(child1->height, child2->height);
+	node->box = _whitgl_aabb_tree_union(child1->box, child2->box);
+}
+
+void _whitgl_aabb_tree_replace_child(whitgl_aabb_tree* tree, whitgl_int parent, whitgl_int old_child, whitgl_int new_child)
+{
+	if(parent == -1)
+		tree->root = new_child;
+	else if(tree->nodes[parent].child1 == old_child)
+		tree->nodes[parent].child1 = new_child;
+	else
+		tree->nodes[parent].child2 = new_child;
+}
+
+// If one child of a is two or more levels taller than the other, lift it into
+// a's place and hang a under it along with the shorter of its own children.
+// Returns the node now in a's place.
+whitgl_int _whitgl_aabb_tree_balance(whitgl_aabb_tree* tree, whitgl_int a)
+{
+	whitgl_aabb_tree_node* node_a = &tree->nodes[a];
+	if(node_a->height < 2)
+		return a;
+	whitgl_int b = node_a->child1;
+	whitgl_int c = node_a->child2;
+	whitgl_int balance = tree->nodes[c].height - tree->nodes[b].height;
+	if(balance >= -1 && balance <= 1)
+		return a;
+	whitgl_int up = balance > 1 ? c : b;
+	whitgl_aabb_tree_node* node_up = &tree->nodes[up];
+	whitgl_int tall = node_up->child1;
+	whitgl_int short_ = node_up->child2;
+	if(tree->nodes[tall].height < tree->nodes[short_].height)
+	{
+		tall = node_up->child2;
+		short_ = node_up->child1;
+	}
+	node_up->parent = node_a->parent;
+	_whitgl_aabb_tree_replace_child(tree, node_up->parent, a, up);
+	node_up->child1 = a;
+	node_up->child2 = tall;
+	node_a->parent = up;
+	if(up == c)
+		node_a->child2 = short_;
+	else
+		node_a->child1 = short_;
+	tree->nodes[short_].parent = a;
+	_whitgl_aabb_tree_refit(tree, a);
+	_whitgl_aabb_tree_refit(tree, up);
+	return up;
+}
+
+void _whitgl_aabb_tree_fix_upwards(whitgl_aabb_tree* tree, whitgl_int n)
+{
+	while(n != -1)
+	{
+		n = _whitgl_aabb_tree_balance(tree, n);
+		_whitgl_aabb_tree_refit(tree, n);
+		n = tree->nodes[n].parent;
+	}
+}
+
+void _whitgl_aabb_tree_insert_leaf(whitgl_aabb_tree* tree, whitgl_int leaf)
+{
+	if(tree->root == -1)
+	{
+		tree->root = leaf;
+		tree->nodes[leaf].parent = -1;
+		return;
+	}
+	// Walk down to the sibling that adds the least perimeter, counting the
+	// growth of every node above it
+	whitgl_faabb box = tree->nodes[leaf].box;
+	whitgl_int n = tree->root;
+	while(tree->nodes[n].height > 0)
+	{
+		const whitgl_aabb_tree_node* node = &tree->nodes[n];
+		whitgl_float combined = _whitgl_aabb_tree_perimeter(_whitgl_aabb_tree_union(node->box, box));
+		whitgl_float cost = 2*combined;
+		whitgl_float inherited = 2*(combined - _whitgl_aabb_tree_perimeter(node->box));
+		whitgl_float child_cost[2];
+		whitgl_int children[2] = {node->child1, node->child2};
+		whitgl_int i;
+		for(i=0; i<2; i++)
+		{
+			const whitgl_aabb_tree_node* child = &tree->nodes[children[i]];
+			child_cost[i] = _whitgl_aabb_tree_perimeter(_whitgl_aabb_tree_union(child->box, box)) + inherited;
+			if(child->height > 0)
+				child_cost[i] -= _whitgl_aabb_tree_perimeter(child->box);
+		}
+		if(cost < child_cost[0] && cost < child_cost[1])
+			break;
+		n = child_cost[0] < child_cost[1] ? children[0] : children[1];
+	}
+	whitgl_int sibling = n;
+	whitgl_int old_parent = tree->nodes[sibling].parent;
+	whitgl_int parent = _whitgl_aabb_tree_allocate(tree);
+	whitgl_aabb_tree_node* node = &tree->nodes[parent];
+	node->parent = old_parent;
+	node->child1 = sibling;
+	node->child2 = leaf;
+	_whitgl_aabb_tree_replace_child(tree, old_parent, sibling, parent);
+	tree->nodes[sibling].parent = parent;
+	tree->nodes[leaf].parent = parent;
+	_whitgl_aabb_tree_fix_upwards(tree, parent);
+}
+
+void _whitgl_aabb_tree_remove_leaf(whitgl_aabb_tree* tree, whitgl_int leaf)
+{
+	if(leaf == tree->root)
+	{
+		tree->root = -1;
+		return;
+	}
+	whitgl_int parent = tree->nodes[leaf].parent;
+	whitgl_int grandparent = tree->nodes[parent].parent;
+	whitgl_int sibling = tree->nodes[parent].child1 == leaf ? tree->nodes[parent].child2 : tree->nodes[parent].child1;
+	_whitgl_aabb_tree_replace_child(tree, grandparent, parent, sibling);
+	tree->nodes[sibling].parent = grandparent;
+	_whitgl_aabb_tree_release(tree, parent);
+	_whitgl_aabb_tree_fix_upwards(tree, grandparent);
+}
+
+void _whitgl_aabb_tree_check_id(const whitgl_aabb_tree* tree, whitgl_int id)
+{
+	if(id < 0 || id >= tree->setup.max_objects)
+		WHITGL_PANIC("aabb tree id %d out of range", (int)id);
+}
+
+whitgl_aabb_tree* whitgl_aabb_tree_create(whitgl_aabb_tree_setup setup)
+{
+	if(setup.margin < 0 || setup.max_objects <= 0)
+		WHITGL_PANIC("invalid aabb tree setup");
+	whitgl_aabb_tree* tree = malloc(sizeof(whitgl_aabb_tree));
+	if(!tree)
+		WHITGL_PANIC("failed to allocate aabb tree");
+	tree->setup = setup;
+	tree->objects = malloc(sizeof(whitgl_aabb_tree_object)*setup.max_objects);
+	if(!tree->objects)
+		WHITGL_PANIC("failed to allocate aabb tree");
+	tree->nodes = NULL;
+	tree->max_nodes = 0;
+	tree->stack = NULL;
+	tree->max_stack = 0;
+	whitgl_aabb_tree_clear(tree);
+	return tree;
+}
+
+void whitgl_aabb_tree_destroy(whitgl_aabb_tree* tree)
+{
+	free(tree->objects);
+	free(tree->nodes);
+	free(tree->stack);
+	free(tree);
+}
+
+void whitgl_aabb_tree_clear(whitgl_aabb_tree* tree)
+{
+	whitgl_int i;
+	for(i=0; i<tree->setup.max_objects; i++)
+		tree->objects[i].leaf = -1;
+	tree->num_objects = 0;
+	for(i=0; i<tree->max_nodes; i++)
+	{
+		tree->nodes[i].parent = i+1 < tree->max_nodes ? i+1 : -1;
+		tree->nodes[i].height = -1;
+	}
+	tree->free_node = tree->max_nodes > 0 ? 0 : -1;
+	tree->root = -1;
+}
+
+void whitgl_aabb_tree_insert(whitgl_aabb_tree* tree, whitgl_int id, whitgl_faabb box)
+{
+	_whitgl_aabb_tree_check_id(tree, id);
+	whitgl_aabb_tree_object* object = &tree->objects[id];
+	if(object->leaf != -1)
+	{
+		_whitgl_aabb_tree_remove_leaf(tree, object->leaf);
+		_whitgl_aabb_tree_release(tree, object->leaf);
+	}
+	else
+		tree->num_objects++;
+	object->box = _whitgl_faabb_normalize(box);
+	whitgl_int leaf = _whitgl_aabb_tree_allocate(tree);
+	whitgl_fvec margin = {tree->setup.margin, tree->setup.margin};
+	tree->nodes[leaf].box.a = whitgl_fvec_sub(object->box.a, margin);
+	tree->nodes[leaf].box.b = whitgl_fvec_add(object->box.b, margin);
+	tree->nodes[leaf].id = id;
+	object->leaf = leaf;
+	_whitgl_aabb_tree_insert_leaf(tree, leaf);
+	_whitgl_aabb_tree_reserve_stack(tree);
+}
+
+whitgl_bool whitgl_aabb_tree_update(whitgl_aabb_tree* tree, whitgl_int id, whitgl_faabb box)
+{
+	_whitgl_aabb_tree_check_id(tree, id);
+	whitgl_aabb_tree_object* object = &tree->objects[id];
+	box = _whitgl_faabb_normalize(box);
+	if(object->leaf == -1 || !_whitgl_aabb_tree_encloses(tree->nodes[object->leaf].box, box))
+	{
+		whitgl_aabb_tree_insert(tree, id, box);
+		return true;
+	}
+	object->box = box;
+	return false;
+}
+
+void whitgl_aabb_tree_remove(whitgl_aabb_tree* tree, whitgl_int id)
+{
+	_whitgl_aabb_tree_check_id(tree, id);
+	whitgl_aabb_tree_object* object = &tree->objects[id];
+	if(object->leaf == -1)
+		return;
+	_whitgl_aabb_tree_remove_leaf(tree, object->leaf);
+	_whitgl_aabb_tree_release(tree, object->leaf);
+	object->leaf = -1;
+	tree->num_objects--;
+}
+
+whitgl_bool whitgl_aabb_tree_contains(const whitgl_aabb_tree* tree, whitgl_int id)
+{
+	if(id < 0 || id >= tree->setup.max_objects)
+		return false;
+	return tree->objects[id].leaf != -1;
+}
+
+whitgl_int whitgl_aabb_tree_count(const whitgl_aabb_tree* tree)
+{
+	return tree->num_objects;
+}
+
+whitgl_int whitgl_aabb_tree_height(const whitgl_aabb_tree* tree)
+{
+	if(tree->root == -1)
+		return 0;
+	return tree->nodes[tree->root].height+1;
+}
+
+whitgl_int whitgl_aabb_tree_query_region(whitgl_aabb_tree* tree, whitgl_faabb region, whitgl_int* out, whitgl_int max_out)
+{
+	if(tree->root == -1)
+		return 0;
+	region = _whitgl_faabb_normalize(region);
+	whitgl_int found = 0;
+	whitgl_int top = 0;
+	tree->stack[top++] = tree->root;
+	while(top > 0)
+	{
+		const whitgl_aabb_tree_node* node = &tree->nodes[tree->stack[--top]];
+		if(!whitgl_faabb_intersects(node->box, region))
+			continue;
+		if(node->height > 0)
+		{
+			tree->stack[top++] = node->child1;
+			tree->stack[top++] = node->child2;
+			continue;
+		}
+		if(!whitgl_faabb_intersects(tree->objects[node->id].box, region))
+			continue;
+		if(found < max_out)
+			out[found] = node->id;
+		found++;
+	}
+	return found;
+}
+
+whitgl_int whitgl_aabb_tree_query_point(whitgl_aabb_tree* tree, whitgl_fvec p, whitgl_int* out, whitgl_int max_out)
+{
+	if(tree->root == -1)
+		return 0;
+	whitgl_int found = 0;
+	whitgl_int top = 0;
+	tree->stack[top++] = tree->root;
+	while(top > 0)
+	{
+		const whitgl_aabb_tree_node* node = &tree->nodes[tree->stack[--top]];
+		if(!whitgl_fvec_point_in_rect(p, node->box))
+			continue;
+		if(node->height > 0)
+		{
+			tree->stack[top++] = node->child1;
+			tree->stack[top++] = node->child2;
+			continue;
+		}
+		if(!whitgl_fvec_point_in_rect(p, tree->objects[node->id].box))
+			continue;
+		if(found < max_out)
+			out[found] = node->id;
+		found++;
+	}
+	return found;
+}
+
+whitgl_bool whitgl_aabb_tree_raycast(whitgl_aabb_tree* tree, whitgl_fvec start, whitgl_fvec speed, whitgl_float max_t, whitgl_aabb_tree_hit* hit)
+{
+	*hit = whitgl_aabb_tree_hit_zero;
+	if(tree->root == -1)
+		return false;
+	whitgl_float best = max_t;
+	whitgl_int top = 0;
+	tree->stack[top++] = tree->root;
+	while(top > 0)
+	{
+		const whitgl_aabb_tree_node* node = &tree->nodes[tree->stack[--top]];
+		whitgl_float t1, t2;
+		if(!whitgl_ray_faabb_intersect(node->box, start, speed, &t1, &t2))
+			continue;
+		if(t2 < 0 || t1 > best)
+			continue;
+		if(node->height > 0)
+		{
+			tree->stack[top++] = node->child1;
+			tree->stack[top++] = node->child2;
+			continue;
+		}
+		if(!whitgl_ray_faabb_intersect(tree->objects[node->id].box, start, speed, &t1, &t2))
+			continue;
+		if(t2 < 0 || t1 > best)
+			continue;
+		t1 = whitgl_fmax(t1, 0);
+		if(hit->id != -1 && t1 == best && node->id > hit->id)
+			continue; // equal hits go to the lowest id so results don't depend on tree shape
+		best = t1;
+		hit->id = node->id;
+		hit->t = t1;
+	}
+	return hit->id != -1;
+}
+
+// Depth first, nearer child first, skipping anything farther than the worst
+// of the k found so far. out holds squared distances until the end.
+whitgl_int whitgl_aabb_tree_nearest(whitgl_aabb_tree* tree, whitgl_fvec p, whitgl_aabb_tree_hit* out, whitgl_int k)
+{
+	if(tree->root == -1 || k <= 0)
+		return 0;
+	whitgl_int found = 0;
+	whitgl_int top = 0;
+	tree->stack[top++] = tree->root;
+	while(top > 0)
+	{
+		const whitgl_aabb_tree_node* node = &tree->nodes[tree->stack[--top]];
+		if(found == k && _whitgl_aabb_tree_sqdistance(node->box, p) > out[k-1].t)
+			continue;
+		if(node->height > 0)
+		{
+			whitgl_float d1 = _whitgl_aabb_tree_sqdistance(tree->nodes[node->child1].box, p);
+			whitgl_float d2 = _whitgl_aabb_tree_sqdistance(tree->nodes[node->child2].box, p);
+			tree->stack[top++] = d1 < d2 ? node->child2 : node->child1;
+			tree->stack[top++] = d1 < d2 ? node->child1 : node->child2;
+			continue;
+		}
+		whitgl_float d = _whitgl_aabb_tree_sqdistance(tree->objects[node->id].box, p);
+		// keep out sorted, equal distances ordered by id
+		whitgl_int i = found < k ? found++ : k;
+		while(i > 0 && (out[i-1].t > d || (out[i-1].t == d && out[i-1].id > node->id)))
+		{
+			if(i < k)
+				out[i] = out[i-1];
+			i--;
+		}
+		if(i < k)
+		{
+			out[i].id = node->id;
+			out[i].t = d;
+		}
+	}
+	whitgl_int i;
+	for(i=0; i<found; i++)
+		out[i].t = whitgl_fsqrt(out[i].t);
+	return found;
+}
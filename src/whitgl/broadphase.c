@@ -0,0 +1,370 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <whitgl/broadphase.h>
+#include <whitgl/logging.h>
+
+#include "math_internal.h"
+
+// Cell entries live in one pool. Each is on a doubly linked list for its hash
+// bucket, so removal doesn't search, and on a singly linked list of the cells
+// of its object.
+typedef struct
+{
+	int32_t cell_x, cell_y;
+	whitgl_int object;
+	whitgl_int bucket_prev, bucket_next;
+	whitgl_int object_next;
+} whitgl_broadphase_entry;
+
+typedef struct
+{
+	whitgl_faabb box; // a is the min corner
+	whitgl_iaabb cells; // inclusive
+	whitgl_int first_entry;
+	uint32_t stamp;
+	whitgl_bool active;
+} whitgl_broadphase_object;
+
+struct whitgl_broadphase
+{
+	whitgl_broadphase_setup setup;
+	whitgl_float cell_size_1;
+	whitgl_int* buckets;
+	whitgl_broadphase_object* objects;
+	whitgl_int num_objects;
+	whitgl_broadphase_entry* entries;
+	whitgl_int max_entries;
+	whitgl_int free_entry;
+	uint32_t stamp;
+};
+
+whitgl_int _whitgl_broadphase_bucket(const whitgl_broadphase* bp, int32_t x, int32_t y)
+{
+	uint32_t h = ((uint32_t)x*73856093u) ^ ((uint32_t)y*19349663u);
+	return h & (bp->setup.num_buckets-1);
+}
+
+whitgl_iaabb _whitgl_broadphase_cells(const whitgl_broadphase* bp, whitgl_faabb box)
+{
+	whitgl_iaabb out;
+	out.a.x = floor(box.a.x*bp->cell_size_1);
+	out.a.y = floor(box.a.y*bp->cell_size_1);
+	out.b.x = floor(box.b.x*bp->cell_size_1);
+	out.b.y = floor(box.b.y*bp->cell_size_1);
+	return out;
+}
+
+// Counted in floats so a huge box can't overflow the cell coordinates
+whitgl_float _whitgl_broadphase_num_cells(const whitgl_broadphase* bp, whitgl_faabb box)
+{
+	whitgl_float w = floor(box.b.x*bp->cell_size_1) - floor(box.a.x*bp->cell_size_1) + 1;
+	whitgl_float h = floor(box.b.y*bp->cell_size_1) - floor(box.a.y*bp->cell_size_1) + 1;
+	return w*h;
+}
+
+whitgl_iaabb _whitgl_broadphase_object_cells(const whitgl_broadphase* bp, whitgl_faabb box)
+{
+	whitgl_float num_cells = _whitgl_broadphase_num_cells(bp, box);
+	if(!(num_cells <= WHITGL_BROADPHASE_MAX_CELLS))
+		WHITGL_PANIC("broadphase box spans %g cells, more than %d", (double)num_cells, WHITGL_BROADPHASE_MAX_CELLS);
+	return _whitgl_broadphase_cells(bp, box);
+}
+
+// The pool grows on insert, never during a query
+void _whitgl_broadphase_grow(whitgl_broadphase* bp)
+{
+	whitgl_int old_max = bp->max_entries;
+	bp->max_entries = whitgl_imax(256, old_max*2);
+	bp->entries = realloc(bp->entries, sizeof(whitgl_broadphase_entry)*bp->max_entries);
+	if(!bp->entries)
+		WHITGL_PANIC("failed to grow broadphase to %d entries", (int)bp->max_entries);
+	whitgl_int i;
+	for(i=old_max; i<bp->max_entries; i++)
+		bp->entries[i].object_next = i+1 < bp->max_entries ? i+1 : bp->free_entry;
+	bp->free_entry = old_max;
+}
+
+whitgl_broadphase* whitgl_broadphase_create(whitgl_broadphase_setup setup)
+{
+	if(setup.cell_size <= 0 || setup.max_objects <= 0)
+		WHITGL_PANIC("invalid broadphase setup");
+	whitgl_int buckets = 1;
+	while(buckets < setup.num_buckets)
+		buckets *= 2;
+	setup.num_buckets = buckets;
+	whitgl_broadphase* bp = malloc(sizeof(whitgl_broadphase));
+	if(!bp)
+		WHITGL_PANIC("failed to allocate broadphase");
+	bp->setup = setup;
+	bp->cell_size_1 = 1/setup.cell_size;
+	bp->buckets = malloc(sizeof(whitgl_int)*setup.num_buckets);
+	bp->objects = malloc(sizeof(whitgl_broadphase_object)*setup.max_objects);
+	bp->entries = NULL;
+	bp->max_entries = 0;
+	if(!bp->buckets || !bp->objects)
+		WHITGL_PANIC("failed to allocate broadphase");
+	whitgl_broadphase_clear(bp);
+	return bp;
+}
+
+void whitgl_broadphase_destroy(whitgl_broadphase* bp)
+{
+	free(bp->buckets);
+	free(bp->objects);
+	free(bp->entries);
+	free(bp);
+}
+
+void whitgl_broadphase_clear(whitgl_broadphase* bp)
+{
+	whitgl_int i;
+	for(i=0; i<bp->setup.num_buckets; i++)
+		bp->buckets[i] = -1;
+	memset(bp->objects, 0, sizeof(whitgl_broadphase_object)*bp->setup.max_objects);
+	bp->num_objects = 0;
+	bp->free_entry = -1;
+	for(i=0; i<bp->max_entries; i++)
+		bp->entries[i].object_next = i+1 < bp->max_entries ? i+1 : -1;
+	if(bp->max_entries > 0)
+		bp->free_entry = 0;
+	bp->stamp = 0;
+}
+
+void _whitgl_broadphase_link(whitgl_broadphase* bp, whitgl_int id)
+{
+	whitgl_broadphase_object* object = &bp->objects[id];
+	object->first_entry = -1;
+	whitgl_int x, y;
+	for(y=object->cells.a.y; y<=object->cells.b.y; y++)
+	{
+		for(x=object->cells.a.x; x<=object->cells.b.x; x++)
+		{
+			if(bp->free_entry == -1)
+				_whitgl_broadphase_grow(bp);
+			whitgl_int e = bp->free_entry;
+			whitgl_broadphase_entry* entry = &bp->entries[e];
+			bp->free_entry = entry->object_next;
+			whitgl_int bucket = _whitgl_broadphase_bucket(bp, x, y);
+			entry->cell_x = x;
+			entry->cell_y = y;
+			entry->object = id;
+			entry->bucket_prev = -1;
+			entry->bucket_next = bp->buckets[bucket];
+			if(entry->bucket_next != -1)
+				bp->entries[entry->bucket_next].bucket_prev = e;
+			bp->buckets[bucket] = e;
+			entry->object_next = object->first_entry;
+			object->first_entry = e;
+		}
+	}
+}
+
+void _whitgl_broadphase_unlink(whitgl_broadphase* bp, whitgl_int id)
+{
+	whitgl_int e = bp->objects[id].first_entry;
+	while(e != -1)
+	{
+		whitgl_broadphase_entry* entry = &bp->entries[e];
+		whitgl_int next = entry->object_next;
+		if(entry->bucket_prev != -1)
+			bp->entries[entry->bucket_prev].bucket_next = entry->bucket_next;
+		else
+			bp->buckets[_whitgl_broadphase_bucket(bp, entry->cell_x, entry->cell_y)] = entry->bucket_next;
+		if(entry->bucket_next != -1)
+			bp->entries[entry->bucket_next].bucket_prev = entry->bucket_prev;
+		entry->object_next = bp->free_entry;
+		bp->free_entry = e;
+		e = next;
+	}
+	bp->objects[id].first_entry = -1;
+}
+
+void _whitgl_broadphase_check_id(const whitgl_broadphase* bp, whitgl_int id)
+{
+	if(id < 0 || id >= bp->setup.max_objects)
+		WHITGL_PANIC("broadphase id %d out of range", (int)id);
+}
+
+void whitgl_broadphase_insert(whitgl_broadphase* bp, whitgl_int id, whitgl_faabb box)
+{
+	_whitgl_broadphase_check_id(bp, id);
+	whitgl_broadphase_object* object = &bp->objects[id];
+	if(object->active)
+		_whitgl_broadphase_unlink(bp, id);
+	else
+		bp->num_objects++;
+	object->active = true;
+	object->box = _whitgl_faabb_normalize(box);
+	object->cells = _whitgl_broadphase_object_cells(bp, object->box);
+	_whitgl_broadphase_link(bp, id);
+}
+
+void whitgl_broadphase_update(whitgl_broadphase* bp, whitgl_int id, whitgl_faabb box)
+{
+	_whitgl_broadphase_check_id(bp, id);
+	whitgl_broadphase_object* object = &bp->objects[id];
+	box = _whitgl_faabb_normalize(box);
+	whitgl_iaabb cells = _whitgl_broadphase_object_cells(bp, box);
+	if(!object->active || !whitgl_ivec_eq(cells.a, object->cells.a) || !whitgl_ivec_eq(cells.b, object->cells.b))
+	{
+		whitgl_broadphase_insert(bp, id, box);
+		return;
+	}
+	object->box = box;
+}
+
+void whitgl_broadphase_remove(whitgl_broadphase* bp, whitgl_int id)
+{
+	_whitgl_broadphase_check_id(bp, id);
+	if(!bp->objects[id].active)
+		return;
+	_whitgl_broadphase_unlink(bp, id);
+	bp->objects[id].active = false;
+	bp->num_objects--;
+}
+
+whitgl_bool whitgl_broadphase_contains(const whitgl_broadphase* bp, whitgl_int id)
+{
+	if(id < 0 || id >= bp->setup.max_objects)
+		return false;
+	return bp->objects[id].active;
+}
+
+whitgl_int whitgl_broadphase_count(const whitgl_broadphase* bp)
+{
+	return bp->num_objects;
+}
+
+void whitgl_broadphase_insert_iaabb(whitgl_broadphase* bp, whitgl_int id, whitgl_iaabb box)
+{
+	whitgl_broadphase_insert(bp, id, whitgl_iaabb_to_faabb(box));
+}
+
+void whitgl_broadphase_update_iaabb(whitgl_broadphase* bp, whitgl_int id, whitgl_iaabb box)
+{
+	whitgl_broadphase_update(bp, id, whitgl_iaabb_to_faabb(box));
+}
+
+// Objects are stamped as they are seen so one spanning several cells is
+// only tested once per query
+uint32_t _whitgl_broadphase_next_stamp(whitgl_broadphase* bp)
+{
+	bp->stamp++;
+	if(bp->stamp == 0)
+	{
+		whitgl_int i;
+		for(i=0; i<bp->setup.max_objects; i++)
+			bp->objects[i].stamp = 0;
+		bp->stamp = 1;
+	}
+	return bp->stamp;
+}
+
+whitgl_int whitgl_broadphase_query_region(whitgl_broadphase* bp, whitgl_faabb region, whitgl_int* out, whitgl_int max_out)
+{
+	uint32_t stamp = _whitgl_broadphase_next_stamp(bp);
+	region = _whitgl_faabb_normalize(region);
+	whitgl_int found = 0;
+	// a region over more cells than there are objects is quicker, and can't
+	// overflow, checking every object
+	if(!(_whitgl_broadphase_num_cells(bp, region) <= whitgl_imax(bp->num_objects, 1)))
+	{
+		whitgl_int i;
+		for(i=0; i<bp->setup.max_objects; i++)
+		{
+			if(!bp->objects[i].active || !whitgl_faabb_intersects(bp->objects[i].box, region))
+				continue;
+			if(found < max_out)
+				out[found] = i;
+			found++;
+		}
+		return found;
+	}
+	whitgl_iaabb cells = _whitgl_broadphase_cells(bp, region);
+	whitgl_int x, y;
+	for(y=cells.a.y; y<=cells.b.y; y++)
+	{
+		for(x=cells.a.x; x<=cells.b.x; x++)
+		{
+			whitgl_int e = bp->buckets[_whitgl_broadphase_bucket(bp, x, y)];
+			for(; e != -1; e = bp->entries[e].bucket_next)
+			{
+				const whitgl_broadphase_entry* entry = &bp->entries[e];
+				if(entry->cell_x != x || entry->cell_y != y)
+					continue;
+				whitgl_broadphase_object* object = &bp->objects[entry->object];
+				if(object->stamp == stamp)
+					continue;
+				object->stamp = stamp;
+				if(!whitgl_faabb_intersects(object->box, region))
+					continue;
+				if(found < max_out)
+					out[found] = entry->object;
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+whitgl_int whitgl_broadphase_query_region_iaabb(whitgl_broadphase* bp, whitgl_iaabb region, whitgl_int* out, whitgl_int max_out)
+{
+	return whitgl_broadphase_query_region(bp, whitgl_iaabb_to_faabb(region), out, max_out);
+}
+
+whitgl_int whitgl_broadphase_query_point(whitgl_broadphase* bp, whitgl_fvec p, whitgl_int* out, whitgl_int max_out)
+{
+	int32_t x = floor(p.x*bp->cell_size_1);
+	int32_t y = floor(p.y*bp->cell_size_1);
+	whitgl_int found = 0;
+	whitgl_int e = bp->buckets[_whitgl_broadphase_bucket(bp, x, y)];
+	for(; e != -1; e = bp->entries[e].bucket_next)
+	{
+		const whitgl_broadphase_entry* entry = &bp->entries[e];
+		if(entry->cell_x != x || entry->cell_y != y)
+			continue;
+		if(!whitgl_fvec_point_in_rect(p, bp->objects[entry->object].box))
+			continue;
+		if(found < max_out)
+			out[found] = entry->object;
+		found++;
+	}
+	return found;
+}
+
+whitgl_int whitgl_broadphase_pairs(const whitgl_broadphase* bp, whitgl_broadphase_pair* out, whitgl_int max_out)
+{
+	whitgl_int found = 0;
+	whitgl_int bucket;
+	for(bucket=0; bucket<bp->setup.num_buckets; bucket++)
+	{
+		whitgl_int i, j;
+		for(i = bp->buckets[bucket]; i != -1; i = bp->entries[i].bucket_next)
+		{
+			const whitgl_broadphase_entry* a = &bp->entries[i];
+			const whitgl_broadphase_object* object_a = &bp->objects[a->object];
+			for(j = a->bucket_next; j != -1; j = bp->entries[j].bucket_next)
+			{
+				const whitgl_broadphase_entry* b = &bp->entries[j];
+				if(a->cell_x != b->cell_x || a->cell_y != b->cell_y)
+					continue;
+				const whitgl_broadphase_object* object_b = &bp->objects[b->object];
+				// a pair sharing several cells is only counted in the first
+				if(a->cell_x != whitgl_imax(object_a->cells.a.x, object_b->cells.a.x) ||
+				   a->cell_y != whitgl_imax(object_a->cells.a.y, object_b->cells.a.y))
+					continue;
+				if(!whitgl_faabb_intersects(object_a->box, object_b->box))
+					continue;
+				if(found < max_out)
+				{
+					out[found].a = whitgl_imin(a->object, b->object);
+					out[found].b = whitgl_imax(a->object, b->object);
+				}
+				found++;
+			}
+		}
+	}
+	return found;
+}
@@ -1,7 +1,10 @@
 #include <whitgl/debug.h>
 #include <whitgl/input.h>
 #include <whitgl/logging.h>
+#include <whitgl/memory.h>
+#include <whitgl/profile.h>
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -147,3 +150,159 @@ void whitgl_debug_menu_draw(whitgl_debug_menu debug)
 		draw_pos.y += debug.text_sprite.size.y;
 	}
 }
+
+typedef struct
+{
+	whitgl_bool active;
+	whitgl_ivec pos;
+	whitgl_sprite text_sprite;
+	whitgl_float target;
+	whitgl_float samples[WHITGL_DEBUG_OVERLAY_SAMPLES];
+	whitgl_int next_sample;
+	whitgl_int num_samples;
+	uint64_t last_ns;
+} whitgl_debug_overlay;
+whitgl_debug_overlay _overlay = {false, {0,0}, {0,{0,0},{0,0}}, 1.0/60.0, {0}, 0, 0, 0};
+
+#define WHITGL_DEBUG_OVERLAY_MAX_LINES (24)
+#define WHITGL_DEBUG_OVERLAY_LINE_LENGTH (32) // lines*length glyphs fit one sprite batch
+#define WHITGL_DEBUG_OVERLAY_GRAPH_LINES (4) // graph height in lines of text
+
+void whitgl_debug_overlay_init(whitgl_ivec pos, whitgl_sprite text_sprite)
+{
+	_overlay.pos = pos;
+	_overlay.text_sprite = text_sprite;
+	_overlay.next_sample = 0;
+	_overlay.num_samples = 0;
+	_overlay.last_ns = 0;
+}
+void whitgl_debug_overlay_set_active(whitgl_bool active)
+{
+	_overlay.active = active;
+}
+whitgl_bool whitgl_debug_overlay_active()
+{
+	return _overlay.active;
+}
+void whitgl_debug_overlay_set_target(whitgl_float seconds)
+{
+	_overlay.target = seconds;
+}
+
+// Rectangles as thick lines, so they share the colour batch with the graph
+void _whitgl_debug_overlay_rect(whitgl_float left, whitgl_float top, whitgl_float right, whitgl_float bottom, whitgl_sys_color col)
+{
+	if(right <= left || bottom <= top)
+		return;
+	whitgl_float mid = (top+bottom)/2;
+	whitgl_fvec a = {left, mid};
+	whitgl_fvec b = {right, mid};
+	whitgl_sys_draw_thick_line(a, b, bottom-top, col);
+}
+
+whitgl_sys_color _whitgl_debug_overlay_sample_color(whitgl_float sample)
+{
+	whitgl_sys_color good = {0x40,0xe0,0x40,0xff};
+	whitgl_sys_color slow = {0xf0,0xd0,0x30,0xff};
+	whitgl_sys_color hitch = {0xff,0x30,0x30,0xff};
+	if(sample > _overlay.target*2)
+		return hitch;
+	if(sample > _overlay.target*1.1)
+		return slow;
+	return good;
+}
+
+void whitgl_debug_overlay_draw()
+{
+	uint64_t now = whitgl_profile_now_ns();
+	if(_overlay.last_ns != 0)
+	{
+		_overlay.samples[_overlay.next_sample] = (now-_overlay.last_ns)/1000000000.0;
+		_overlay.next_sample = (_overlay.next_sample+1)%WHITGL_DEBUG_OVERLAY_SAMPLES;
+		_overlay.num_samples = whitgl_imin(_overlay.num_samples+1, WHITGL_DEBUG_OVERLAY_SAMPLES);
+	}
+	_overlay.last_ns = now;
+	if(!_overlay.active)
+		return;
+
+	// Text is laid out first so the backing can cover it
+	char lines[WHITGL_DEBUG_OVERLAY_MAX_LINES][WHITGL_DEBUG_OVERLAY_LINE_LENGTH];
+	whitgl_float bars[WHITGL_DEBUG_OVERLAY_MAX_LINES]; // GPU seconds behind the line, or 0
+	whitgl_int num_lines = 0;
+	whitgl_int i;
+	for(i=0; i<WHITGL_DEBUG_OVERLAY_MAX_LINES; i++)
+		bars[i] = 0;
+	#define WHITGL_DEBUG_OVERLAY_LINE(...) snprintf(lines[num_lines++], WHITGL_DEBUG_OVERLAY_LINE_LENGTH, __VA_ARGS__)
+
+	whitgl_float last = 0;
+	if(_overlay.num_samples > 0)
+		last = _overlay.samples[(_overlay.next_sample+WHITGL_DEBUG_OVERLAY_SAMPLES-1)%WHITGL_DEBUG_OVERLAY_SAMPLES];
+	whitgl_profile_distribution frame = whitgl_profile_get_distribution(WHITGL_PROFILE_FRAME);
+	whitgl_profile_distribution gpu = whitgl_profile_get_distribution(WHITGL_PROFILE_GPU);
+	WHITGL_DEBUG_OVERLAY_LINE("frame %5.1f p99 %5.1f max %5.1f", last*1000, frame.p99*1000, frame.max*1000);
+	WHITGL_DEBUG_OVERLAY_LINE("stutters %d/%d total %d", (int)frame.stutters, (int)frame.count, (int)frame.total_stutters);
+	WHITGL_DEBUG_OVERLAY_LINE("gpu %5.2f p99 %5.2f", gpu.p50*1000, gpu.p99*1000);
+
+	whitgl_sys_stats stats = whitgl_sys_get_stats();
+	whitgl_memory_usage memory = whitgl_memory_get_total();
+	WHITGL_DEBUG_OVERLAY_LINE("draws %d verts %d", (int)stats.draw_calls, (int)stats.vertices);
+	WHITGL_DEBUG_OVERLAY_LINE("flushes %d tex %d uni %d", (int)stats.flushes, (int)stats.flush_reasons[WHITGL_FLUSH_TEXTURE], (int)stats.flush_reasons[WHITGL_FLUSH_UNIFORM]);
+	WHITGL_DEBUG_OVERLAY_LINE("upload %dK prog %d fb %d", (int)(stats.upload_bytes/1024), (int)stats.program_switches, (int)stats.framebuffer_binds);
+	WHITGL_DEBUG_OVERLAY_LINE("mem %.1fM peak %.1fM", memory.bytes/(1024.0*1024.0), memory.peak/(1024.0*1024.0));
+
+	const whitgl_profile_gpu_result* results;
+	whitgl_int num_results = whitgl_profile_gpu_results(&results);
+	for(i=0; i<num_results && num_lines<WHITGL_DEBUG_OVERLAY_MAX_LINES; i++)
+	{
+		bars[num_lines] = results[i].duration;
+		WHITGL_DEBUG_OVERLAY_LINE("%*s%-14.14s %5.2f", (int)results[i].depth, "", results[i].name, results[i].duration*1000);
+	}
+	#undef WHITGL_DEBUG_OVERLAY_LINE
+
+	whitgl_ivec glyph = _overlay.text_sprite.size;
+	whitgl_float width = glyph.x*(WHITGL_DEBUG_OVERLAY_LINE_LENGTH-1);
+	whitgl_float graph_height = glyph.y*WHITGL_DEBUG_OVERLAY_GRAPH_LINES;
+	whitgl_float left = _overlay.pos.x;
+	whitgl_float top = _overlay.pos.y;
+	whitgl_float text_top = top+graph_height+1;
+	whitgl_sys_color backing = {0x00,0x00,0x00,0xa0};
+	whitgl_sys_color guide = {0xff,0xff,0xff,0x40};
+	whitgl_sys_color bar = {0x30,0x60,0xff,0x90};
+	_whitgl_debug_overlay_rect(left-1, top-1, left+width+1, text_top+num_lines*glyph.y, backing);
+
+	// Guides at the target and at twice it, the top of the graph
+	whitgl_float target_y = top+graph_height/2;
+	_whitgl_debug_overlay_rect(left, target_y, left+width, target_y+1, guide);
+	_whitgl_debug_overlay_rect(left, top, left+width, top+1, guide);
+
+	// Newest sample on the right
+	whitgl_fvec points[WHITGL_DEBUG_OVERLAY_SAMPLES];
+	whitgl_sys_color colors[WHITGL_DEBUG_OVERLAY_SAMPLES];
+	whitgl_float spacing = width/(WHITGL_DEBUG_OVERLAY_SAMPLES-1);
+	whitgl_int first = WHITGL_DEBUG_OVERLAY_SAMPLES-_overlay.num_samples;
+	for(i=0; i<_overlay.num_samples; i++)
+	{
+		whitgl_int index = (_overlay.next_sample+first+i)%WHITGL_DEBUG_OVERLAY_SAMPLES;
+		whitgl_float sample = _overlay.samples[index];
+		whitgl_float height = whitgl_fclamp(sample/(_overlay.target*2), 0, 1)*graph_height;
+		points[i].x = left+(first+i)*spacing;
+		points[i].y = top+graph_height-height;
+		colors[i] = _whitgl_debug_overlay_sample_color(sample);
+	}
+	whitgl_sys_draw_polyline_colored(points, colors, _overlay.num_samples, 1, WHITGL_LINE_JOIN_MITER, false);
+
+	// GPU bars span the overlay at one target's worth of time
+	for(i=0; i<num_lines; i++)
+	{
+		if(bars[i] <= 0)
+			continue;
+		whitgl_float line_top = text_top+i*glyph.y;
+		_whitgl_debug_overlay_rect(left, line_top, left+whitgl_fmin(bars[i]/_overlay.target, 1)*width, line_top+glyph.y, bar);
+	}
+
+	for(i=0; i<num_lines; i++)
+	{
+		whitgl_ivec text_pos = {_overlay.pos.x, text_top+i*glyph.y};
+		whitgl_sys_draw_text(_overlay.text_sprite, lines[i], text_pos);
+	}
+}
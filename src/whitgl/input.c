@@ -262,6 +262,12 @@ void whitgl_input_update()
 	for(i=0; i<WHITGL_INPUT_MAX; i++)
 		_pressedInputs[i] = !_oldInputs[i] && _heldInputs[i];
 
+	whitgl_input_update_cursor();
+}
+// Cursor only, so it can be refreshed after whitgl_input_update without
+// losing pressed events
+void whitgl_input_update_cursor()
+{
 	double x, y;
 	glfwGetCursorPos(_window, &x, &y);
 	_mouse_pos.x = (whitgl_int)x;
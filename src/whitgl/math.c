@@ -1,528 +1,119 @@
+// The out of line helpers are always built, so the library links the same way
+// whether or not the code calling it defines WHITGL_MATH_INLINE.
+#undef WHITGL_MATH_INLINE
+
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <whitgl/logging.h>
 #include <whitgl/math.h>
 
-whitgl_int whitgl_imin(whitgl_int a, whitgl_int b)
-{
-	if(a < b) return a;
-	return b;
-}
-whitgl_int whitgl_imax(whitgl_int a, whitgl_int b)
-{
-	if(a > b) return a;
-	return b;
-}
-whitgl_int whitgl_iclamp(whitgl_int a, whitgl_int min, whitgl_int max)
-{
-	if(min > max) WHITGL_PANIC("ERR min > than max!");
-	if(a < min) return min;
-	if(a > max) return max;
-	return a;
-}
-whitgl_int whitgl_iwrap(whitgl_int a, whitgl_int min, whitgl_int max)
-{
-	whitgl_int size = max-min;
-	a = ((a-min)%size)+min;
-	while(a < min)
-		a += size;
-	while(a >= max)
-		a -= size;
-	return a;
-}
-whitgl_int whitgl_ipow(whitgl_int a, whitgl_int b)
-{
-	return pow(a,b);
-}
-
-whitgl_ivec whitgl_ivec_bound(whitgl_ivec a, whitgl_iaabb bounds)
-{
-	if(bounds.a.x > bounds.b.x)
+// Matrix kernels use GCC/clang vector extensions, which become SSE on x86 and
+// NEON on ARM. Define WHITGL_NO_SIMD for the plain C versions.
+#if !defined(WHITGL_NO_SIMD) && (defined(__clang__) || defined(__GNUC__))
+#define WHITGL_MATH_SIMD
+typedef float whitgl_math_v4f __attribute__((vector_size(16)));
+typedef whitgl_float whitgl_math_v4w __attribute__((vector_size(4*sizeof(whitgl_float))));
+#endif
+
+#define WHITGL_MATH_API
+#include <whitgl/math_inline.h>
+
+// Safe for out to be a or b
+void _whitgl_fmat_multiply(const whitgl_fmat* a, const whitgl_fmat* b, whitgl_fmat* o)
+{
+#ifdef WHITGL_MATH_SIMD
+	// Each output column is a blend of a's columns, summed in the same order
+	// as the scalar version so results are identical
+	whitgl_math_v4f col[4];
+	memcpy(col, a->mat, sizeof(col));
+	whitgl_int j;
+	for(j=0; j<4; j++)
 	{
-		whitgl_int swap = bounds.a.x;
-		bounds.a.x = bounds.b.x;
-		bounds.b.x = swap;
+		const float* bj = &b->mat[j*4];
+		whitgl_math_v4f out = col[0]*bj[0] + col[1]*bj[1] + col[2]*bj[2] + col[3]*bj[3];
+		memcpy(&o->mat[j*4], &out, sizeof(out));
 	}
-	if(bounds.a.y > bounds.b.y)
-	{
-		whitgl_int swap = bounds.a.y;
-		bounds.a.y = bounds.b.y;
-		bounds.b.y = swap;
-	}
-	if(a.x < bounds.a.x)
-		a.x = bounds.a.x;
-	if(a.x > bounds.b.x)
-		a.x = bounds.b.x;
-	if(a.y < bounds.a.y)
-		a.y = bounds.a.y;
-	if(a.y > bounds.b.y)
-		a.y = bounds.b.y;
-	return a;
-}
-
-whitgl_float whitgl_fmin(whitgl_float a, whitgl_float b)
-{
-	if(a < b) return a;
-	return b;
-}
-whitgl_float whitgl_fmax(whitgl_float a, whitgl_float b)
-{
-	if(a > b) return a;
-	return b;
-}
-whitgl_float whitgl_fclamp(whitgl_float a, whitgl_float min, whitgl_float max)
-{
-	if(min > max) WHITGL_LOG("ERR min > than max!");
-	if(a < min) return min;
-	if(a > max) return max;
-	return a;
-}
-whitgl_float whitgl_fsqrt(whitgl_float a)
-{
-	return sqrt(a);
-}
-whitgl_float whitgl_fwrap(whitgl_float a, whitgl_float min, whitgl_float max)
-{
-	float size = max-min;
-	a = fmod(a-min, size)+min;
-	while(a < min)
-		a += size;
-	while(a >= max)
-		a -= size;
-	return a;
-}
-whitgl_float whitgl_fsin(whitgl_float a)
-{
-	return sin(a);
-}
-whitgl_float whitgl_fcos(whitgl_float a)
-{
-	return cos(a);
-}
-whitgl_float whitgl_ftan(whitgl_float a)
-{
-	return tan(a);
-}
-whitgl_float whitgl_fasin(whitgl_float a)
-{
-	return asin(a);
-}
-whitgl_float whitgl_facos(whitgl_float a)
-{
-	return acos(a);
-}
-whitgl_float whitgl_fatan(whitgl_float a)
-{
-	return atan(a);
-}
-whitgl_float whitgl_fpow(whitgl_float a, whitgl_float b)
-{
-	return pow(a,b);
-}
-whitgl_float whitgl_finterpolate(whitgl_float a, whitgl_float b, whitgl_float ratio)
-{
-	return a*(1-ratio) + b*ratio;
-}
-whitgl_float whitgl_fabs(whitgl_float a)
-{
-	return fabs(a);
-}
-whitgl_float whitgl_fmod(whitgl_float a, whitgl_float b)
-{
-	return fmod(a, b);
-}
-whitgl_float whitgl_fnearest(whitgl_float a, whitgl_float b)
-{
-	return floor(a/b+0.5)*b;
-}
-whitgl_float whitgl_fsmoothstep(float a, whitgl_float min, whitgl_float max)
-{
-	a = whitgl_fclamp((a - min)/(max - min), 0.0, 1.0);
-	return a*a*(3-2*a);
-}
-
-whitgl_ivec whitgl_ivec_val(whitgl_int a)
-{
-	whitgl_ivec out = {a, a};
-	return out;
-}
-whitgl_ivec whitgl_ivec_add(whitgl_ivec a, whitgl_ivec b)
-{
-	whitgl_ivec out = {a.x + b.x, a.y + b.y};
-	return out;
-}
-whitgl_ivec whitgl_ivec_sub(whitgl_ivec a, whitgl_ivec b)
-{
-	whitgl_ivec out = {a.x - b.x, a.y - b.y};
-	return out;
-}
-whitgl_ivec whitgl_ivec_inverse(whitgl_ivec a)
-{
-	whitgl_ivec out = {-a.x, -a.y};
-	return out;
-}
-whitgl_ivec whitgl_ivec_scale(whitgl_ivec a, whitgl_ivec s)
-{
-	whitgl_ivec out = {a.x * s.x, a.y * s.y};
-	return out;
-}
-whitgl_ivec whitgl_ivec_scale_val(whitgl_ivec a, whitgl_int s)
-{
-	whitgl_ivec out = {a.x * s, a.y * s};
-	return out;
-}
-whitgl_ivec whitgl_ivec_divide(whitgl_ivec a, whitgl_ivec s)
-{
-	whitgl_ivec out = {a.x / s.x, a.y / s.y};
-	return out;
-}
-whitgl_ivec whitgl_ivec_divide_val(whitgl_ivec a, whitgl_int s)
-{
-	whitgl_ivec out = {a.x / s, a.y / s};
-	return out;
-}
-whitgl_int whitgl_ivec_dot(whitgl_ivec a, whitgl_ivec b)
-{
-	return a.x*b.x + a.y*b.y;
-}
-whitgl_int whitgl_ivec_sqmagnitude(whitgl_ivec a)
-{
-	return a.x * a.x + a.y * a.y;
-}
-whitgl_bool whitgl_ivec_eq(whitgl_ivec a, whitgl_ivec b)
-{
-	return a.x == b.x && a.y == b.y;
-}
-
-whitgl_fvec whitgl_fvec_val(whitgl_float a)
-{
-	whitgl_fvec out = {a, a};
-	return out;
-}
-whitgl_fvec whitgl_fvec_add(whitgl_fvec a, whitgl_fvec b)
-{
-	whitgl_fvec out = {a.x + b.x, a.y + b.y};
-	return out;
-}
-whitgl_fvec whitgl_fvec_sub(whitgl_fvec a, whitgl_fvec b)
-{
-	whitgl_fvec out = {a.x - b.x, a.y - b.y};
-	return out;
-}
-whitgl_fvec whitgl_fvec_inverse(whitgl_fvec a)
-{
-	whitgl_fvec out = {-a.x, -a.y};
-	return out;
-}
-whitgl_fvec whitgl_fvec_scale(whitgl_fvec a, whitgl_fvec s)
-{
-	whitgl_fvec out = {a.x * s.x, a.y * s.y};
-	return out;
-}
-whitgl_fvec whitgl_fvec_scale_val(whitgl_fvec a, whitgl_float s)
-{
-	whitgl_fvec out = {a.x * s, a.y * s};
-	return out;
-}
-whitgl_fvec whitgl_fvec_divide(whitgl_fvec a, whitgl_fvec s)
-{
-	whitgl_fvec out = {a.x / s.x, a.y / s.y};
-	return out;
-}
-whitgl_fvec whitgl_fvec_divide_val(whitgl_fvec a, whitgl_float s)
-{
-	whitgl_fvec out = {a.x / s, a.y / s};
-	return out;
-}
-whitgl_float whitgl_fvec_sqmagnitude(whitgl_fvec a)
-{
-	return a.x * a.x + a.y * a.y;
-}
-whitgl_float whitgl_fvec_magnitude(whitgl_fvec a)
-{
-	return whitgl_fsqrt(whitgl_fvec_sqmagnitude(a));
-}
-whitgl_fvec whitgl_fvec_normalize(whitgl_fvec a)
-{
-	whitgl_float mag = sqrt(whitgl_fvec_sqmagnitude(a));
-	if(mag == 0)
-		return a;
-	whitgl_float mag_1 = 1/mag;
-	a.x = a.x*mag_1;
-	a.y = a.y*mag_1;
-	return a;
-}
-whitgl_float whitgl_fvec_dot(whitgl_fvec a, whitgl_fvec b)
-{
-	return a.x*b.x + a.y*b.y;
-}
-whitgl_fvec whitgl_fvec_bound(whitgl_fvec a, whitgl_faabb bounds)
-{
-	if(bounds.a.x > bounds.b.x)
-	{
-		whitgl_float swap = bounds.a.x;
-		bounds.a.x = bounds.b.x;
-		bounds.b.x = swap;
-	}
-	if(bounds.a.y > bounds.b.y)
-	{
-		whitgl_float swap = bounds.a.y;
-		bounds.a.y = bounds.b.y;
-		bounds.b.y = swap;
-	}
-	if(a.x < bounds.a.x)
-		a.x = bounds.a.x;
-	if(a.x > bounds.b.x)
-		a.x = bounds.b.x;
-	if(a.y < bounds.a.y)
-		a.y = bounds.a.y;
-	if(a.y > bounds.b.y)
-		a.y = bounds.b.y;
-	return a;
-}
-whitgl_fvec whitgl_fvec_interpolate(whitgl_fvec a, whitgl_fvec b, whitgl_float ratio)
-{
-	whitgl_fvec out = whitgl_fvec_zero;
-	out.x = a.x*(1-ratio) + b.x*ratio;
-	out.y = a.y*(1-ratio) + b.y*ratio;
-	return out;
-}
-whitgl_bool whitgl_fvec_eq(whitgl_fvec a, whitgl_fvec b)
-{
-	return a.x == b.x && a.y == b.y;
-}
-
-whitgl_fvec3 whitgl_fvec3_val(whitgl_float a)
-{
-	whitgl_fvec3 out = {a, a, a};
-	return out;
-}
-whitgl_fvec3 whitgl_fvec3_add(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	whitgl_fvec3 out = {a.x + b.x, a.y + b.y, a.z + b.z};
-	return out;
-}
-whitgl_fvec3 whitgl_fvec3_sub(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	whitgl_fvec3 out = {a.x - b.x, a.y - b.y, a.z - b.z};
-	return out;
-}
-whitgl_fvec3 whitgl_fvec3_inverse(whitgl_fvec3 a)
-{
-	whitgl_fvec3 out = {-a.x,-a.y,-a.z};
-	return out;
-}
-whitgl_fvec3 whitgl_fvec3_scale(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	whitgl_fvec3 out = {a.x * b.x, a.y * b.y, a.z * b.z};
-	return out;
-}
-whitgl_fvec3 whitgl_fvec3_scale_val(whitgl_fvec3 a, whitgl_float s)
-{
-	whitgl_fvec3 out = {a.x * s, a.y * s, a.z * s};
-	return out;
-}
-whitgl_float whitgl_fvec3_sqmagnitude(whitgl_fvec3 a)
-{
-	return a.x*a.x + a.y*a.y + a.z*a.z;
-}
-whitgl_float whitgl_fvec3_magnitude(whitgl_fvec3 a)
-{
-	return whitgl_fsqrt(whitgl_fvec3_sqmagnitude(a));
-}
-whitgl_fvec3 whitgl_fvec3_normalize(whitgl_fvec3 a)
-{
-	whitgl_float s = whitgl_fvec3_magnitude(a);
-	return whitgl_fvec3_scale_val(a, 1/s);
-}
-whitgl_fvec3 whitgl_fvec3_cross(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	whitgl_fvec3 o;
-	o.x = (a.y * b.z) - (a.z * b.y);
-	o.y = (a.z * b.x) - (a.x * b.z);
-	o.z = (a.x * b.y) - (a.y * b.x);
-	return o;
-}
-whitgl_float whitgl_fvec3_dot(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	return a.x*b.x + a.y*b.y + a.z*b.z;
-}
-whitgl_fvec3 whitgl_fvec3_interpolate(whitgl_fvec3 a, whitgl_fvec3 b, whitgl_float ratio)
-{
-	whitgl_fvec3 out = whitgl_fvec3_zero;
-	out.x = a.x*(1-ratio) + b.x*ratio;
-	out.y = a.y*(1-ratio) + b.y*ratio;
-	out.z = a.z*(1-ratio) + b.z*ratio;
-	return out;
-}
-whitgl_bool whitgl_fvec3_eq(whitgl_fvec3 a, whitgl_fvec3 b)
-{
-	return a.x == b.x && a.y == b.y && a.z == b.z;
-}
-
-whitgl_iaabb whitgl_iaabb_add(whitgl_iaabb a, whitgl_ivec b)
-{
-	whitgl_iaabb out;
-	out.a.x = a.a.x + b.x;
-	out.a.y = a.a.y + b.y;
-	out.b.x = a.b.x + b.x;
-	out.b.y = a.b.y + b.y;
-	return out;
-}
-whitgl_iaabb whitgl_iaabb_sub(whitgl_iaabb a, whitgl_ivec b)
-{
-	whitgl_iaabb out;
-	out.a.x = a.a.x - b.x;
-	out.a.y = a.a.y - b.y;
-	out.b.x = a.b.x - b.x;
-	out.b.y = a.b.y - b.y;
-	return out;
-}
-whitgl_iaabb whitgl_iaabb_scale(whitgl_iaabb a, whitgl_ivec s)
-{
-	whitgl_iaabb out;
-	out.a = whitgl_ivec_scale(a.a, s);
-	out.b = whitgl_ivec_scale(a.b, s);
-	return out;
-}
-whitgl_iaabb whitgl_iaabb_divide(whitgl_iaabb a, whitgl_ivec s)
-{
-	whitgl_iaabb out;
-	out.a = whitgl_ivec_divide(a.a, s);
-	out.b = whitgl_ivec_divide(a.b, s);
-	return out;
-}
-whitgl_iaabb whitgl_iaabb_intersection(whitgl_iaabb a, whitgl_iaabb b)
-{
-	whitgl_iaabb out;
-	out.a.x = whitgl_imax(whitgl_imin(a.a.x, a.b.x), whitgl_imin(b.a.x, b.b.x));
-	out.a.y = whitgl_imax(whitgl_imin(a.a.y, a.b.y), whitgl_imin(b.a.y, b.b.y));
-	out.b.x = whitgl_imin(whitgl_imax(a.a.x, a.b.x), whitgl_imax(b.a.x, b.b.x));
-	out.b.y = whitgl_imin(whitgl_imax(a.a.y, a.b.y), whitgl_imax(b.a.y, b.b.y));
-	if(out.a.x > out.b.x)
-		out.b.x = out.a.x;
-	if(out.a.y > out.b.y)
-		out.b.y = out.a.y;
-	return out;
-}
-bool whitgl_iaabb_intersects(whitgl_iaabb a, whitgl_iaabb b)
-{
-	if(a.a.x >= b.b.x) return false;
-	if(b.a.x >= a.b.x) return false;
-	if(a.a.y >= b.b.y) return false;
-	if(b.a.y >= a.b.y) return false;
-	return true;
-}
-whitgl_iaabb whitgl_iaabb_incorporate(whitgl_iaabb a, whitgl_iaabb b)
-{
-	whitgl_iaabb out;
-	out.a.x = whitgl_imin(whitgl_imin(a.a.x, a.b.x), whitgl_imin(b.a.x, b.b.x));
-	out.a.y = whitgl_imin(whitgl_imin(a.a.y, a.b.y), whitgl_imin(b.a.y, b.b.y));
-	out.b.x = whitgl_imax(whitgl_imax(a.a.x, a.b.x), whitgl_imax(b.a.x, b.b.x));
-	out.b.y = whitgl_imax(whitgl_imax(a.a.y, a.b.y), whitgl_imax(b.a.y, b.b.y));
-	return out;
-}
-whitgl_int whitgl_iaabb_area(whitgl_iaabb r)
-{
-	return (r.b.x-r.a.x)*(r.b.y-r.a.y);
+#else
+	whitgl_fmat a_copy = *a;
+	whitgl_fmat b_copy = *b;
+	a = &a_copy;
+	b = &b_copy;
+	o->mat[0] = a->mat[0] * b->mat[0] + a->mat[4] * b->mat[1] + a->mat[8] * b->mat[2] + a->mat[12] * b->mat[3];
+	o->mat[1] = a->mat[1] * b->mat[0] + a->mat[5] * b->mat[1] + a->mat[9] * b->mat[2] + a->mat[13] * b->mat[3];
+	o->mat[2] = a->mat[2] * b->mat[0] + a->mat[6] * b->mat[1] + a->mat[10] * b->mat[2] + a->mat[14] * b->mat[3];
+	o->mat[3] = a->mat[3] * b->mat[0] + a->mat[7] * b->mat[1] + a->mat[11] * b->mat[2] + a->mat[15] * b->mat[3];
+
+	o->mat[4] = a->mat[0] * b->mat[4] + a->mat[4] * b->mat[5] + a->mat[8] * b->mat[6] + a->mat[12] * b->mat[7];
+	o->mat[5] = a->mat[1] * b->mat[4] + a->mat[5] * b->mat[5] + a->mat[9] * b->mat[6] + a->mat[13] * b->mat[7];
+	o->mat[6] = a->mat[2] * b->mat[4] + a->mat[6] * b->mat[5] + a->mat[10] * b->mat[6] + a->mat[14] * b->mat[7];
+	o->mat[7] = a->mat[3] * b->mat[4] + a->mat[7] * b->mat[5] + a->mat[11] * b->mat[6] + a->mat[15] * b->mat[7];
+
+	o->mat[8] = a->mat[0] * b->mat[8] + a->mat[4] * b->mat[9] + a->mat[8] * b->mat[10] + a->mat[12] * b->mat[11];
+	o->mat[9] = a->mat[1] * b->mat[8] + a->mat[5] * b->mat[9] + a->mat[9] * b->mat[10] + a->mat[13] * b->mat[11];
+	o->mat[10] = a->mat[2] * b->mat[8] + a->mat[6] * b->mat[9] + a->mat[10] * b->mat[10] + a->mat[14] * b->mat[11];
+	o->mat[11] = a->mat[3] * b->mat[8] + a->mat[7] * b->mat[9] + a->mat[11] * b->mat[10] + a->mat[15] * b->mat[11];
+
+	o->mat[12] = a->mat[0] * b->mat[12] + a->mat[4] * b->mat[13] + a->mat[8] * b->mat[14] + a->mat[12] * b->mat[15];
+	o->mat[13] = a->mat[1] * b->mat[12] + a->mat[5] * b->mat[13] + a->mat[9] * b->mat[14] + a->mat[13] * b->mat[15];
+	o->mat[14] = a->mat[2] * b->mat[12] + a->mat[6] * b->mat[13] + a->mat[10] * b->mat[14] + a->mat[14] * b->mat[15];
+	o->mat[15] = a->mat[3] * b->mat[12] + a->mat[7] * b->mat[13] + a->mat[11] * b->mat[14] + a->mat[15] * b->mat[15];
+#endif
 }
-
-whitgl_faabb whitgl_faabb_add(whitgl_faabb a, whitgl_fvec b)
-{
-	whitgl_faabb out;
-	out.a.x = a.a.x + b.x;
-	out.a.y = a.a.y + b.y;
-	out.b.x = a.b.x + b.x;
-	out.b.y = a.b.y + b.y;
-	return out;
-}
-whitgl_faabb whitgl_faabb_sub(whitgl_faabb a, whitgl_fvec b)
-{
-	whitgl_faabb out;
-	out.a.x = a.a.x - b.x;
-	out.a.y = a.a.y - b.y;
-	out.b.x = a.b.x - b.x;
-	out.b.y = a.b.y - b.y;
-	return out;
-}
-whitgl_faabb whitgl_faabb_scale(whitgl_faabb a, whitgl_fvec s)
-{
-	whitgl_faabb out;
-	out.a = whitgl_fvec_scale(a.a, s);
-	out.b = whitgl_fvec_scale(a.b, s);
-	return out;
-}
-whitgl_faabb whitgl_faabb_divide(whitgl_faabb a, whitgl_fvec s)
-{
-	whitgl_faabb out;
-	out.a = whitgl_fvec_divide(a.a, s);
-	out.b = whitgl_fvec_divide(a.b, s);
-	return out;
-}
-whitgl_faabb whitgl_faabb_intersection(whitgl_faabb a, whitgl_faabb b)
-{
-	whitgl_faabb out;
-	out.a.x = whitgl_fmax(whitgl_fmin(a.a.x, a.b.x), whitgl_fmin(b.a.x, b.b.x));
-	out.a.y = whitgl_fmax(whitgl_fmin(a.a.y, a.b.y), whitgl_fmin(b.a.y, b.b.y));
-	out.b.x = whitgl_fmin(whitgl_fmax(a.a.x, a.b.x), whitgl_fmax(b.a.x, b.b.x));
-	out.b.y = whitgl_fmin(whitgl_fmax(a.a.y, a.b.y), whitgl_fmax(b.a.y, b.b.y));
-	if(out.a.x > out.b.x)
-		out.b.x = out.a.x;
-	if(out.a.y > out.b.y)
-		out.b.y = out.a.y;
-	return out;
-}
-whitgl_bool whitgl_faabb_intersects(whitgl_faabb a, whitgl_faabb b)
-{
-	if(a.a.x >= b.b.x) return false;
-	if(b.a.x >= a.b.x) return false;
-	if(a.a.y >= b.b.y) return false;
-	if(b.a.y >= a.b.y) return false;
-	return true;
-}
-whitgl_faabb whitgl_faabb_incorporate(whitgl_faabb a, whitgl_faabb b)
-{
-	whitgl_faabb out;
-	out.a.x = whitgl_fmin(whitgl_fmin(a.a.x, a.b.x), whitgl_fmin(b.a.x, b.b.x));
-	out.a.y = whitgl_fmin(whitgl_fmin(a.a.y, a.b.y), whitgl_fmin(b.a.y, b.b.y));
-	out.b.x = whitgl_fmax(whitgl_fmax(a.a.x, a.b.x), whitgl_fmax(b.a.x, b.b.x));
-	out.b.y = whitgl_fmax(whitgl_fmax(a.a.y, a.b.y), whitgl_fmax(b.a.y, b.b.y));
-	return out;
-}
-whitgl_float whitgl_faabb_area(whitgl_faabb r)
-{
-	return (r.b.x-r.a.x)*(r.b.y-r.a.y);
-}
-
 whitgl_fmat whitgl_fmat_multiply(whitgl_fmat a, whitgl_fmat b)
 {
 	whitgl_fmat o;
-
-	o.mat[0] = a.mat[0] * b.mat[0] + a.mat[4] * b.mat[1] + a.mat[8] * b.mat[2] + a.mat[12] * b.mat[3];
-	o.mat[1] = a.mat[1] * b.mat[0] + a.mat[5] * b.mat[1] + a.mat[9] * b.mat[2] + a.mat[13] * b.mat[3];
-	o.mat[2] = a.mat[2] * b.mat[0] + a.mat[6] * b.mat[1] + a.mat[10] * b.mat[2] + a.mat[14] * b.mat[3];
-	o.mat[3] = a.mat[3] * b.mat[0] + a.mat[7] * b.mat[1] + a.mat[11] * b.mat[2] + a.mat[15] * b.mat[3];
-
-	o.mat[4] = a.mat[0] * b.mat[4] + a.mat[4] * b.mat[5] + a.mat[8] * b.mat[6] + a.mat[12] * b.mat[7];
-	o.mat[5] = a.mat[1] * b.mat[4] + a.mat[5] * b.mat[5] + a.mat[9] * b.mat[6] + a.mat[13] * b.mat[7];
-	o.mat[6] = a.mat[2] * b.mat[4] + a.mat[6] * b.mat[5] + a.mat[10] * b.mat[6] + a.mat[14] * b.mat[7];
-	o.mat[7] = a.mat[3] * b.mat[4] + a.mat[7] * b.mat[5] + a.mat[11] * b.mat[6] + a.mat[15] * b.mat[7];
-
-	o.mat[8] = a.mat[0] * b.mat[8] + a.mat[4] * b.mat[9] + a.mat[8] * b.mat[10] + a.mat[12] * b.mat[11];
-	o.mat[9] = a.mat[1] * b.mat[8] + a.mat[5] * b.mat[9] + a.mat[9] * b.mat[10] + a.mat[13] * b.mat[11];
-	o.mat[10] = a.mat[2] * b.mat[8] + a.mat[6] * b.mat[9] + a.mat[10] * b.mat[10] + a.mat[14] * b.mat[11];
-	o.mat[11] = a.mat[3] * b.mat[8] + a.mat[7] * b.mat[9] + a.mat[11] * b.mat[10] + a.mat[15] * b.mat[11];
-
-	o.mat[12] = a.mat[0] * b.mat[12] + a.mat[4] * b.mat[13] + a.mat[8] * b.mat[14] + a.mat[12] * b.mat[15];
-	o.mat[13] = a.mat[1] * b.mat[12] + a.mat[5] * b.mat[13] + a.mat[9] * b.mat[14] + a.mat[13] * b.mat[15];
-	o.mat[14] = a.mat[2] * b.mat[12] + a.mat[6] * b.mat[13] + a.mat[10] * b.mat[14] + a.mat[14] * b.mat[15];
-	o.mat[15] = a.mat[3] * b.mat[12] + a.mat[7] * b.mat[13] + a.mat[11] * b.mat[14] + a.mat[15] * b.mat[15];
-
+	_whitgl_fmat_multiply(&a, &b, &o);
 	return o;
 }
 whitgl_fmat whitgl_fmat_invert(whitgl_fmat m)
 {
+#ifdef WHITGL_MATH_SIMD
+	// Cofactors from 2x2 determinants of the top and bottom pairs of rows,
+	// read row-major since the inverse of the transpose is the transpose of
+	// the inverse. Within float rounding of the scalar version.
+	const float* a = m.mat;
+	float s0 = a[0]*a[5] - a[4]*a[1];
+	float s1 = a[0]*a[6] - a[4]*a[2];
+	float s2 = a[0]*a[7] - a[4]*a[3];
+	float s3 = a[1]*a[6] - a[5]*a[2];
+	float s4 = a[1]*a[7] - a[5]*a[3];
+	float s5 = a[2]*a[7] - a[6]*a[3];
+	float c5 = a[10]*a[15] - a[14]*a[11];
+	float c4 = a[9]*a[15] - a[13]*a[11];
+	float c3 = a[9]*a[14] - a[13]*a[10];
+	float c2 = a[8]*a[15] - a[12]*a[11];
+	float c1 = a[8]*a[14] - a[12]*a[10];
+	float c0 = a[8]*a[13] - a[12]*a[9];
+
+	whitgl_float det = (whitgl_float)s0*c5 - (whitgl_float)s1*c4 + (whitgl_float)s2*c3 + (whitgl_float)s3*c2 - (whitgl_float)s4*c1 + (whitgl_float)s5*c0;
+	if (det == 0)
+		WHITGL_PANIC("det is 0");
+	float inv_det = 1.0/det;
+
+	whitgl_math_v4f rows[4];
+	rows[0] = (whitgl_math_v4f){a[5], -a[1], a[13], -a[9]}*(whitgl_math_v4f){c5, c5, s5, s5}
+	        + (whitgl_math_v4f){-a[6], a[2], -a[14], a[10]}*(whitgl_math_v4f){c4, c4, s4, s4}
+	        + (whitgl_math_v4f){a[7], -a[3], a[15], -a[11]}*(whitgl_math_v4f){c3, c3, s3, s3};
+	rows[1] = (whitgl_math_v4f){-a[4], a[0], -a[12], a[8]}*(whitgl_math_v4f){c5, c5, s5, s5}
+	        + (whitgl_math_v4f){a[6], -a[2], a[14], -a[10]}*(whitgl_math_v4f){c2, c2, s2, s2}
+	        + (whitgl_math_v4f){-a[7], a[3], -a[15], a[11]}*(whitgl_math_v4f){c1, c1, s1, s1};
+	rows[2] = (whitgl_math_v4f){a[4], -a[0], a[12], -a[8]}*(whitgl_math_v4f){c4, c4, s4, s4}
+	        + (whitgl_math_v4f){-a[5], a[1], -a[13], a[9]}*(whitgl_math_v4f){c2, c2, s2, s2}
+	        + (whitgl_math_v4f){a[7], -a[3], a[15], -a[11]}*(whitgl_math_v4f){c0, c0, s0, s0};
+	rows[3] = (whitgl_math_v4f){-a[4], a[0], -a[12], a[8]}*(whitgl_math_v4f){c3, c3, s3, s3}
+	        + (whitgl_math_v4f){a[5], -a[1], a[13], -a[9]}*(whitgl_math_v4f){c1, c1, s1, s1}
+	        + (whitgl_math_v4f){-a[6], a[2], -a[14], a[10]}*(whitgl_math_v4f){c0, c0, s0, s0};
+	whitgl_fmat out;
+	whitgl_int i;
+	for(i=0; i<4; i++)
+	{
+		rows[i] *= inv_det;
+		memcpy(&out.mat[i*4], &rows[i], sizeof(rows[i]));
+	}
+	return out;
+#else
 	whitgl_fmat out;
 
 	out.mat[0] = m.mat[5]  * m.mat[10] * m.mat[15] -
@@ -647,6 +238,7 @@ whitgl_fmat whitgl_fmat_invert(whitgl_fmat m)
 	for (i = 0; i < 16; i++)
 		out.mat[i] = out.mat[i] * det;
 	return out;
+#endif
 }
 whitgl_fmat whitgl_fmat_orthographic(float left, float right, float top, float bottom, whitgl_float near, whitgl_float far)
 {
@@ -781,12 +373,80 @@ whitgl_fvec whitgl_fvec_apply_fmat(whitgl_fvec v, whitgl_fmat m)
 }
 whitgl_fvec3 whitgl_fvec3_apply_fmat(whitgl_fvec3 v, whitgl_fmat m)
 {
-	whitgl_fvec3 out = whitgl_fvec3_zero;
+	whitgl_fvec3 out;
 	out.x = m.mat[0]*v.x + m.mat[4]*v.y + m.mat[8]*v.z + m.mat[12];
 	out.y = m.mat[1]*v.x + m.mat[5]*v.y + m.mat[9]*v.z + m.mat[13];
 	out.z = m.mat[2]*v.x + m.mat[6]*v.y + m.mat[10]*v.z + m.mat[14];
 	return out;
 }
+void whitgl_fvec3_apply_fmat_array(const whitgl_fvec3* in, whitgl_fvec3* out, whitgl_int count, const whitgl_fmat* m)
+{
+	whitgl_int i;
+#ifdef WHITGL_MATH_SIMD
+	// Columns widened to whitgl_float up front, the same sums as the scalar version
+	whitgl_math_v4w col[4];
+	for(i=0; i<4; i++)
+	{
+		whitgl_math_v4w c = {m->mat[i*4], m->mat[i*4+1], m->mat[i*4+2], 0};
+		col[i] = c;
+	}
+	for(i=0; i<count; i++)
+	{
+		whitgl_fvec3 v = in[i];
+		whitgl_math_v4w o = col[0]*v.x + col[1]*v.y + col[2]*v.z + col[3];
+		out[i].x = o[0];
+		out[i].y = o[1];
+		out[i].z = o[2];
+	}
+#else
+	for(i=0; i<count; i++)
+	{
+		whitgl_fvec3 v = in[i];
+		out[i].x = m->mat[0]*v.x + m->mat[4]*v.y + m->mat[8]*v.z + m->mat[12];
+		out[i].y = m->mat[1]*v.x + m->mat[5]*v.y + m->mat[9]*v.z + m->mat[13];
+		out[i].z = m->mat[2]*v.x + m->mat[6]*v.y + m->mat[10]*v.z + m->mat[14];
+	}
+#endif
+}
+void whitgl_fmat_multiply_array(const whitgl_fmat* a, const whitgl_fmat* b, whitgl_fmat* out, whitgl_int count)
+{
+	whitgl_int i;
+	for(i=0; i<count; i++)
+		_whitgl_fmat_multiply(&a[i], &b[i], &out[i]);
+}
+void whitgl_fmat_premultiply_array(whitgl_fmat a, const whitgl_fmat* b, whitgl_fmat* out, whitgl_int count)
+{
+	whitgl_int i;
+	for(i=0; i<count; i++)
+		_whitgl_fmat_multiply(&a, &b[i], &out[i]);
+}
+void whitgl_fmat_model_array(const whitgl_fvec3* pos, const whitgl_quat* rot, const whitgl_fvec3* scale, whitgl_fmat* out, whitgl_int count)
+{
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		// translate*rotate*scale without the multiplies, since the columns
+		// of the rotation just get scaled and the translation is the last
+		whitgl_fmat m = rot ? whitgl_quat_to_fmat(rot[i]) : whitgl_fmat_identity;
+		if(scale)
+		{
+			whitgl_int j;
+			for(j=0; j<4; j++)
+			{
+				m.mat[j] *= scale[i].x;
+				m.mat[4+j] *= scale[i].y;
+				m.mat[8+j] *= scale[i].z;
+			}
+		}
+		if(pos)
+		{
+			m.mat[12] = pos[i].x;
+			m.mat[13] = pos[i].y;
+			m.mat[14] = pos[i].z;
+		}
+		out[i] = m;
+	}
+}
 whitgl_quat whitgl_quat_multiply(whitgl_quat q1, whitgl_quat q2)
 {
 	whitgl_quat out;
@@ -995,6 +655,48 @@ bool whitgl_ray_circle_intersect(whitgl_fcircle circ, whitgl_fvec start, whitgl_
 	return false;
 }
 
+// Slab test, t1 and t2 are where the ray enters and leaves the box
+bool whitgl_ray_faabb_intersect(whitgl_faabb box, whitgl_fvec start, whitgl_fvec speed, whitgl_float* t1, whitgl_float* t2)
+{
+	whitgl_float enter = -whitgl_float_max;
+	whitgl_float leave = whitgl_float_max;
+	whitgl_float lo = whitgl_fmin(box.a.x, box.b.x);
+	whitgl_float hi = whitgl_fmax(box.a.x, box.b.x);
+	if(speed.x == 0)
+	{
+		if(start.x <= lo || start.x >= hi)
+			return false;
+	}
+	else
+	{
+		whitgl_float inv = 1/speed.x;
+		whitgl_float ta = (lo-start.x)*inv;
+		whitgl_float tb = (hi-start.x)*inv;
+		enter = whitgl_fmax(enter, whitgl_fmin(ta, tb));
+		leave = whitgl_fmin(leave, whitgl_fmax(ta, tb));
+	}
+	lo = whitgl_fmin(box.a.y, box.b.y);
+	hi = whitgl_fmax(box.a.y, box.b.y);
+	if(speed.y == 0)
+	{
+		if(start.y <= lo || start.y >= hi)
+			return false;
+	}
+	else
+	{
+		whitgl_float inv = 1/speed.y;
+		whitgl_float ta = (lo-start.y)*inv;
+		whitgl_float tb = (hi-start.y)*inv;
+		enter = whitgl_fmax(enter, whitgl_fmin(ta, tb));
+		leave = whitgl_fmin(leave, whitgl_fmax(ta, tb));
+	}
+	if(enter >= leave)
+		return false;
+	*t1 = enter;
+	*t2 = leave;
+	return true;
+}
+
 whitgl_ivec whitgl_camera(whitgl_ivec pos, whitgl_ivec world_size, whitgl_ivec screen_size)
 {
 	whitgl_ivec out = whitgl_ivec_inverse(pos);
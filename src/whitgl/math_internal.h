@@ -0,0 +1,18 @@
+#ifndef WHITGL_MATH_INTERNAL_H_
+#define WHITGL_MATH_INTERNAL_H_
+
+#include <whitgl/math.h>
+
+// Boxes may come in flipped, the spatial structures store them with a as the
+// min corner
+static inline whitgl_faabb _whitgl_faabb_normalize(whitgl_faabb box)
+{
+	whitgl_faabb out;
+	out.a.x = whitgl_fmin(box.a.x, box.b.x);
+	out.a.y = whitgl_fmin(box.a.y, box.b.y);
+	out.b.x = whitgl_fmax(box.a.x, box.b.x);
+	out.b.y = whitgl_fmax(box.a.y, box.b.y);
+	return out;
+}
+
+#endif // WHITGL_MATH_INTERNAL_H_
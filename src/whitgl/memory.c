@@ -0,0 +1,182 @@
+#include <whitgl/logging.h>
+#include <whitgl/memory.h>
+
+#include <stdio.h>
+
+typedef struct
+{
+	whitgl_memory_subsystem subsystem;
+	whitgl_int id;
+	int64_t bytes;
+} whitgl_memory_resource;
+
+#define WHITGL_MEMORY_MAX_RESOURCES (1024)
+whitgl_memory_resource _memory_resources[WHITGL_MEMORY_MAX_RESOURCES];
+whitgl_int _memory_num_resources = 0;
+whitgl_bool _memory_overflowed = false;
+
+whitgl_memory_usage _memory_usage[WHITGL_MEMORY_NUM_SUBSYSTEMS];
+whitgl_memory_usage _memory_total = {0, 0, 0, 0};
+whitgl_bool _memory_over_budget[WHITGL_MEMORY_NUM_SUBSYSTEMS+1];
+
+whitgl_int _memory_log_interval = 0;
+whitgl_int _memory_frames_since_log = 0;
+
+const char* _memory_subsystem_names[WHITGL_MEMORY_NUM_SUBSYSTEMS] =
+{
+	"textures",
+	"models",
+	"framebuffers",
+	"static batches",
+	"tilemaps",
+	"sounds",
+	"loops",
+	"decode",
+};
+
+whitgl_float _whitgl_memory_mb(int64_t bytes)
+{
+	return bytes/(1024.0*1024.0);
+}
+
+// Warns once on going over, and again only after dropping back under
+void _whitgl_memory_check_budget(whitgl_memory_usage usage, whitgl_int flag, const char* name)
+{
+	whitgl_bool over = usage.budget > 0 && usage.bytes > usage.budget;
+	if(over && !_memory_over_budget[flag])
+		WHITGL_LOG("WARNING %s over memory budget: %.1fMB of %.1fMB", name, _whitgl_memory_mb(usage.bytes), _whitgl_memory_mb(usage.budget));
+	_memory_over_budget[flag] = over;
+}
+
+whitgl_int _whitgl_memory_find(whitgl_memory_subsystem subsystem, whitgl_int id)
+{
+	whitgl_int i;
+	for(i=0; i<_memory_num_resources; i++)
+		if(_memory_resources[i].subsystem == subsystem && _memory_resources[i].id == id)
+			return i;
+	return -1;
+}
+
+void whitgl_memory_set(whitgl_memory_subsystem subsystem, whitgl_int id, int64_t bytes)
+{
+	if(subsystem >= WHITGL_MEMORY_NUM_SUBSYSTEMS)
+		WHITGL_PANIC("invalid memory subsystem %d", (int)subsystem);
+	whitgl_int index = _whitgl_memory_find(subsystem, id);
+	int64_t old_bytes = index == -1 ? 0 : _memory_resources[index].bytes;
+	if(bytes <= 0)
+	{
+		if(index == -1)
+			return;
+		_memory_resources[index] = _memory_resources[--_memory_num_resources];
+		_memory_usage[subsystem].resources--;
+		_memory_total.resources--;
+		bytes = 0;
+	} else if(index == -1)
+	{
+		if(_memory_num_resources >= WHITGL_MEMORY_MAX_RESOURCES)
+		{
+			if(!_memory_overflowed)
+				WHITGL_LOG("Too many resources for memory accounting, ignoring the rest");
+			_memory_overflowed = true;
+			return;
+		}
+		index = _memory_num_resources++;
+		_memory_resources[index].subsystem = subsystem;
+		_memory_resources[index].id = id;
+		_memory_resources[index].bytes = bytes;
+		_memory_usage[subsystem].resources++;
+		_memory_total.resources++;
+	} else
+	{
+		_memory_resources[index].bytes = bytes;
+	}
+
+	whitgl_memory_usage* usage = &_memory_usage[subsystem];
+	usage->bytes += bytes-old_bytes;
+	if(usage->bytes > usage->peak)
+		usage->peak = usage->bytes;
+	_memory_total.bytes += bytes-old_bytes;
+	if(_memory_total.bytes > _memory_total.peak)
+		_memory_total.peak = _memory_total.bytes;
+	_whitgl_memory_check_budget(*usage, subsystem, _memory_subsystem_names[subsystem]);
+	_whitgl_memory_check_budget(_memory_total, WHITGL_MEMORY_NUM_SUBSYSTEMS, "total");
+}
+
+void whitgl_memory_release(whitgl_memory_subsystem subsystem, whitgl_int id)
+{
+	whitgl_memory_set(subsystem, id, 0);
+}
+
+int64_t whitgl_memory_get(whitgl_memory_subsystem subsystem, whitgl_int id)
+{
+	whitgl_int index = _whitgl_memory_find(subsystem, id);
+	return index == -1 ? 0 : _memory_resources[index].bytes;
+}
+
+whitgl_memory_usage whitgl_memory_get_usage(whitgl_memory_subsystem subsystem)
+{
+	if(subsystem >= WHITGL_MEMORY_NUM_SUBSYSTEMS)
+		return whitgl_memory_usage_zero;
+	return _memory_usage[subsystem];
+}
+
+whitgl_memory_usage whitgl_memory_get_total()
+{
+	return _memory_total;
+}
+
+const char* whitgl_memory_subsystem_name(whitgl_memory_subsystem subsystem)
+{
+	if(subsystem >= WHITGL_MEMORY_NUM_SUBSYSTEMS)
+		return "unknown";
+	return _memory_subsystem_names[subsystem];
+}
+
+void whitgl_memory_set_budget(whitgl_memory_subsystem subsystem, int64_t bytes)
+{
+	if(subsystem >= WHITGL_MEMORY_NUM_SUBSYSTEMS)
+		WHITGL_PANIC("invalid memory subsystem %d", (int)subsystem);
+	_memory_usage[subsystem].budget = bytes;
+	_whitgl_memory_check_budget(_memory_usage[subsystem], subsystem, _memory_subsystem_names[subsystem]);
+}
+
+void whitgl_memory_set_total_budget(int64_t bytes)
+{
+	_memory_total.budget = bytes;
+	_whitgl_memory_check_budget(_memory_total, WHITGL_MEMORY_NUM_SUBSYSTEMS, "total");
+}
+
+void whitgl_memory_set_log_interval(whitgl_int frames)
+{
+	_memory_log_interval = frames;
+	_memory_frames_since_log = 0;
+}
+
+void whitgl_memory_frame()
+{
+	if(_memory_log_interval <= 0)
+		return;
+	_memory_frames_since_log++;
+	if(_memory_frames_since_log < _memory_log_interval)
+		return;
+	_memory_frames_since_log = 0;
+	whitgl_memory_log();
+}
+
+void whitgl_memory_log()
+{
+	char line[512];
+	whitgl_int length = 0;
+	whitgl_int i;
+	for(i=0; i<WHITGL_MEMORY_NUM_SUBSYSTEMS; i++)
+	{
+		if(_memory_usage[i].peak == 0)
+			continue;
+		length += snprintf(&line[length], sizeof(line)-length, " %s %.1f/%.1f", _memory_subsystem_names[i], _whitgl_memory_mb(_memory_usage[i].bytes), _whitgl_memory_mb(_memory_usage[i].peak));
+		if(length >= (whitgl_int)sizeof(line))
+			break;
+	}
+	if(length == 0)
+		line[0] = '\0';
+	WHITGL_LOG("Memory MB (now/peak): total %.1f/%.1f%s", _whitgl_memory_mb(_memory_total.bytes), _whitgl_memory_mb(_memory_total.peak), line);
+}
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <string.h>
+
+#include <whitgl/logging.h>
+#include <whitgl/narrowphase.h>
+
+#include "simd_internal.h"
+
+// Kernels work a lane at a time, see simd_internal.h
+#define WHITGL_NARROWPHASE_LANE(soa, i) (((const whitgl_simd_lane*)(soa))[(i)/WHITGL_SIMD_WIDTH])
+
+// kept local, a whitgl_imin call per lane costs more than the lane
+static inline whitgl_int _whitgl_narrowphase_remaining(whitgl_int count, whitgl_int i)
+{
+	return count-i < WHITGL_SIMD_WIDTH ? count-i : WHITGL_SIMD_WIDTH;
+}
+
+// The caller's float arrays may end part way through a lane. Whole lanes take
+// the fixed size copies, which compile to single unaligned moves.
+static inline whitgl_simd_lane _whitgl_narrowphase_load(const float* in, whitgl_int n)
+{
+	whitgl_simd_lane out = {0};
+	if(n == WHITGL_SIMD_WIDTH)
+		memcpy(&out, in, sizeof(out));
+	else
+		memcpy(&out, in, n*sizeof(float));
+	return out;
+}
+static inline whitgl_int _whitgl_narrowphase_store(float* out, whitgl_simd_lane t, whitgl_simd_mask hit, whitgl_int n)
+{
+	whitgl_simd_lane zero = {0};
+	t = _whitgl_simd_select(hit, t, zero+WHITGL_NARROWPHASE_MISS);
+	if(n == WHITGL_SIMD_WIDTH)
+	{
+		memcpy(out, &t, sizeof(t));
+		return _whitgl_simd_count(hit, WHITGL_SIMD_WIDTH);
+	}
+	memcpy(out, &t, n*sizeof(float));
+	return _whitgl_simd_count(hit, n);
+}
+
+// Entry time of start+speed*t into a circle of radius size centred on the
+// origin. This solves the same quadratic as whitgl_ray_circle_intersect, but
+// from the point of closest approach, which keeps float precision on long
+// paths. Without speed it is a point test at t=0.
+static inline whitgl_simd_mask _whitgl_narrowphase_circle(whitgl_simd_lane sx, whitgl_simd_lane sy, whitgl_simd_lane vx, whitgl_simd_lane vy, whitgl_simd_lane size, whitgl_simd_lane* t)
+{
+	whitgl_simd_lane zero = {0};
+	whitgl_simd_lane a = vx*vx + vy*vy;
+	whitgl_simd_mask still = a == zero;
+	whitgl_simd_lane a_1 = 1/_whitgl_simd_select(still, zero+1, a);
+	whitgl_simd_lane closest = -(vx*sx + vy*sy)*a_1;
+	whitgl_simd_lane cx = sx + vx*closest;
+	whitgl_simd_lane cy = sy + vy*closest;
+	whitgl_simd_lane sq_half = (size*size - (cx*cx + cy*cy))*a_1;
+	whitgl_simd_lane half = _whitgl_simd_sqrt(_whitgl_simd_max(sq_half, zero));
+	whitgl_simd_lane t1 = closest - half;
+	whitgl_simd_lane t2 = closest + half;
+	whitgl_simd_mask moving = _whitgl_simd_not(still);
+	whitgl_simd_mask inside = sx*sx + sy*sy < size*size;
+	whitgl_simd_mask hit = (moving & (sq_half > zero) & (t2 >= zero) & (t1 <= zero+1)) | (still & inside);
+	*t = _whitgl_simd_select(still, zero, _whitgl_simd_max(t1, zero));
+	return hit;
+}
+
+// Slab test against a sorted box, as in whitgl_ray_faabb_intersect but
+// clipped to t in [0,1]
+static inline whitgl_simd_mask _whitgl_narrowphase_slab(whitgl_simd_lane sx, whitgl_simd_lane sy, whitgl_simd_lane vx, whitgl_simd_lane vy, whitgl_simd_lane min_x, whitgl_simd_lane min_y, whitgl_simd_lane max_x, whitgl_simd_lane max_y, whitgl_simd_lane* t)
+{
+	whitgl_simd_lane zero = {0};
+	whitgl_simd_lane big = zero+FLT_MAX;
+	whitgl_simd_mask still_x = vx == zero;
+	whitgl_simd_mask still_y = vy == zero;
+	whitgl_simd_lane inv_x = 1/_whitgl_simd_select(still_x, zero+1, vx);
+	whitgl_simd_lane inv_y = 1/_whitgl_simd_select(still_y, zero+1, vy);
+	whitgl_simd_lane ax = (min_x-sx)*inv_x;
+	whitgl_simd_lane bx = (max_x-sx)*inv_x;
+	whitgl_simd_lane ay = (min_y-sy)*inv_y;
+	whitgl_simd_lane by = (max_y-sy)*inv_y;
+	// an axis without movement either always overlaps or never does
+	whitgl_simd_mask inside_x = (sx > min_x) & (sx < max_x);
+	whitgl_simd_mask inside_y = (sy > min_y) & (sy < max_y);
+	whitgl_simd_lane enter_x = _whitgl_simd_select(still_x, -big, _whitgl_simd_min(ax, bx));
+	whitgl_simd_lane leave_x = _whitgl_simd_select(still_x, _whitgl_simd_select(inside_x, big, -big), _whitgl_simd_max(ax, bx));
+	whitgl_simd_lane enter_y = _whitgl_simd_select(still_y, -big, _whitgl_simd_min(ay, by));
+	whitgl_simd_lane leave_y = _whitgl_simd_select(still_y, _whitgl_simd_select(inside_y, big, -big), _whitgl_simd_max(ay, by));
+	whitgl_simd_lane enter = _whitgl_simd_max(enter_x, enter_y);
+	whitgl_simd_lane leave = _whitgl_simd_min(leave_x, leave_y);
+	*t = _whitgl_simd_max(enter, zero);
+	return (enter < leave) & (leave >= zero) & (enter <= zero+1);
+}
+
+void _whitgl_narrowphase_check(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b)
+{
+	if(a->count != b->count)
+		WHITGL_PANIC("narrowphase sizes differ %d %d", (int)a->count, (int)b->count);
+}
+
+whitgl_int whitgl_narrowphase_ray_circles(whitgl_fvec start, whitgl_fvec speed, const whitgl_fvec_soa* pos, const float* size, float* t)
+{
+	whitgl_simd_lane zero = {0};
+	whitgl_simd_lane sx = zero+(float)start.x;
+	whitgl_simd_lane sy = zero+(float)start.y;
+	whitgl_simd_lane vx = zero+(float)speed.x;
+	whitgl_simd_lane vy = zero+(float)speed.y;
+	whitgl_int hits = 0;
+	whitgl_int i;
+	for(i=0; i<pos->count; i+=WHITGL_SIMD_WIDTH)
+	{
+		whitgl_int n = _whitgl_narrowphase_remaining(pos->count, i);
+		whitgl_simd_lane r = _whitgl_narrowphase_load(&size[i], n);
+		whitgl_simd_lane lane_t;
+		whitgl_simd_mask hit = _whitgl_narrowphase_circle(sx-WHITGL_NARROWPHASE_LANE(pos->x, i), sy-WHITGL_NARROWPHASE_LANE(pos->y, i), vx, vy, r, &lane_t);
+		hits += _whitgl_narrowphase_store(&t[i], lane_t, hit, n);
+	}
+	return hits;
+}
+
+// The circle hits the box wherever its centre hits the box grown by its
+// radius, except near the corners, which are rounded. A path entering a corner
+// square of the grown box can only go on to hit that corner's circle.
+whitgl_int whitgl_narrowphase_swept_circles_faabbs(const whitgl_fvec_soa* start, const whitgl_fvec_soa* speed, const float* size, const whitgl_fvec_soa* box_a, const whitgl_fvec_soa* box_b, float* t)
+{
+	_whitgl_narrowphase_check(start, speed);
+	_whitgl_narrowphase_check(start, box_a);
+	_whitgl_narrowphase_check(start, box_b);
+	whitgl_int hits = 0;
+	whitgl_int i;
+	for(i=0; i<start->count; i+=WHITGL_SIMD_WIDTH)
+	{
+		whitgl_int n = _whitgl_narrowphase_remaining(start->count, i);
+		whitgl_simd_lane r = _whitgl_narrowphase_load(&size[i], n);
+		whitgl_simd_lane sx = WHITGL_NARROWPHASE_LANE(start->x, i);
+		whitgl_simd_lane sy = WHITGL_NARROWPHASE_LANE(start->y, i);
+		whitgl_simd_lane vx = WHITGL_NARROWPHASE_LANE(speed->x, i);
+		whitgl_simd_lane vy = WHITGL_NARROWPHASE_LANE(speed->y, i);
+		whitgl_simd_lane ax = WHITGL_NARROWPHASE_LANE(box_a->x, i);
+		whitgl_simd_lane ay = WHITGL_NARROWPHASE_LANE(box_a->y, i);
+		whitgl_simd_lane bx = WHITGL_NARROWPHASE_LANE(box_b->x, i);
+		whitgl_simd_lane by = WHITGL_NARROWPHASE_LANE(box_b->y, i);
+		whitgl_simd_lane min_x = _whitgl_simd_min(ax, bx);
+		whitgl_simd_lane min_y = _whitgl_simd_min(ay, by);
+		whitgl_simd_lane max_x = _whitgl_simd_max(ax, bx);
+		whitgl_simd_lane max_y = _whitgl_simd_max(ay, by);
+		whitgl_simd_lane lane_t;
+		whitgl_simd_mask hit = _whitgl_narrowphase_slab(sx, sy, vx, vy, min_x-r, min_y-r, max_x+r, max_y+r, &lane_t);
+		whitgl_simd_lane px = sx + vx*lane_t;
+		whitgl_simd_lane py = sy + vy*lane_t;
+		whitgl_simd_mask corner = ((px < min_x) | (px > max_x)) & ((py < min_y) | (py > max_y));
+		whitgl_simd_lane cx = _whitgl_simd_select(px < min_x, min_x, max_x);
+		whitgl_simd_lane cy = _whitgl_simd_select(py < min_y, min_y, max_y);
+		whitgl_simd_lane corner_t;
+		whitgl_simd_mask corner_hit = _whitgl_narrowphase_circle(sx-cx, sy-cy, vx, vy, r, &corner_t);
+		hit = hit & (_whitgl_simd_not(corner) | corner_hit);
+		lane_t = _whitgl_simd_select(corner, corner_t, lane_t);
+		hits += _whitgl_narrowphase_store(&t[i], lane_t, hit, n);
+	}
+	return hits;
+}
+
+whitgl_int whitgl_narrowphase_segments_faabbs(const whitgl_fvec_soa* start, const whitgl_fvec_soa* speed, const whitgl_fvec_soa* box_a, const whitgl_fvec_soa* box_b, float* t)
+{
+	_whitgl_narrowphase_check(start, speed);
+	_whitgl_narrowphase_check(start, box_a);
+	_whitgl_narrowphase_check(start, box_b);
+	whitgl_int hits = 0;
+	whitgl_int i;
+	for(i=0; i<start->count; i+=WHITGL_SIMD_WIDTH)
+	{
+		whitgl_int n = _whitgl_narrowphase_remaining(start->count, i);
+		whitgl_simd_lane ax = WHITGL_NARROWPHASE_LANE(box_a->x, i);
+		whitgl_simd_lane ay = WHITGL_NARROWPHASE_LANE(box_a->y, i);
+		whitgl_simd_lane bx = WHITGL_NARROWPHASE_LANE(box_b->x, i);
+		whitgl_simd_lane by = WHITGL_NARROWPHASE_LANE(box_b->y, i);
+		whitgl_simd_lane lane_t;
+		whitgl_simd_mask hit = _whitgl_narrowphase_slab(WHITGL_NARROWPHASE_LANE(start->x, i), WHITGL_NARROWPHASE_LANE(start->y, i),
+			WHITGL_NARROWPHASE_LANE(speed->x, i), WHITGL_NARROWPHASE_LANE(speed->y, i),
+			_whitgl_simd_min(ax, bx), _whitgl_simd_min(ay, by), _whitgl_simd_max(ax, bx), _whitgl_simd_max(ay, by), &lane_t);
+		hits += _whitgl_narrowphase_store(&t[i], lane_t, hit, n);
+	}
+	return hits;
+}
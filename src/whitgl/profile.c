@@ -2,82 +2,610 @@
 #include <whitgl/profile.h>
 #include <whitgl/sys.h>
 
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WHITGL_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+// GPU sections are timestamp pairs recorded into one of a ring of query
+// sets, one set per frame. Sets are read back only once the GPU has
+// finished with them, and a frame is dropped rather than waited on if its
+// set is still busy.
+typedef struct
+{
+	const char* name;
+	whitgl_int depth;
+	GLuint begin;
+	GLuint end;
+} whitgl_profile_gpu_event;
+
+typedef struct
+{
+	whitgl_int frame;
+	whitgl_bool pending;
+	whitgl_int num_events;
+	whitgl_int max_events;
+	whitgl_profile_gpu_event* events;
+	GLuint last_query; // written last, so the GPU finishes it last
+} whitgl_profile_query_set;
+static const whitgl_profile_query_set whitgl_profile_query_set_zero = {0, false, 0, 0, NULL, 0};
 
 typedef struct
 {
 	const char* name;
+	whitgl_int depth;
 	whitgl_float total;
-} whitgl_profile_event;
-static const whitgl_profile_event whitgl_profile_event_zero = {NULL,0};
-#define MAX_EVENTS (16)
-whitgl_profile_event gpu_events[MAX_EVENTS];
-whitgl_int next_gpu_event;
+} whitgl_profile_stat;
+
+#define WHITGL_PROFILE_QUERY_SETS (4)
+#define WHITGL_PROFILE_MAX_DEPTH (16)
+whitgl_profile_query_set _query_sets[WHITGL_PROFILE_QUERY_SETS];
+whitgl_int _current_set;
+whitgl_bool _recording;
+whitgl_int _open_events[WHITGL_PROFILE_MAX_DEPTH];
+whitgl_int _depth;
+whitgl_int _section_depth;
+whitgl_int _frame_index;
+whitgl_int _dropped_frames;
+
+whitgl_profile_gpu_result* _results;
+whitgl_int _num_results;
+whitgl_int _max_results;
+whitgl_int _results_frame;
 
-whitgl_float _frame_start;
+whitgl_profile_stat* _stats;
+whitgl_int _num_stats;
+whitgl_int _gpu_frames;
+
+double _frame_start;
 whitgl_float _frame_update;
 whitgl_float _frame_total;
 whitgl_int _frames;
-GLuint _front_queries[MAX_EVENTS];
-GLuint _back_queries[MAX_EVENTS];
-whitgl_bool _front;
-whitgl_bool _first;
 whitgl_bool _should_report;
 
 #define FRAMES_TO_COUNT (60)
 
+// CPU zones go into a buffer per thread, written only by that thread and
+// published with a release store of the count, so recording takes no locks.
+// Threads are linked into a list when they record their first zone, and
+// their buffer is only allocated then, so untraced runs don't pay for it.
+// A full buffer drops new zones, counted and logged the first time.
+typedef struct
+{
+	const char* name;
+	uint64_t begin;
+	uint64_t end; // 0 while the zone is open
+} whitgl_profile_zone;
+
+typedef struct whitgl_profile_thread
+{
+	whitgl_int tid;
+	const char* name;
+	whitgl_profile_zone* zones;
+	whitgl_int num_zones;
+	whitgl_int open_zones[WHITGL_PROFILE_MAX_DEPTH];
+	whitgl_int depth;
+	whitgl_int dropped;
+	struct whitgl_profile_thread* next;
+} whitgl_profile_thread;
+
+#define WHITGL_PROFILE_TRACE_ZONES (1<<16)
+whitgl_profile_thread* _trace_threads = NULL;
+whitgl_int _trace_next_tid = 1;
+whitgl_bool _trace_enabled = false;
+uint64_t _trace_epoch = 0;
+__thread whitgl_profile_thread* _trace_thread = NULL;
+whitgl_profile_thread* _trace_gpu = NULL; // GPU sections, converted to the CPU clock
+int64_t _gpu_clock_offset = 0;
+uint64_t _frame_start_ns = 0;
+uint64_t _drawing_start = 0;
+
+uint64_t whitgl_profile_now_ns()
+{
+#ifdef WHITGL_WINDOWS
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t)((double)count.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+whitgl_profile_thread* _whitgl_profile_new_thread(const char* name)
+{
+	whitgl_profile_thread* thread = malloc(sizeof(whitgl_profile_thread));
+	thread->tid = __atomic_fetch_add(&_trace_next_tid, 1, __ATOMIC_RELAXED);
+	thread->name = name;
+	thread->zones = NULL;
+	thread->num_zones = 0;
+	thread->depth = 0;
+	thread->dropped = 0;
+	thread->next = __atomic_load_n(&_trace_threads, __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&_trace_threads, &thread->next, thread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return thread;
+}
+
+whitgl_profile_thread* _whitgl_profile_this_thread()
+{
+	if(!_trace_thread)
+		_trace_thread = _whitgl_profile_new_thread(NULL);
+	return _trace_thread;
+}
+
+whitgl_bool _whitgl_profile_reserve_zone(whitgl_profile_thread* thread)
+{
+	if(!thread->zones)
+		thread->zones = malloc(sizeof(whitgl_profile_zone)*WHITGL_PROFILE_TRACE_ZONES);
+	if(thread->num_zones < WHITGL_PROFILE_TRACE_ZONES)
+		return true;
+	if(thread->dropped == 0)
+		WHITGL_LOG("Trace thread %d is full, dropping zones until reset", (int)thread->tid);
+	thread->dropped++;
+	return false;
+}
+
+// Adds a zone that is already finished
+void _whitgl_profile_trace_add(whitgl_profile_thread* thread, const char* name, uint64_t begin, uint64_t end)
+{
+	if(!_whitgl_profile_reserve_zone(thread))
+		return;
+	whitgl_profile_zone* zone = &thread->zones[thread->num_zones];
+	zone->name = name;
+	zone->begin = begin;
+	zone->end = end;
+	__atomic_store_n(&thread->num_zones, thread->num_zones+1, __ATOMIC_RELEASE);
+}
+
+void whitgl_profile_zone_begin(const char* name)
+{
+	if(!_trace_enabled)
+		return;
+	whitgl_profile_thread* thread = _whitgl_profile_this_thread();
+	thread->depth++;
+	if(thread->depth > WHITGL_PROFILE_MAX_DEPTH)
+		return;
+	if(!_whitgl_profile_reserve_zone(thread))
+	{
+		thread->open_zones[thread->depth-1] = -1;
+		return;
+	}
+	thread->open_zones[thread->depth-1] = thread->num_zones;
+	_whitgl_profile_trace_add(thread, name, whitgl_profile_now_ns(), 0);
+}
+void whitgl_profile_zone_end()
+{
+	whitgl_profile_thread* thread = _trace_thread;
+	if(!thread || thread->depth == 0)
+		return;
+	thread->depth--;
+	if(thread->depth >= WHITGL_PROFILE_MAX_DEPTH || thread->open_zones[thread->depth] == -1)
+		return;
+	__atomic_store_n(&thread->zones[thread->open_zones[thread->depth]].end, whitgl_profile_now_ns(), __ATOMIC_RELEASE);
+}
+void whitgl_profile_trace_name_thread(const char* name)
+{
+	_whitgl_profile_this_thread()->name = name;
+}
+
+// Maps GL_TIMESTAMP onto whitgl_profile_now_ns
+void _whitgl_profile_calibrate_gpu_clock()
+{
+	GLint64 gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	_gpu_clock_offset = (int64_t)whitgl_profile_now_ns() - gpu_now;
+}
+
+void whitgl_profile_trace_enable(whitgl_bool enable)
+{
+	if(enable && !_trace_enabled)
+	{
+		if(_trace_epoch == 0)
+			_trace_epoch = whitgl_profile_now_ns();
+		_whitgl_profile_calibrate_gpu_clock();
+	}
+	_trace_enabled = enable;
+}
+
+// Only safe while no other thread is recording
+void whitgl_profile_trace_reset()
+{
+	whitgl_profile_thread* thread;
+	for(thread = __atomic_load_n(&_trace_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next)
+	{
+		thread->num_zones = 0;
+		thread->depth = 0;
+		thread->dropped = 0;
+	}
+	_trace_epoch = whitgl_profile_now_ns();
+}
+
+void _whitgl_profile_write_string(FILE* file, const char* s)
+{
+	fputc('"', file);
+	for(; s && *s; s++)
+	{
+		if(*s == '"' || *s == '\\')
+			fputc('\\', file);
+		if((unsigned char)*s >= ' ')
+			fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+whitgl_int whitgl_profile_trace_dropped()
+{
+	whitgl_int dropped = 0;
+	whitgl_profile_thread* thread;
+	for(thread = __atomic_load_n(&_trace_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next)
+		dropped += __atomic_load_n(&thread->dropped, __ATOMIC_RELAXED);
+	return dropped;
+}
+
+// Writes every finished zone in the Chrome trace event format, which
+// about:tracing and Perfetto both load
+whitgl_bool whitgl_profile_trace_save(const char* filename)
+{
+	FILE* file = fopen(filename, "w");
+	if(!file)
+	{
+		WHITGL_LOG("Couldn't open trace file %s", filename);
+		return false;
+	}
+	fprintf(file, "{\"traceEvents\":[\n");
+	whitgl_bool first = true;
+	whitgl_profile_thread* thread;
+	for(thread = __atomic_load_n(&_trace_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", (int)thread->tid);
+		first = false;
+		if(thread->name)
+			_whitgl_profile_write_string(file, thread->name);
+		else
+			fprintf(file, "\"thread %d\"", (int)thread->tid);
+		fprintf(file, "}}");
+		whitgl_int num_zones = __atomic_load_n(&thread->num_zones, __ATOMIC_ACQUIRE);
+		whitgl_int i;
+		for(i=0; i<num_zones; i++)
+		{
+			const whitgl_profile_zone* zone = &thread->zones[i];
+			uint64_t end = __atomic_load_n(&zone->end, __ATOMIC_ACQUIRE);
+			if(end == 0 || zone->begin < _trace_epoch)
+				continue;
+			fprintf(file, ",\n{\"name\":");
+			_whitgl_profile_write_string(file, zone->name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", (int)thread->tid, (zone->begin-_trace_epoch)/1000.0, (end-zone->begin)/1000.0);
+		}
+		if(thread->dropped > 0)
+			WHITGL_LOG("Trace thread %d dropped %d zones", (int)thread->tid, (int)thread->dropped);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
+
+// Log-linear histograms over a rolling window of samples, in microseconds.
+// Values below 64 get a bucket each, above that every power of two is split
+// into 32 buckets, so a bucket is never wider than about 3% of its value.
+#define WHITGL_PROFILE_LINEAR_BUCKETS (64)
+#define WHITGL_PROFILE_SUB_BUCKETS (32)
+#define WHITGL_PROFILE_BUCKETS (WHITGL_PROFILE_LINEAR_BUCKETS+18*WHITGL_PROFILE_SUB_BUCKETS)
+#define WHITGL_PROFILE_WINDOW (1024)
+typedef struct
+{
+	uint32_t counts[WHITGL_PROFILE_BUCKETS];
+	uint32_t samples[WHITGL_PROFILE_WINDOW];
+	whitgl_int next_sample;
+	whitgl_int num_samples;
+	whitgl_int stutters;
+	whitgl_int total_stutters;
+	uint64_t sum;
+} whitgl_profile_histogram;
+whitgl_profile_histogram _histograms[WHITGL_PROFILE_NUM_METRICS];
+whitgl_float _stutter_threshold = 1.0/30.0;
+whitgl_bool _dump_at_shutdown = false;
+double _last_frame_end = -1;
+
+whitgl_int _whitgl_profile_bucket(uint32_t us)
+{
+	if(us < WHITGL_PROFILE_LINEAR_BUCKETS)
+		return us;
+	whitgl_int msb = 31 - __builtin_clz(us);
+	whitgl_int shift = msb-5;
+	whitgl_int index = WHITGL_PROFILE_LINEAR_BUCKETS + (shift-1)*WHITGL_PROFILE_SUB_BUCKETS + (us>>shift) - WHITGL_PROFILE_SUB_BUCKETS;
+	return whitgl_imin(index, WHITGL_PROFILE_BUCKETS-1);
+}
+// Middle of the range a bucket covers
+whitgl_float _whitgl_profile_bucket_value(whitgl_int index)
+{
+	if(index < WHITGL_PROFILE_LINEAR_BUCKETS)
+		return index / 1000000.0;
+	whitgl_int shift = (index-WHITGL_PROFILE_LINEAR_BUCKETS)/WHITGL_PROFILE_SUB_BUCKETS+1;
+	whitgl_int mantissa = (index-WHITGL_PROFILE_LINEAR_BUCKETS)%WHITGL_PROFILE_SUB_BUCKETS+WHITGL_PROFILE_SUB_BUCKETS;
+	return ((mantissa<<shift) + (1<<shift)/2.0) / 1000000.0;
+}
+
+void _whitgl_profile_histogram_add(whitgl_profile_metric metric, whitgl_float seconds)
+{
+	whitgl_profile_histogram* h = &_histograms[metric];
+	uint32_t stutter_us = _stutter_threshold*1000000;
+	uint32_t us = seconds <= 0 ? 0 : seconds >= 4000 ? 4000000000u : (uint32_t)(seconds*1000000);
+	if(h->num_samples == WHITGL_PROFILE_WINDOW)
+	{
+		uint32_t old = h->samples[h->next_sample];
+		h->counts[_whitgl_profile_bucket(old)]--;
+		h->sum -= old;
+		if(old > stutter_us)
+			h->stutters--;
+	} else
+	{
+		h->num_samples++;
+	}
+	h->samples[h->next_sample] = us;
+	h->next_sample = (h->next_sample+1)%WHITGL_PROFILE_WINDOW;
+	h->counts[_whitgl_profile_bucket(us)]++;
+	h->sum += us;
+	if(us > stutter_us)
+	{
+		h->stutters++;
+		h->total_stutters++;
+	}
+}
+
+whitgl_profile_distribution whitgl_profile_get_distribution(whitgl_profile_metric metric)
+{
+	const whitgl_profile_histogram* h = &_histograms[metric];
+	whitgl_profile_distribution out = whitgl_profile_distribution_zero;
+	out.count = h->num_samples;
+	out.stutters = h->stutters;
+	out.total_stutters = h->total_stutters;
+	if(h->num_samples == 0)
+		return out;
+	out.mean = ((whitgl_float)h->sum)/h->num_samples/1000000.0;
+	whitgl_float percentiles[3] = {0.5, 0.9, 0.99};
+	whitgl_float* values[3] = {&out.p50, &out.p90, &out.p99};
+	whitgl_int next = 0;
+	whitgl_int seen = 0;
+	whitgl_int i;
+	for(i=0; i<WHITGL_PROFILE_BUCKETS; i++)
+	{
+		if(h->counts[i] == 0)
+			continue;
+		seen += h->counts[i];
+		while(next < 3 && seen >= percentiles[next]*h->num_samples)
+			*values[next++] = _whitgl_profile_bucket_value(i);
+		out.max = _whitgl_profile_bucket_value(i);
+	}
+	return out;
+}
+void whitgl_profile_set_stutter_threshold(whitgl_float seconds)
+{
+	_stutter_threshold = seconds;
+	whitgl_int i, j;
+	uint32_t stutter_us = seconds*1000000;
+	for(i=0; i<WHITGL_PROFILE_NUM_METRICS; i++)
+	{
+		_histograms[i].stutters = 0;
+		for(j=0; j<_histograms[i].num_samples; j++)
+			if(_histograms[i].samples[j] > stutter_us)
+				_histograms[i].stutters++;
+	}
+}
+void whitgl_profile_dump_at_shutdown(whitgl_bool dump)
+{
+	_dump_at_shutdown = dump;
+}
+void whitgl_profile_dump_distributions()
+{
+	const char* names[WHITGL_PROFILE_NUM_METRICS] = {"frame", "update", "gpu"};
+	whitgl_int i;
+	for(i=0; i<WHITGL_PROFILE_NUM_METRICS; i++)
+	{
+		whitgl_profile_distribution d = whitgl_profile_get_distribution(i);
+		WHITGL_LOG("%s ms: mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f stutters %d/%d (%d total)", names[i], d.mean*1000, d.p50*1000, d.p90*1000, d.p99*1000, d.max*1000, (int)d.stutters, (int)d.count, (int)d.total_stutters);
+	}
+}
+
 void whitgl_profile_init()
 {
-	glGenQueries(MAX_EVENTS, _front_queries);
-	glGenQueries(MAX_EVENTS, _back_queries);
-	_first = true;
-	_front = true;
+	whitgl_int i;
+	for(i=0; i<WHITGL_PROFILE_QUERY_SETS; i++)
+		_query_sets[i] = whitgl_profile_query_set_zero;
+	_current_set = 0;
+	_recording = true;
+	_depth = 0;
+	_section_depth = -1;
+	_frame_index = 0;
+	_dropped_frames = 0;
+	_results = NULL;
+	_num_results = 0;
+	_max_results = 0;
+	_results_frame = -1;
+	_stats = NULL;
+	_num_stats = 0;
+	_gpu_frames = 0;
+	_frame_update = 0;
+	_frame_total = 0;
+	_frames = 0;
 	_should_report = false;
+	memset(_histograms, 0, sizeof(_histograms));
+	_last_frame_end = -1;
+	_frame_start_ns = 0;
+	if(!_trace_gpu)
+		_trace_gpu = _whitgl_profile_new_thread("GPU");
+	_whitgl_profile_calibrate_gpu_clock();
 }
 void whitgl_profile_start_frame()
 {
 	_frame_start = whitgl_sys_get_time();
+	_frame_start_ns = whitgl_profile_now_ns();
 }
 void whitgl_profile_start_drawing()
 {
-	_frame_update += whitgl_sys_get_time()-_frame_start;
-	next_gpu_event = 0;
+	// the first frame has no start, the time since zero would be all of init
+	if(_frame_start_ns != 0)
+	{
+		_frame_update += whitgl_sys_get_time()-_frame_start;
+		_whitgl_profile_histogram_add(WHITGL_PROFILE_UPDATE, whitgl_sys_get_time()-_frame_start);
+	}
+	_drawing_start = whitgl_profile_now_ns();
+	if(_trace_enabled && _frame_start_ns != 0)
+		_whitgl_profile_trace_add(_whitgl_profile_this_thread(), "update", _frame_start_ns, _drawing_start);
 	whitgl_profile_gpu_section("start_drawing");
 }
 
+void whitgl_profile_gpu_push(const char* name)
+{
+	_depth++;
+	if(!_recording || _depth > WHITGL_PROFILE_MAX_DEPTH)
+		return;
+	whitgl_profile_query_set* set = &_query_sets[_current_set];
+	if(set->num_events >= set->max_events)
+	{
+		whitgl_int old_max = set->max_events;
+		set->max_events = whitgl_imax(old_max*2, 16);
+		set->events = realloc(set->events, sizeof(whitgl_profile_gpu_event)*set->max_events);
+		whitgl_int i;
+		for(i=old_max; i<set->max_events; i++)
+		{
+			glGenQueries(1, &set->events[i].begin);
+			glGenQueries(1, &set->events[i].end);
+		}
+	}
+	whitgl_profile_gpu_event* event = &set->events[set->num_events];
+	event->name = name;
+	event->depth = _depth-1;
+	glQueryCounter(event->begin, GL_TIMESTAMP);
+	set->last_query = event->begin;
+	_open_events[_depth-1] = set->num_events;
+	set->num_events++;
+}
+void whitgl_profile_gpu_pop()
+{
+	if(_depth == 0)
+	{
+		WHITGL_LOG("gpu profile pop without push");
+		return;
+	}
+	_depth--;
+	if(!_recording || _depth >= WHITGL_PROFILE_MAX_DEPTH)
+		return;
+	whitgl_profile_query_set* set = &_query_sets[_current_set];
+	glQueryCounter(set->events[_open_events[_depth]].end, GL_TIMESTAMP);
+	set->last_query = set->events[_open_events[_depth]].end;
+}
 void whitgl_profile_gpu_section(const char* name)
 {
-	if(next_gpu_event > 0)
-		glEndQuery(GL_TIME_ELAPSED);
-	gpu_events[next_gpu_event].name = name;
-	glBeginQuery(GL_TIME_ELAPSED, _front ? _front_queries[next_gpu_event] : _back_queries[next_gpu_event]);
-	next_gpu_event++;
+	if(_section_depth != -1)
+		while(_depth > _section_depth)
+			whitgl_profile_gpu_pop();
+	_section_depth = _depth;
+	whitgl_profile_gpu_push(name);
 }
 
-void whitgl_profile_end_frame()
+whitgl_profile_stat* _whitgl_profile_stat(const char* name, whitgl_int depth)
 {
-	glEndQuery(GL_TIME_ELAPSED);
-	if(!_first)
+	whitgl_int i;
+	for(i=0; i<_num_stats; i++)
+		if(_stats[i].depth == depth && strcmp(_stats[i].name, name) == 0)
+			return &_stats[i];
+	_stats = realloc(_stats, sizeof(whitgl_profile_stat)*(_num_stats+1));
+	_stats[_num_stats].name = name;
+	_stats[_num_stats].depth = depth;
+	_stats[_num_stats].total = 0;
+	return &_stats[_num_stats++];
+}
+
+// Reads back every finished set, oldest first, without waiting on the GPU
+void _whitgl_profile_collect()
+{
+	while(true)
 	{
-		GLuint* query_array = !_front ? _front_queries : _back_queries;
-		int done = 0;
-		while (!done)
+		whitgl_int oldest = -1;
+		whitgl_int i;
+		for(i=0; i<WHITGL_PROFILE_QUERY_SETS; i++)
+			if(_query_sets[i].pending && (oldest == -1 || _query_sets[i].frame < _query_sets[oldest].frame))
+				oldest = i;
+		if(oldest == -1)
+			return;
+		whitgl_profile_query_set* set = &_query_sets[oldest];
+		// timestamps complete in order, so the last one written covers the rest.
+		// With nested sections that's the end of an outer one, not of the last event
+		GLint available = 0;
+		glGetQueryObjectiv(set->last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			return;
+		if(set->num_events > _max_results)
 		{
-			glGetQueryObjectiv(query_array[next_gpu_event-1], GL_QUERY_RESULT_AVAILABLE, &done);
+			_max_results = set->num_events;
+			_results = realloc(_results, sizeof(whitgl_profile_gpu_result)*_max_results);
 		}
-		whitgl_int i;
-		for(i=0; i<next_gpu_event; i++)
+		GLuint64 frame_begin = 0;
+		for(i=0; i<set->num_events; i++)
 		{
-			GLuint64 timer;
-			glGetQueryObjectui64v(query_array[i], GL_QUERY_RESULT, &timer);
-			gpu_events[i].total += timer / 1000000000.0;
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(set->events[i].begin, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(set->events[i].end, GL_QUERY_RESULT, &end);
+			if(i == 0)
+				frame_begin = begin;
+			_results[i].name = set->events[i].name;
+			_results[i].depth = set->events[i].depth;
+			_results[i].start = (begin-frame_begin) / 1000000000.0;
+			_results[i].duration = end > begin ? (end-begin) / 1000000000.0 : 0;
+			_whitgl_profile_stat(_results[i].name, _results[i].depth)->total += _results[i].duration;
+			if(_trace_enabled)
+				_whitgl_profile_trace_add(_trace_gpu, _results[i].name, begin+_gpu_clock_offset, (end > begin ? end : begin)+_gpu_clock_offset);
 		}
+		whitgl_float gpu_total = 0;
+		for(i=0; i<set->num_events; i++)
+			if(_results[i].depth == 0)
+				gpu_total += _results[i].duration;
+		_whitgl_profile_histogram_add(WHITGL_PROFILE_GPU, gpu_total);
+		_num_results = set->num_events;
+		_results_frame = set->frame;
+		_gpu_frames++;
+		set->pending = false;
 	}
-	_front = !_front;
-	_first = false;
+}
+
+void whitgl_profile_end_frame()
+{
+	if(_trace_enabled && _drawing_start != 0)
+		_whitgl_profile_trace_add(_whitgl_profile_this_thread(), "draw", _drawing_start, whitgl_profile_now_ns());
+	while(_depth > 0)
+		whitgl_profile_gpu_pop();
+	_section_depth = -1;
+	whitgl_profile_query_set* set = &_query_sets[_current_set];
+	if(_recording && set->num_events > 0)
+	{
+		set->frame = _frame_index;
+		set->pending = true;
+	}
+	_frame_index++;
+	_whitgl_profile_collect();
+	_current_set = (_current_set+1)%WHITGL_PROFILE_QUERY_SETS;
+	set = &_query_sets[_current_set];
+	_recording = !set->pending;
+	if(_recording)
+		set->num_events = 0;
+	else
+		_dropped_frames++;
+
 	_frame_total += whitgl_sys_get_time()-_frame_start;
+	double frame_end = whitgl_sys_get_time();
+	if(_last_frame_end >= 0)
+		_whitgl_profile_histogram_add(WHITGL_PROFILE_FRAME, frame_end-_last_frame_end);
+	_last_frame_end = frame_end;
 	_frames++;
 	if(_frames >= FRAMES_TO_COUNT)
 	{
@@ -85,18 +613,22 @@ void whitgl_profile_end_frame()
 		_frames -= FRAMES_TO_COUNT;
 		whitgl_int i;
 		whitgl_float average_gpu = 0;
-		for(i=0; i<next_gpu_event; i++)
+		for(i=0; i<_num_stats; i++)
 		{
-			whitgl_float event_avg = gpu_events[i].total/FRAMES_TO_COUNT;
-			average_gpu += event_avg;
+			whitgl_float event_avg = _gpu_frames > 0 ? _stats[i].total/_gpu_frames : 0;
+			if(_stats[i].depth == 0)
+				average_gpu += event_avg;
 			if(_should_report)
-				WHITGL_LOG("%.1f%% %s", (event_avg/target)*100, gpu_events[i].name);
-			gpu_events[i] = whitgl_profile_event_zero;
+				WHITGL_LOG("%*s%.1f%% %s", (int)_stats[i].depth*2, "", (event_avg/target)*100, _stats[i].name);
+			_stats[i].total = 0;
 		}
 		whitgl_float average_total = _frame_total/FRAMES_TO_COUNT;
 		whitgl_float average_update = _frame_update/FRAMES_TO_COUNT;
 		if(_should_report)
-			WHITGL_LOG("update %.2f%% gpu %.2f%% total %.2f%%", (average_update/target)*100, (average_gpu/target)*100, (average_total/target)*100);
+			WHITGL_LOG("update %.2f%% gpu %.2f%% total %.2f%% dropped %d", (average_update/target)*100, (average_gpu/target)*100, (average_total/target)*100, (int)_dropped_frames);
+		if(_trace_enabled)
+			_whitgl_profile_calibrate_gpu_clock();
+		_gpu_frames = 0;
 		_frame_update = 0;
 		_frame_total = 0;
 	}
@@ -105,8 +637,39 @@ void whitgl_profile_should_report(whitgl_bool report)
 {
 	_should_report = report;
 }
+whitgl_int whitgl_profile_gpu_results(const whitgl_profile_gpu_result** results)
+{
+	*results = _results;
+	return _num_results;
+}
+whitgl_int whitgl_profile_gpu_results_frame()
+{
+	return _results_frame;
+}
+whitgl_int whitgl_profile_dropped_frames()
+{
+	return _dropped_frames;
+}
 void whitgl_profile_shutdown()
 {
-	glDeleteQueries(MAX_EVENTS, _front_queries);
-	glDeleteQueries(MAX_EVENTS, _back_queries);
+	if(_dump_at_shutdown)
+		whitgl_profile_dump_distributions();
+	whitgl_int i, j;
+	for(i=0; i<WHITGL_PROFILE_QUERY_SETS; i++)
+	{
+		for(j=0; j<_query_sets[i].max_events; j++)
+		{
+			glDeleteQueries(1, &_query_sets[i].events[j].begin);
+			glDeleteQueries(1, &_query_sets[i].events[j].end);
+		}
+		free(_query_sets[i].events);
+		_query_sets[i] = whitgl_profile_query_set_zero;
+	}
+	free(_results);
+	free(_stats);
+	_results = NULL;
+	_stats = NULL;
+	_num_results = 0;
+	_max_results = 0;
+	_num_stats = 0;
 }
@@ -24,5 +24,13 @@ whitgl_int whitgl_random_int(whitgl_random_seed* seed, whitgl_int size)
 
 whitgl_float whitgl_random_float(whitgl_random_seed* seed)
 {
+#ifdef WHITGL_MATH_FLOAT32
+	// doubles just under 1 would round up to 1.0f
+	whitgl_float out = tinymt64_generate_doubleOO(seed);
+	if(out >= 1)
+		out = 1-FLT_EPSILON/2;
+	return out;
+#else
 	return tinymt64_generate_doubleOO(seed);
+#endif
 }
@@ -0,0 +1,687 @@
+#include <whitgl/logging.h>
+#include <whitgl/raster.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WHITGL_WINDOWS
+#include <pthread.h>
+#include <unistd.h>
+#define WHITGL_RASTER_THREADS
+#endif
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 9)
+#define WHITGL_RASTER_VECTOR
+typedef uint8_t whitgl_raster_u8x16 __attribute__((vector_size(16)));
+typedef uint16_t whitgl_raster_u16x16 __attribute__((vector_size(32)));
+#endif
+
+#define WHITGL_RASTER_TILE (64)
+#define WHITGL_RASTER_MAX_THREADS (32)
+#define WHITGL_RASTER_IMAGE_MAX (64)
+
+typedef enum
+{
+	WHITGL_RASTER_RECT,
+	WHITGL_RASTER_TEX,
+	WHITGL_RASTER_TRI,
+	WHITGL_RASTER_LINE,
+} whitgl_raster_command_type;
+
+typedef struct
+{
+	whitgl_raster_command_type type;
+	whitgl_iaabb bounds; // pixels touched, b exclusive
+	whitgl_sys_color col;
+	union
+	{
+		struct
+		{
+			whitgl_int image_index;
+			whitgl_iaabb src;
+			whitgl_iaabb dest;
+		} tex;
+		whitgl_fvec tri[3];
+		whitgl_iaabb line;
+	} u;
+} whitgl_raster_command;
+
+typedef struct
+{
+	whitgl_int id;
+	whitgl_ivec size;
+	whitgl_sys_color* data;
+} whitgl_raster_image;
+
+whitgl_raster_setup _raster_setup;
+whitgl_sys_color* _raster_pixels = NULL;
+whitgl_bool _raster_clear = false;
+
+whitgl_raster_image _raster_images[WHITGL_RASTER_IMAGE_MAX];
+whitgl_int _raster_num_images = 0;
+
+whitgl_raster_command* _raster_commands = NULL;
+whitgl_int _raster_num_commands = 0;
+whitgl_int _raster_max_commands = 0;
+
+// Commands binned per tile, tile i uses bin_indices[bin_starts[i]..bin_starts[i+1]]
+whitgl_ivec _raster_num_tiles;
+whitgl_int* _raster_bin_starts = NULL;
+whitgl_int* _raster_bin_indices = NULL;
+whitgl_int _raster_max_bin_indices = 0;
+whitgl_int _raster_next_tile;
+
+#ifdef WHITGL_RASTER_THREADS
+// Workers live from init to close and sleep until draw_finish bumps the generation
+pthread_t _raster_threads[WHITGL_RASTER_MAX_THREADS];
+whitgl_int _raster_num_threads = 0;
+pthread_mutex_t _raster_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t _raster_wake = PTHREAD_COND_INITIALIZER;
+pthread_cond_t _raster_idle = PTHREAD_COND_INITIALIZER;
+whitgl_int _raster_generation = 0;
+whitgl_int _raster_busy = 0;
+whitgl_bool _raster_quit = false;
+void* _whitgl_raster_worker(void* arg);
+#endif
+
+bool whitgl_raster_init(whitgl_raster_setup setup)
+{
+	if(setup.size.x <= 0 || setup.size.y <= 0)
+	{
+		WHITGL_LOG("Invalid raster size %d %d", (int)setup.size.x, (int)setup.size.y);
+		return false;
+	}
+	if(setup.num_threads <= 0)
+	{
+#ifdef WHITGL_RASTER_THREADS
+		setup.num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if(setup.num_threads <= 0)
+			setup.num_threads = 1;
+	}
+#ifndef WHITGL_RASTER_THREADS
+	setup.num_threads = 1;
+#endif
+	if(setup.num_threads > WHITGL_RASTER_MAX_THREADS)
+		setup.num_threads = WHITGL_RASTER_MAX_THREADS;
+	_raster_setup = setup;
+	WHITGL_LOG("Raster init w%d h%d threads %d", (int)setup.size.x, (int)setup.size.y, (int)setup.num_threads);
+
+	_raster_pixels = malloc(sizeof(whitgl_sys_color)*setup.size.x*setup.size.y);
+	whitgl_int i;
+	for(i=0; i<setup.size.x*setup.size.y; i++)
+		_raster_pixels[i] = setup.clear_color;
+	_raster_clear = false;
+
+	for(i=0; i<WHITGL_RASTER_IMAGE_MAX; i++)
+		_raster_images[i].id = -1;
+	_raster_num_images = 0;
+
+	_raster_num_tiles.x = (setup.size.x+WHITGL_RASTER_TILE-1)/WHITGL_RASTER_TILE;
+	_raster_num_tiles.y = (setup.size.y+WHITGL_RASTER_TILE-1)/WHITGL_RASTER_TILE;
+	_raster_bin_starts = malloc(sizeof(whitgl_int)*(_raster_num_tiles.x*_raster_num_tiles.y+1));
+	_raster_num_commands = 0;
+
+#ifdef WHITGL_RASTER_THREADS
+	// the calling thread works too, so start one fewer
+	whitgl_int num_threads = whitgl_imin(setup.num_threads, _raster_num_tiles.x*_raster_num_tiles.y);
+	_raster_quit = false;
+	_raster_num_threads = 0;
+	for(i=1; i<num_threads; i++)
+	{
+		if(pthread_create(&_raster_threads[_raster_num_threads], NULL, _whitgl_raster_worker, (void*)(intptr_t)_raster_generation) != 0)
+		{
+			WHITGL_LOG("Couldn't start raster thread %d", (int)i);
+			break;
+		}
+		_raster_num_threads++;
+	}
+#endif
+	return true;
+}
+
+void whitgl_raster_close()
+{
+	whitgl_int i;
+#ifdef WHITGL_RASTER_THREADS
+	pthread_mutex_lock(&_raster_mutex);
+	_raster_quit = true;
+	pthread_cond_broadcast(&_raster_wake);
+	pthread_mutex_unlock(&_raster_mutex);
+	for(i=0; i<_raster_num_threads; i++)
+		pthread_join(_raster_threads[i], NULL);
+	_raster_num_threads = 0;
+#endif
+	for(i=0; i<_raster_num_images; i++)
+		free(_raster_images[i].data);
+	_raster_num_images = 0;
+	free(_raster_pixels);
+	free(_raster_commands);
+	free(_raster_bin_starts);
+	free(_raster_bin_indices);
+	_raster_pixels = NULL;
+	_raster_commands = NULL;
+	_raster_bin_starts = NULL;
+	_raster_bin_indices = NULL;
+	_raster_max_commands = 0;
+	_raster_max_bin_indices = 0;
+}
+
+void whitgl_raster_set_clear_color(whitgl_sys_color col)
+{
+	_raster_setup.clear_color = col;
+}
+
+void whitgl_raster_add_image_from_data(int id, whitgl_ivec size, const unsigned char* data)
+{
+	if(_raster_num_images >= WHITGL_RASTER_IMAGE_MAX)
+	{
+		WHITGL_PANIC("ERR Too many raster images");
+		return;
+	}
+	whitgl_raster_image* image = &_raster_images[_raster_num_images];
+	image->id = id;
+	image->size = size;
+	image->data = malloc(sizeof(whitgl_sys_color)*size.x*size.y);
+	memcpy(image->data, data, sizeof(whitgl_sys_color)*size.x*size.y);
+	_raster_num_images++;
+}
+
+whitgl_int _whitgl_raster_image_index(whitgl_int id)
+{
+	whitgl_int i;
+	for(i=0; i<_raster_num_images; i++)
+		if(_raster_images[i].id == id)
+			return i;
+	return -1;
+}
+
+whitgl_ivec whitgl_raster_get_image_size(whitgl_int id)
+{
+	whitgl_int index = _whitgl_raster_image_index(id);
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find raster image %d", (int)id);
+		return whitgl_ivec_zero;
+	}
+	return _raster_images[index].size;
+}
+
+whitgl_raster_command* _whitgl_raster_push(whitgl_raster_command_type type, whitgl_iaabb bounds, whitgl_sys_color col)
+{
+	whitgl_iaabb screen = {{0, 0}, _raster_setup.size};
+	bounds = whitgl_iaabb_intersection(bounds, screen);
+	if(bounds.a.x >= bounds.b.x || bounds.a.y >= bounds.b.y)
+		return NULL;
+	if(_raster_num_commands >= _raster_max_commands)
+	{
+		_raster_max_commands = whitgl_imax(_raster_max_commands*2, 256);
+		_raster_commands = realloc(_raster_commands, sizeof(whitgl_raster_command)*_raster_max_commands);
+	}
+	whitgl_raster_command* command = &_raster_commands[_raster_num_commands++];
+	command->type = type;
+	command->bounds = bounds;
+	command->col = col;
+	return command;
+}
+
+void whitgl_raster_draw_init()
+{
+	_raster_num_commands = 0;
+	_raster_clear = true;
+}
+
+void whitgl_raster_draw_iaabb(whitgl_iaabb rect, whitgl_sys_color col)
+{
+	whitgl_iaabb bounds = {{whitgl_imin(rect.a.x, rect.b.x), whitgl_imin(rect.a.y, rect.b.y)}, {whitgl_imax(rect.a.x, rect.b.x), whitgl_imax(rect.a.y, rect.b.y)}};
+	if(col.a == 0)
+		return;
+	_whitgl_raster_push(WHITGL_RASTER_RECT, bounds, col);
+}
+
+void whitgl_raster_draw_hollow_iaabb(whitgl_iaabb rect, whitgl_int width, whitgl_sys_color col)
+{
+	whitgl_iaabb n = {rect.a, {rect.b.x, rect.a.y+width}};
+	whitgl_iaabb e = {{rect.b.x-width, rect.a.y}, rect.b};
+	whitgl_iaabb s = {{rect.a.x, rect.b.y-width}, rect.b};
+	whitgl_iaabb w = {rect.a, {rect.a.x+width, rect.b.y}};
+	whitgl_raster_draw_iaabb(n, col);
+	whitgl_raster_draw_iaabb(e, col);
+	whitgl_raster_draw_iaabb(s, col);
+	whitgl_raster_draw_iaabb(w, col);
+}
+
+void whitgl_raster_draw_line(whitgl_iaabb l, whitgl_sys_color col)
+{
+	whitgl_iaabb bounds = {{whitgl_imin(l.a.x, l.b.x), whitgl_imin(l.a.y, l.b.y)}, {whitgl_imax(l.a.x, l.b.x)+1, whitgl_imax(l.a.y, l.b.y)+1}};
+	whitgl_raster_command* command = _whitgl_raster_push(WHITGL_RASTER_LINE, bounds, col);
+	if(command)
+		command->u.line = l;
+}
+
+void _whitgl_raster_draw_tri(whitgl_fvec a, whitgl_fvec b, whitgl_fvec c, whitgl_sys_color col)
+{
+	whitgl_float area = (b.x-a.x)*(c.y-a.y) - (b.y-a.y)*(c.x-a.x);
+	if(area == 0)
+		return;
+	if(area < 0)
+	{
+		whitgl_fvec swap = b;
+		b = c;
+		c = swap;
+	}
+	whitgl_iaabb bounds;
+	bounds.a.x = floor(whitgl_fmin(a.x, whitgl_fmin(b.x, c.x)));
+	bounds.a.y = floor(whitgl_fmin(a.y, whitgl_fmin(b.y, c.y)));
+	bounds.b.x = ceil(whitgl_fmax(a.x, whitgl_fmax(b.x, c.x)))+1;
+	bounds.b.y = ceil(whitgl_fmax(a.y, whitgl_fmax(b.y, c.y)))+1;
+	whitgl_raster_command* command = _whitgl_raster_push(WHITGL_RASTER_TRI, bounds, col);
+	if(!command)
+		return;
+	command->u.tri[0] = a;
+	command->u.tri[1] = b;
+	command->u.tri[2] = c;
+}
+
+// Two triangles, the same shape as whitgl_sys_draw_thick_line
+void whitgl_raster_draw_thick_line(whitgl_fvec a, whitgl_fvec b, whitgl_float width, whitgl_sys_color col)
+{
+	whitgl_fvec d = whitgl_fvec_sub(b, a);
+	whitgl_float len = whitgl_fvec_magnitude(d);
+	if(len == 0 || col.a == 0)
+		return;
+	whitgl_fvec side = {-d.y/len*width/2, d.x/len*width/2};
+	_whitgl_raster_draw_tri(whitgl_fvec_sub(a, side), whitgl_fvec_add(a, side), whitgl_fvec_add(b, side), col);
+	_whitgl_raster_draw_tri(whitgl_fvec_sub(a, side), whitgl_fvec_add(b, side), whitgl_fvec_sub(b, side), col);
+}
+
+void whitgl_raster_draw_fcircle(whitgl_fcircle c, whitgl_sys_color col, int tris)
+{
+	if(col.a == 0)
+		return;
+	whitgl_int i;
+	whitgl_fvec prev = whitgl_fvec_add(c.pos, whitgl_fvec_scale_val(whitgl_angle_to_fvec(0), c.size));
+	for(i=0; i<tris; i++)
+	{
+		whitgl_fvec dir = whitgl_angle_to_fvec(((whitgl_float)(i+1))/tris * whitgl_pi * 2);
+		whitgl_fvec next = whitgl_fvec_add(c.pos, whitgl_fvec_scale_val(dir, c.size));
+		_whitgl_raster_draw_tri(c.pos, next, prev, col);
+		prev = next;
+	}
+}
+
+void whitgl_raster_draw_tex_iaabb(int id, whitgl_iaabb src, whitgl_iaabb dest)
+{
+	whitgl_int index = _whitgl_raster_image_index(id);
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find raster image %d", id);
+		return;
+	}
+	// mirrored destinations sample the source backwards instead
+	if(dest.b.x < dest.a.x)
+	{
+		whitgl_int swap = dest.a.x; dest.a.x = dest.b.x; dest.b.x = swap;
+		swap = src.a.x; src.a.x = src.b.x; src.b.x = swap;
+	}
+	if(dest.b.y < dest.a.y)
+	{
+		whitgl_int swap = dest.a.y; dest.a.y = dest.b.y; dest.b.y = swap;
+		swap = src.a.y; src.a.y = src.b.y; src.b.y = swap;
+	}
+	whitgl_raster_command* command = _whitgl_raster_push(WHITGL_RASTER_TEX, dest, whitgl_sys_color_white);
+	if(!command)
+		return;
+	command->u.tex.image_index = index;
+	command->u.tex.src = src;
+	command->u.tex.dest = dest;
+}
+
+void whitgl_raster_draw_sprite(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos)
+{
+	whitgl_raster_draw_sprite_sized(sprite, frame, pos, sprite.size);
+}
+
+void whitgl_raster_draw_sprite_sized(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos, whitgl_ivec dest_size)
+{
+	whitgl_iaabb src = whitgl_iaabb_zero;
+	whitgl_ivec offset = whitgl_ivec_scale(sprite.size, frame);
+	src.a = whitgl_ivec_add(sprite.top_left, offset);
+	src.b = whitgl_ivec_add(src.a, sprite.size);
+	whitgl_iaabb dest = whitgl_iaabb_zero;
+	dest.a = pos;
+	dest.b = whitgl_ivec_add(dest.a, dest_size);
+	whitgl_raster_draw_tex_iaabb(sprite.image, src, dest);
+}
+
+void whitgl_raster_draw_text(whitgl_sprite sprite, const char* string, whitgl_ivec pos)
+{
+	whitgl_ivec draw_pos = pos;
+	while(*string)
+	{
+		int index = -1;
+		if(*string >= ' ' && *string <= '~')
+			index = *string-' ';
+		if(index != -1)
+		{
+			whitgl_ivec frame = {index%14, index/14};
+			whitgl_raster_draw_sprite(sprite, frame, draw_pos);
+			draw_pos.x += sprite.size.x;
+		}
+		string++;
+	}
+}
+
+// Matches GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on an 8 bit target, rounding
+// s*a/255 + d*(255-a)/255 to nearest
+static inline unsigned char _whitgl_raster_blend_channel(unsigned s, unsigned d, unsigned a)
+{
+	unsigned x = s*a + d*(255-a) + 128;
+	return (x + (x>>8))>>8;
+}
+
+static inline void _whitgl_raster_blend(whitgl_sys_color* d, whitgl_sys_color s)
+{
+	if(s.a == 0xff)
+	{
+		*d = s;
+		return;
+	}
+	if(s.a == 0)
+		return;
+	d->r = _whitgl_raster_blend_channel(s.r, d->r, s.a);
+	d->g = _whitgl_raster_blend_channel(s.g, d->g, s.a);
+	d->b = _whitgl_raster_blend_channel(s.b, d->b, s.a);
+	d->a = _whitgl_raster_blend_channel(s.a, d->a, s.a);
+}
+
+void _whitgl_raster_fill_span(whitgl_sys_color* d, whitgl_int count, whitgl_sys_color col)
+{
+	whitgl_int i = 0;
+	if(col.a == 0xff)
+	{
+		for(i=0; i<count; i++)
+			d[i] = col;
+		return;
+	}
+#ifdef WHITGL_RASTER_VECTOR
+	// four pixels at a time in 16 bit lanes, same arithmetic as _whitgl_raster_blend_channel
+	unsigned short inv = 255-col.a;
+	unsigned short sa[4] = {col.r*col.a, col.g*col.a, col.b*col.a, col.a*col.a};
+	whitgl_raster_u16x16 add;
+	whitgl_raster_u16x16 mul;
+	whitgl_int lane;
+	for(lane=0; lane<16; lane++)
+	{
+		add[lane] = sa[lane%4]+128;
+		mul[lane] = inv;
+	}
+	for(; i+4<=count; i+=4)
+	{
+		whitgl_raster_u8x16 pixels;
+		memcpy(&pixels, &d[i], sizeof(pixels));
+		whitgl_raster_u16x16 x = __builtin_convertvector(pixels, whitgl_raster_u16x16)*mul + add;
+		x = (x + (x>>8))>>8;
+		pixels = __builtin_convertvector(x, whitgl_raster_u8x16);
+		memcpy(&d[i], &pixels, sizeof(pixels));
+	}
+#endif
+	for(; i<count; i++)
+		_whitgl_raster_blend(&d[i], col);
+}
+
+void _whitgl_raster_run_rect(const whitgl_raster_command* command, whitgl_iaabb clip)
+{
+	whitgl_iaabb r = whitgl_iaabb_intersection(command->bounds, clip);
+	whitgl_int y;
+	for(y=r.a.y; y<r.b.y; y++)
+		_whitgl_raster_fill_span(&_raster_pixels[y*_raster_setup.size.x+r.a.x], r.b.x-r.a.x, command->col);
+}
+
+// Texel for the centre of destination pixel i, as the nearest filter picks it
+static inline whitgl_int _whitgl_raster_texel(whitgl_int i, whitgl_int src_a, whitgl_int src_b, whitgl_int dest_size, whitgl_int image_size)
+{
+	whitgl_int src_size = src_b-src_a;
+	whitgl_int t;
+	if(src_size == dest_size)
+		t = src_a+i;
+	else
+		t = floor(src_a + (i+0.5)*src_size/dest_size);
+	return whitgl_iclamp(t, 0, image_size-1);
+}
+
+void _whitgl_raster_run_tex(const whitgl_raster_command* command, whitgl_iaabb clip)
+{
+	whitgl_iaabb r = whitgl_iaabb_intersection(command->bounds, clip);
+	const whitgl_raster_image* image = &_raster_images[command->u.tex.image_index];
+	whitgl_iaabb src = command->u.tex.src;
+	whitgl_iaabb dest = command->u.tex.dest;
+	whitgl_ivec dest_size = whitgl_ivec_sub(dest.b, dest.a);
+	whitgl_int y;
+	for(y=r.a.y; y<r.b.y; y++)
+	{
+		whitgl_int ty = _whitgl_raster_texel(y-dest.a.y, src.a.y, src.b.y, dest_size.y, image->size.y);
+		const whitgl_sys_color* row = &image->data[ty*image->size.x];
+		whitgl_sys_color* out = &_raster_pixels[y*_raster_setup.size.x];
+		whitgl_int x;
+		if(src.b.x-src.a.x == dest_size.x && src.a.x+r.a.x-dest.a.x >= 0 && src.a.x+r.b.x-dest.a.x <= image->size.x)
+		{
+			const whitgl_sys_color* in = &row[src.a.x+r.a.x-dest.a.x];
+			for(x=r.a.x; x<r.b.x; x++)
+				_whitgl_raster_blend(&out[x], in[x-r.a.x]);
+		}
+		else
+		{
+			for(x=r.a.x; x<r.b.x; x++)
+				_whitgl_raster_blend(&out[x], row[_whitgl_raster_texel(x-dest.a.x, src.a.x, src.b.x, dest_size.x, image->size.x)]);
+		}
+	}
+}
+
+static inline whitgl_float _whitgl_raster_edge(whitgl_fvec a, whitgl_fvec b, whitgl_float px, whitgl_float py)
+{
+	return (b.x-a.x)*(py-a.y) - (b.y-a.y)*(px-a.x);
+}
+// Pixel centres exactly on an edge belong to only one of the two triangles
+// sharing it, as the edge runs opposite ways in each
+static inline whitgl_bool _whitgl_raster_owns_edge(whitgl_fvec a, whitgl_fvec b)
+{
+	return b.y < a.y || (b.y == a.y && b.x > a.x);
+}
+
+void _whitgl_raster_run_tri(const whitgl_raster_command* command, whitgl_iaabb clip)
+{
+	whitgl_iaabb r = whitgl_iaabb_intersection(command->bounds, clip);
+	const whitgl_fvec* v = command->u.tri;
+	whitgl_bool own[3] = {_whitgl_raster_owns_edge(v[0], v[1]), _whitgl_raster_owns_edge(v[1], v[2]), _whitgl_raster_owns_edge(v[2], v[0])};
+	whitgl_int y;
+	for(y=r.a.y; y<r.b.y; y++)
+	{
+		whitgl_float py = y+0.5;
+		whitgl_int start = -1;
+		whitgl_int x;
+		for(x=r.a.x; x<=r.b.x; x++)
+		{
+			whitgl_bool inside = false;
+			if(x < r.b.x)
+			{
+				whitgl_float px = x+0.5;
+				whitgl_float e0 = _whitgl_raster_edge(v[0], v[1], px, py);
+				whitgl_float e1 = _whitgl_raster_edge(v[1], v[2], px, py);
+				whitgl_float e2 = _whitgl_raster_edge(v[2], v[0], px, py);
+				inside = (e0 > 0 || (e0 == 0 && own[0])) && (e1 > 0 || (e1 == 0 && own[1])) && (e2 > 0 || (e2 == 0 && own[2]));
+			}
+			if(inside && start == -1)
+				start = x;
+			if(!inside && start != -1)
+			{
+				// triangles are convex, so the covered pixels form one span
+				_whitgl_raster_fill_span(&_raster_pixels[y*_raster_setup.size.x+start], x-start, command->col);
+				break;
+			}
+		}
+	}
+}
+
+void _whitgl_raster_run_line(const whitgl_raster_command* command, whitgl_iaabb clip)
+{
+	whitgl_ivec p = command->u.line.a;
+	whitgl_ivec end = command->u.line.b;
+	whitgl_int dx = end.x > p.x ? end.x-p.x : p.x-end.x;
+	whitgl_int dy = end.y > p.y ? p.y-end.y : end.y-p.y;
+	whitgl_int sx = p.x < end.x ? 1 : -1;
+	whitgl_int sy = p.y < end.y ? 1 : -1;
+	whitgl_int err = dx+dy;
+	// the last point is left out, as GL does for a lone segment
+	while(p.x != end.x || p.y != end.y)
+	{
+		if(p.x >= clip.a.x && p.x < clip.b.x && p.y >= clip.a.y && p.y < clip.b.y)
+			_whitgl_raster_blend(&_raster_pixels[p.y*_raster_setup.size.x+p.x], command->col);
+		whitgl_int e2 = 2*err;
+		if(e2 >= dy)
+		{
+			err += dy;
+			p.x += sx;
+		}
+		if(e2 <= dx)
+		{
+			err += dx;
+			p.y += sy;
+		}
+	}
+}
+
+whitgl_iaabb _whitgl_raster_tile_rect(whitgl_int tile)
+{
+	whitgl_iaabb r;
+	r.a.x = (tile%_raster_num_tiles.x)*WHITGL_RASTER_TILE;
+	r.a.y = (tile/_raster_num_tiles.x)*WHITGL_RASTER_TILE;
+	r.b.x = whitgl_imin(r.a.x+WHITGL_RASTER_TILE, _raster_setup.size.x);
+	r.b.y = whitgl_imin(r.a.y+WHITGL_RASTER_TILE, _raster_setup.size.y);
+	return r;
+}
+
+void _whitgl_raster_run_tiles()
+{
+	whitgl_int num_tiles = _raster_num_tiles.x*_raster_num_tiles.y;
+	while(true)
+	{
+		whitgl_int tile = __atomic_fetch_add(&_raster_next_tile, 1, __ATOMIC_RELAXED);
+		if(tile >= num_tiles)
+			break;
+		whitgl_iaabb clip = _whitgl_raster_tile_rect(tile);
+		whitgl_int x, y;
+		if(_raster_clear)
+			for(y=clip.a.y; y<clip.b.y; y++)
+				for(x=clip.a.x; x<clip.b.x; x++)
+					_raster_pixels[y*_raster_setup.size.x+x] = _raster_setup.clear_color;
+		whitgl_int i;
+		for(i=_raster_bin_starts[tile]; i<_raster_bin_starts[tile+1]; i++)
+		{
+			const whitgl_raster_command* command = &_raster_commands[_raster_bin_indices[i]];
+			switch(command->type)
+			{
+				case WHITGL_RASTER_RECT: _whitgl_raster_run_rect(command, clip); break;
+				case WHITGL_RASTER_TEX: _whitgl_raster_run_tex(command, clip); break;
+				case WHITGL_RASTER_TRI: _whitgl_raster_run_tri(command, clip); break;
+				case WHITGL_RASTER_LINE: _whitgl_raster_run_line(command, clip); break;
+			}
+		}
+	}
+}
+
+#ifdef WHITGL_RASTER_THREADS
+void* _whitgl_raster_worker(void* arg)
+{
+	// started at init's generation, so a draw_finish that runs first isn't missed
+	whitgl_int generation = (intptr_t)arg;
+	pthread_mutex_lock(&_raster_mutex);
+	while(true)
+	{
+		while(!_raster_quit && _raster_generation == generation)
+			pthread_cond_wait(&_raster_wake, &_raster_mutex);
+		if(_raster_quit)
+			break;
+		generation = _raster_generation;
+		pthread_mutex_unlock(&_raster_mutex);
+		_whitgl_raster_run_tiles();
+		pthread_mutex_lock(&_raster_mutex);
+		if(--_raster_busy == 0)
+			pthread_cond_signal(&_raster_idle);
+	}
+	pthread_mutex_unlock(&_raster_mutex);
+	return NULL;
+}
+#endif
+
+void _whitgl_raster_bin()
+{
+	whitgl_int num_tiles = _raster_num_tiles.x*_raster_num_tiles.y;
+	memset(_raster_bin_starts, 0, sizeof(whitgl_int)*(num_tiles+1));
+	whitgl_int i, tx, ty;
+	// count into bin_starts[tile+1], then prefix sum
+	for(i=0; i<_raster_num_commands; i++)
+	{
+		whitgl_iaabb b = _raster_commands[i].bounds;
+		for(ty=b.a.y/WHITGL_RASTER_TILE; ty<=(b.b.y-1)/WHITGL_RASTER_TILE; ty++)
+			for(tx=b.a.x/WHITGL_RASTER_TILE; tx<=(b.b.x-1)/WHITGL_RASTER_TILE; tx++)
+				_raster_bin_starts[ty*_raster_num_tiles.x+tx+1]++;
+	}
+	for(i=0; i<num_tiles; i++)
+		_raster_bin_starts[i+1] += _raster_bin_starts[i];
+	whitgl_int total = _raster_bin_starts[num_tiles];
+	if(total > _raster_max_bin_indices)
+	{
+		_raster_max_bin_indices = whitgl_imax(total, _raster_max_bin_indices*2);
+		_raster_bin_indices = realloc(_raster_bin_indices, sizeof(whitgl_int)*_raster_max_bin_indices);
+	}
+	// fill in command order, walking the starts back down as we go
+	for(i=_raster_num_commands-1; i>=0; i--)
+	{
+		whitgl_iaabb b = _raster_commands[i].bounds;
+		for(ty=b.a.y/WHITGL_RASTER_TILE; ty<=(b.b.y-1)/WHITGL_RASTER_TILE; ty++)
+			for(tx=b.a.x/WHITGL_RASTER_TILE; tx<=(b.b.x-1)/WHITGL_RASTER_TILE; tx++)
+			{
+				whitgl_int tile = ty*_raster_num_tiles.x+tx;
+				_raster_bin_indices[--_raster_bin_starts[tile+1]] = i;
+			}
+	}
+	// bin_starts[tile+1] now holds the start of tile, so shift down
+	for(i=0; i<num_tiles; i++)
+		_raster_bin_starts[i] = _raster_bin_starts[i+1];
+	_raster_bin_starts[num_tiles] = total;
+}
+
+void whitgl_raster_draw_finish()
+{
+	_whitgl_raster_bin();
+	_raster_next_tile = 0;
+#ifdef WHITGL_RASTER_THREADS
+	pthread_mutex_lock(&_raster_mutex);
+	_raster_busy = _raster_num_threads;
+	_raster_generation++;
+	pthread_cond_broadcast(&_raster_wake);
+	pthread_mutex_unlock(&_raster_mutex);
+	_whitgl_raster_run_tiles();
+	pthread_mutex_lock(&_raster_mutex);
+	while(_raster_busy > 0)
+		pthread_cond_wait(&_raster_idle, &_raster_mutex);
+	pthread_mutex_unlock(&_raster_mutex);
+#else
+	_whitgl_raster_run_tiles();
+#endif
+	_raster_num_commands = 0;
+	_raster_clear = false;
+}
+
+const whitgl_sys_color* whitgl_raster_get_pixels()
+{
+	return _raster_pixels;
+}
+
+void whitgl_raster_capture_frame_to_data(whitgl_sys_color* data)
+{
+	memcpy(data, _raster_pixels, sizeof(whitgl_sys_color)*_raster_setup.size.x*_raster_setup.size.y);
+}
@@ -0,0 +1,79 @@
+#ifndef WHITGL_SIMD_INTERNAL_H_
+#define WHITGL_SIMD_INTERNAL_H_
+
+#include <math.h>
+#include <stdint.h>
+
+#include <whitgl/math.h>
+
+// Lanes for the batch kernels in soa.c and narrowphase.c. A lane is four
+// floats with GCC/clang vector extensions, or one float with WHITGL_NO_SIMD.
+// Masks are all ones or zero per float with vectors, and 1 or 0 without, so
+// they are only combined with & and |.
+#if !defined(WHITGL_NO_SIMD) && (defined(__clang__) || defined(__GNUC__))
+#define WHITGL_SIMD_WIDTH (4)
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+typedef float whitgl_simd_lane __attribute__((vector_size(16)));
+typedef int32_t whitgl_simd_mask __attribute__((vector_size(16)));
+static inline whitgl_simd_lane _whitgl_simd_select(whitgl_simd_mask mask, whitgl_simd_lane a, whitgl_simd_lane b)
+{
+	return (whitgl_simd_lane)(((whitgl_simd_mask)a & mask) | ((whitgl_simd_mask)b & ~mask));
+}
+static inline whitgl_simd_mask _whitgl_simd_not(whitgl_simd_mask mask)
+{
+	return ~mask;
+}
+static inline whitgl_simd_lane _whitgl_simd_sqrt(whitgl_simd_lane a)
+{
+#ifdef __SSE__
+	return (whitgl_simd_lane)_mm_sqrt_ps((__m128)a);
+#else
+	whitgl_int i;
+	for(i=0; i<WHITGL_SIMD_WIDTH; i++)
+		a[i] = sqrtf(a[i]);
+	return a;
+#endif
+}
+static inline whitgl_int _whitgl_simd_count(whitgl_simd_mask mask, whitgl_int n)
+{
+	whitgl_int hits = 0;
+	whitgl_int i;
+	for(i=0; i<n; i++)
+		hits += mask[i] != 0;
+	return hits;
+}
+#else
+#define WHITGL_SIMD_WIDTH (1)
+typedef float whitgl_simd_lane;
+typedef int whitgl_simd_mask;
+static inline whitgl_simd_lane _whitgl_simd_select(whitgl_simd_mask mask, whitgl_simd_lane a, whitgl_simd_lane b)
+{
+	return mask ? a : b;
+}
+static inline whitgl_simd_mask _whitgl_simd_not(whitgl_simd_mask mask)
+{
+	return !mask;
+}
+static inline whitgl_simd_lane _whitgl_simd_sqrt(whitgl_simd_lane a)
+{
+	return sqrtf(a);
+}
+static inline whitgl_int _whitgl_simd_count(whitgl_simd_mask mask, whitgl_int n)
+{
+	(void)n;
+	return mask != 0;
+}
+#endif
+
+static inline whitgl_simd_lane _whitgl_simd_min(whitgl_simd_lane a, whitgl_simd_lane b)
+{
+	return _whitgl_simd_select(a < b, a, b);
+}
+static inline whitgl_simd_lane _whitgl_simd_max(whitgl_simd_lane a, whitgl_simd_lane b)
+{
+	return _whitgl_simd_select(a > b, a, b);
+}
+
+#endif // WHITGL_SIMD_INTERNAL_H_
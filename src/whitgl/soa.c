@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <whitgl/logging.h>
+#include <whitgl/soa.h>
+
+#include "simd_internal.h"
+
+#ifdef WHITGL_WINDOWS
+#include <malloc.h>
+#endif
+
+// Kernels work a lane at a time, see simd_internal.h. Arrays are padded to a
+// whole number of lanes, so kernels writing to a soa also fill its padding and
+// never need a scalar tail.
+
+// capacity is kept a multiple of this, which is a whole number of lanes
+#define WHITGL_SOA_PAD ((whitgl_int)(WHITGL_SOA_ALIGN/sizeof(float)))
+
+whitgl_int _whitgl_soa_lanes(whitgl_int count)
+{
+	return (count+WHITGL_SIMD_WIDTH-1)/WHITGL_SIMD_WIDTH;
+}
+
+float* _whitgl_soa_alloc(whitgl_int capacity)
+{
+	size_t bytes = capacity*sizeof(float);
+	void* out = NULL;
+#ifdef WHITGL_WINDOWS
+	out = _aligned_malloc(bytes, WHITGL_SOA_ALIGN);
+#else
+	if(posix_memalign(&out, WHITGL_SOA_ALIGN, bytes) != 0)
+		out = NULL;
+#endif
+	if(!out)
+		WHITGL_PANIC("failed to allocate soa of %d", (int)capacity);
+	memset(out, 0, bytes);
+	return out;
+}
+
+void _whitgl_soa_free(float* data)
+{
+#ifdef WHITGL_WINDOWS
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
+
+whitgl_fvec_soa whitgl_fvec_soa_create(whitgl_int capacity)
+{
+	whitgl_fvec_soa soa = whitgl_fvec_soa_zero;
+	soa.capacity = whitgl_imax(1, (capacity+WHITGL_SOA_PAD-1)/WHITGL_SOA_PAD)*WHITGL_SOA_PAD;
+	soa.x = _whitgl_soa_alloc(soa.capacity);
+	soa.y = _whitgl_soa_alloc(soa.capacity);
+	return soa;
+}
+
+void whitgl_fvec_soa_destroy(whitgl_fvec_soa* soa)
+{
+	_whitgl_soa_free(soa->x);
+	_whitgl_soa_free(soa->y);
+	*soa = whitgl_fvec_soa_zero;
+}
+
+void whitgl_fvec_soa_resize(whitgl_fvec_soa* soa, whitgl_int count)
+{
+	if(count < 0)
+		WHITGL_PANIC("invalid soa size %d", (int)count);
+	if(count > soa->capacity)
+	{
+		whitgl_fvec_soa grown = whitgl_fvec_soa_create(whitgl_imax(count, soa->capacity*2));
+		if(soa->count > 0)
+		{
+			memcpy(grown.x, soa->x, soa->count*sizeof(float));
+			memcpy(grown.y, soa->y, soa->count*sizeof(float));
+		}
+		if(soa->x)
+			whitgl_fvec_soa_destroy(soa);
+		*soa = grown;
+	} else if(count > soa->count)
+	{
+		// kernels may have left values in the padding
+		memset(&soa->x[soa->count], 0, (count-soa->count)*sizeof(float));
+		memset(&soa->y[soa->count], 0, (count-soa->count)*sizeof(float));
+	}
+	soa->count = count;
+}
+
+void whitgl_fvec_soa_push(whitgl_fvec_soa* soa, whitgl_fvec v)
+{
+	whitgl_fvec_soa_resize(soa, soa->count+1);
+	whitgl_fvec_soa_set(soa, soa->count-1, v);
+}
+
+void whitgl_fvec_soa_remove(whitgl_fvec_soa* soa, whitgl_int index)
+{
+	if(index < 0 || index >= soa->count)
+		WHITGL_PANIC("soa index %d out of range", (int)index);
+	soa->x[index] = soa->x[soa->count-1];
+	soa->y[index] = soa->y[soa->count-1];
+	whitgl_fvec_soa_resize(soa, soa->count-1);
+}
+
+whitgl_fvec whitgl_fvec_soa_get(const whitgl_fvec_soa* soa, whitgl_int index)
+{
+	whitgl_fvec out = {soa->x[index], soa->y[index]};
+	return out;
+}
+
+void whitgl_fvec_soa_set(whitgl_fvec_soa* soa, whitgl_int index, whitgl_fvec v)
+{
+	soa->x[index] = v.x;
+	soa->y[index] = v.y;
+}
+
+void whitgl_fvec_soa_from_array(whitgl_fvec_soa* soa, const whitgl_fvec* in, whitgl_int count)
+{
+	whitgl_fvec_soa_resize(soa, count);
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		soa->x[i] = in[i].x;
+		soa->y[i] = in[i].y;
+	}
+}
+
+void whitgl_fvec_soa_to_array(const whitgl_fvec_soa* soa, whitgl_fvec* out)
+{
+	whitgl_int i;
+	for(i=0; i<soa->count; i++)
+	{
+		out[i].x = soa->x[i];
+		out[i].y = soa->y[i];
+	}
+}
+
+// Sizes out to match a, checking b matches too when given
+whitgl_int _whitgl_soa_prepare(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_fvec_soa* out)
+{
+	if(b && b->count != a->count)
+		WHITGL_PANIC("soa sizes differ %d %d", (int)a->count, (int)b->count);
+	if(out != a && out != b && out->count != a->count)
+		whitgl_fvec_soa_resize(out, a->count);
+	return _whitgl_soa_lanes(a->count);
+}
+
+#define WHITGL_SOA_LANES(soa) ((whitgl_simd_lane*)(soa))
+
+void whitgl_fvec_soa_add(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, b, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* bx = WHITGL_SOA_LANES(b->x); whitgl_simd_lane* by = WHITGL_SOA_LANES(b->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i] + bx[i];
+		oy[i] = ay[i] + by[i];
+	}
+}
+
+void whitgl_fvec_soa_add_scaled(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_float s, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, b, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* bx = WHITGL_SOA_LANES(b->x); whitgl_simd_lane* by = WHITGL_SOA_LANES(b->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	float sf = s;
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i] + bx[i]*sf;
+		oy[i] = ay[i] + by[i]*sf;
+	}
+}
+
+void whitgl_fvec_soa_offset(const whitgl_fvec_soa* a, whitgl_fvec b, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, NULL, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	float bx = b.x;
+	float by = b.y;
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i] + bx;
+		oy[i] = ay[i] + by;
+	}
+}
+
+void whitgl_fvec_soa_scale(const whitgl_fvec_soa* a, const whitgl_fvec_soa* s, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, s, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* sx = WHITGL_SOA_LANES(s->x); whitgl_simd_lane* sy = WHITGL_SOA_LANES(s->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i]*sx[i];
+		oy[i] = ay[i]*sy[i];
+	}
+}
+
+void whitgl_fvec_soa_scale_val(const whitgl_fvec_soa* a, whitgl_float s, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, NULL, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	float sf = s;
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i]*sf;
+		oy[i] = ay[i]*sf;
+	}
+}
+
+void whitgl_fvec_soa_normalize(const whitgl_fvec_soa* a, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, NULL, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	whitgl_simd_lane zero = {0};
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		whitgl_simd_lane mag = _whitgl_simd_sqrt(ax[i]*ax[i] + ay[i]*ay[i]);
+		// zero length is left alone, as in whitgl_fvec_normalize
+		whitgl_simd_lane mag_1 = _whitgl_simd_select(mag == zero, zero+1, 1/mag);
+		ox[i] = ax[i]*mag_1;
+		oy[i] = ay[i]*mag_1;
+	}
+}
+
+void whitgl_fvec_soa_clamp_magnitude(const whitgl_fvec_soa* a, whitgl_float max, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, NULL, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	whitgl_simd_lane zero = {0};
+	whitgl_simd_lane max_lane = zero+(float)max;
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		whitgl_simd_lane sq = ax[i]*ax[i] + ay[i]*ay[i];
+		whitgl_simd_lane scale = _whitgl_simd_select(sq > max_lane*max_lane, max_lane/_whitgl_simd_sqrt(sq), zero+1);
+		ox[i] = ax[i]*scale;
+		oy[i] = ay[i]*scale;
+	}
+}
+
+void whitgl_fvec_soa_bound(const whitgl_fvec_soa* a, whitgl_faabb bounds, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, NULL, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	whitgl_simd_lane zero = {0};
+	whitgl_simd_lane min_x = zero+(float)whitgl_fmin(bounds.a.x, bounds.b.x);
+	whitgl_simd_lane max_x = zero+(float)whitgl_fmax(bounds.a.x, bounds.b.x);
+	whitgl_simd_lane min_y = zero+(float)whitgl_fmin(bounds.a.y, bounds.b.y);
+	whitgl_simd_lane max_y = zero+(float)whitgl_fmax(bounds.a.y, bounds.b.y);
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		whitgl_simd_lane x = _whitgl_simd_select(ax[i] < min_x, min_x, ax[i]);
+		whitgl_simd_lane y = _whitgl_simd_select(ay[i] < min_y, min_y, ay[i]);
+		ox[i] = _whitgl_simd_select(x > max_x, max_x, x);
+		oy[i] = _whitgl_simd_select(y > max_y, max_y, y);
+	}
+}
+
+void whitgl_fvec_soa_interpolate(const whitgl_fvec_soa* a, const whitgl_fvec_soa* b, whitgl_float ratio, whitgl_fvec_soa* out)
+{
+	whitgl_int lanes = _whitgl_soa_prepare(a, b, out);
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_simd_lane* bx = WHITGL_SOA_LANES(b->x); whitgl_simd_lane* by = WHITGL_SOA_LANES(b->y);
+	whitgl_simd_lane* ox = WHITGL_SOA_LANES(out->x); whitgl_simd_lane* oy = WHITGL_SOA_LANES(out->y);
+	float r = ratio;
+	float r_1 = 1-ratio;
+	whitgl_int i;
+	for(i=0; i<lanes; i++)
+	{
+		ox[i] = ax[i]*r_1 + bx[i]*r;
+		oy[i] = ay[i]*r_1 + by[i]*r;
+	}
+}
+
+// Output arrays are the caller's and unpadded, so the last partial lane is
+// done a float at a time
+void whitgl_fvec_soa_sqmagnitude(const whitgl_fvec_soa* a, float* out)
+{
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_int full = a->count/WHITGL_SIMD_WIDTH;
+	whitgl_int i;
+	for(i=0; i<full; i++)
+	{
+		whitgl_simd_lane sq = ax[i]*ax[i] + ay[i]*ay[i];
+		memcpy(&out[i*WHITGL_SIMD_WIDTH], &sq, sizeof(sq));
+	}
+	for(i=full*WHITGL_SIMD_WIDTH; i<a->count; i++)
+		out[i] = a->x[i]*a->x[i] + a->y[i]*a->y[i];
+}
+
+void whitgl_fvec_soa_magnitude(const whitgl_fvec_soa* a, float* out)
+{
+	whitgl_simd_lane* ax = WHITGL_SOA_LANES(a->x); whitgl_simd_lane* ay = WHITGL_SOA_LANES(a->y);
+	whitgl_int full = a->count/WHITGL_SIMD_WIDTH;
+	whitgl_int i;
+	for(i=0; i<full; i++)
+	{
+		whitgl_simd_lane mag = _whitgl_simd_sqrt(ax[i]*ax[i] + ay[i]*ay[i]);
+		memcpy(&out[i*WHITGL_SIMD_WIDTH], &mag, sizeof(mag));
+	}
+	for(i=full*WHITGL_SIMD_WIDTH; i<a->count; i++)
+		out[i] = sqrtf(a->x[i]*a->x[i] + a->y[i]*a->y[i]);
+}
@@ -8,6 +8,7 @@ extern "C"
 #include <whitgl/math.h>
 #include <whitgl/logging.h>
 }
+#include <whitgl/memory.h>
 #include <whitgl/sound.h>
 
 irrklang::ISoundEngine* irrklang_engine = NULL;
@@ -42,6 +43,11 @@ void whitgl_sound_shutdown()
 	if(!irrklang_engine)
 		WHITGL_PANIC("whitgl_sound_shutdown without whitgl_sound_init?");
 	irrklang_engine->drop();
+	int i;
+	for(i=0; i<num_sounds; i++)
+		whitgl_memory_release(WHITGL_MEMORY_SOUND, sounds[i].id);
+	for(i=0; i<num_loops; i++)
+		whitgl_memory_release(WHITGL_MEMORY_LOOP, loops[i].id);
 }
 void whitgl_sound_update()
 {
@@ -62,6 +68,8 @@ void whitgl_sound_add(int id, const char* filename)
 	sounds[num_sounds].id = id;
 
 	sounds[num_sounds].source = irrklang_engine->addSoundSourceFromFile(filename, irrklang::ESM_NO_STREAMING, true);
+	if(sounds[num_sounds].source)
+		whitgl_memory_set(WHITGL_MEMORY_SOUND, id, sounds[num_sounds].source->getAudioFormat().getSampleDataSize());
 	num_sounds++;
 }
 int _whitgl_get_sound_index(int id)
@@ -89,6 +97,15 @@ void whitgl_sound_play(int id, float volume, float pitch)
 	sound->setIsPaused(false);
 	sound->drop();
 }
+// Streamed loops only hold a small decode buffer, which irrKlang doesn't expose
+void _whitgl_account_loop(int id, irrklang::ISound* sound)
+{
+	if(!sound)
+		return;
+	irrklang::ISoundSource* source = sound->getSoundSource();
+	if(source && source->getStreamMode() == irrklang::ESM_NO_STREAMING)
+		whitgl_memory_set(WHITGL_MEMORY_LOOP, id, source->getAudioFormat().getSampleDataSize());
+}
 int _whitgl_get_loop_index(int id)
 {
 	int index = -1;
@@ -112,6 +129,7 @@ void whitgl_loop_add(int id, const char* filename)
 	loops[num_loops].id = id;
 
 	loops[num_loops].sound = irrklang_engine->play2D(filename, true, true);
+	_whitgl_account_loop(id, loops[num_loops].sound);
 	num_loops++;
 }
 void whitgl_loop_add_positional(int id, const char* filename)
@@ -122,6 +140,7 @@ void whitgl_loop_add_positional(int id, const char* filename)
 
 	irrklang::vec3df pos = irrklang::vec3df(0,0,0);
 	loops[num_loops].sound = irrklang_engine->play3D(filename, pos, true, true);
+	_whitgl_account_loop(id, loops[num_loops].sound);
 	num_loops++;
 }
 void whitgl_loop_volume(int id, float volume)
@@ -1,5 +1,6 @@
 #include <signal.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -8,11 +9,25 @@
 #include <GLFW/glfw3.h>
 #include <png.h>
 
+#include <whitgl/input.h>
 #include <whitgl/logging.h>
+#include <whitgl/memory.h>
 #include <whitgl/profile.h>
 #include <whitgl/sys.h>
 
-void _whitgl_sys_flush_tex_iaabb();
+void _whitgl_sys_flush_tex_iaabb(whitgl_sys_flush_reason reason);
+void _whitgl_sys_init_camera_buffers();
+
+// The shared batch holds either textured quads from one image, in the layout of
+// _whitgl_populate_vertices, or triangles with a colour per vertex.
+typedef enum
+{
+	WHITGL_BATCH_TEXTURE,
+	WHITGL_BATCH_COLOR,
+} whitgl_batch_mode;
+// Room for 768 quads, enough for a full page of debug overlay text
+#define WHITGL_BATCH_MAX_VERTICES (768*6)
+float* _whitgl_sys_batch_reserve(whitgl_batch_mode mode, whitgl_int image_index, whitgl_int num_vertices);
 
 whitgl_bool _shouldClose;
 whitgl_ivec _window_size;
@@ -36,8 +51,10 @@ typedef struct
 	GLuint vbo;
 	whitgl_int num_vertices;
 	whitgl_int max_vertices;
+	whitgl_fvec3 bounds_center;
+	whitgl_float bounds_radius;
 } whitgl_model;
-static const whitgl_model whitgl_model_zero = {-1, 0, -1, -1};
+static const whitgl_model whitgl_model_zero = {-1, 0, -1, -1, {0,0,0}, 0};
 #define WHITGL_MODEL_MAX (32)
 whitgl_model models[WHITGL_MODEL_MAX];
 whitgl_int num_models;
@@ -52,8 +69,34 @@ typedef struct
 } whitgl_framebuffer;
 #define WHITGL_FRAMEBUFFER_MAX (8)
 whitgl_framebuffer framebuffers[WHITGL_MODEL_MAX];
+// Fences for frames the GPU hasn't finished, oldest at next_frame_fence
+#define WHITGL_MAX_FRAMES_IN_FLIGHT (4)
+GLsync frame_fences[WHITGL_MAX_FRAMES_IN_FLIGHT];
+whitgl_int next_frame_fence = 0;
+// Stands in for the default framebuffer when running headless
+whitgl_framebuffer headless_target = {0, 0, 0, {0, 0}};
 whitgl_int num_framebuffers;
 
+// Tiles are grouped into square chunks, each with a static vbo that is only
+// rebuilt when one of its tiles changes.
+#define WHITGL_TILEMAP_CHUNK (16)
+typedef struct
+{
+	whitgl_int id;
+	whitgl_sprite sheet;
+	whitgl_ivec size;
+	whitgl_ivec num_chunks;
+	whitgl_int* tiles;
+	GLuint* chunk_vbos;
+	whitgl_int* chunk_vertices;
+	whitgl_bool* chunk_dirty;
+} whitgl_tilemap;
+static const whitgl_tilemap whitgl_tilemap_zero = {-1, {0,{0,0},{0,0}}, {0,0}, {0,0}, NULL, NULL, NULL, NULL};
+#define WHITGL_TILEMAP_MAX (8)
+whitgl_tilemap tilemaps[WHITGL_TILEMAP_MAX];
+whitgl_int num_tilemaps;
+float tilemap_chunk_buffer[WHITGL_TILEMAP_CHUNK*WHITGL_TILEMAP_CHUNK*6*5];
+
 const char* _vertex_src = "\
 #version 150\
 \n\
@@ -68,8 +111,11 @@ out vec3 fragmentNormal;\
 out vec3 fragmentPosition;\
 out mat4 normalMatrix;\
 uniform mat4 m_model;\
-uniform mat4 m_view;\
-uniform mat4 m_perspective;\
+layout(std140) uniform whitgl_camera\
+{\
+	mat4 m_view;\
+	mat4 m_perspective;\
+};\
 void main()\
 {\
 	gl_Position = m_perspective * m_view * m_model * vec4( position, 1.0 );\
@@ -118,6 +164,36 @@ void main()\
 }\
 ";
 
+const char* _color_vertex_src = "\
+#version 150\
+\n\
+in vec3 position;\
+in vec4 vertexColor;\
+out vec4 fragmentColor;\
+uniform mat4 m_model;\
+layout(std140) uniform whitgl_camera\
+{\
+	mat4 m_view;\
+	mat4 m_perspective;\
+};\
+void main()\
+{\
+	gl_Position = m_perspective * m_view * m_model * vec4( position, 1.0 );\
+	fragmentColor = vertexColor;\
+}\
+";
+
+const char* _color_src = "\
+#version 150\
+\n\
+in vec4 fragmentColor;\
+out vec4 outColor;\
+void main()\
+{\
+	outColor = fragmentColor;\
+}\
+";
+
 typedef union
 {
 	whitgl_float number;
@@ -127,6 +203,7 @@ typedef union
 	whitgl_int image;
 	whitgl_int framebuffer;
 	whitgl_fmat matrix;
+	whitgl_int block;
 } whitgl_uniform_data;
 
 typedef struct
@@ -134,6 +211,10 @@ typedef struct
 	GLuint program;
 	whitgl_uniform_data uniforms[WHITGL_MAX_SHADER_UNIFORMS];
 	whitgl_shader shader;
+	GLuint vertex_shader;
+	GLuint fragment_shader;
+	uint64_t hash;
+	whitgl_bool camera_block;
 } whitgl_shader_data;
 
 typedef struct
@@ -147,10 +228,67 @@ typedef struct
 } whitgl_frame_capture;
 static const whitgl_frame_capture whitgl_frame_capture_zero = {true, false, false, {'\0'}, NULL, 0};
 
+// Uniform block binding points. whitgl_camera is shared by every program that
+// declares it, user blocks from whitgl_sys_update_uniform_block follow on.
+#define WHITGL_CAMERA_BINDING (0)
+#define WHITGL_UNIFORM_BLOCK_FIRST_BINDING (1)
+
+typedef struct
+{
+	GLuint buffer;
+	whitgl_bool valid;
+	whitgl_fmat view;
+	whitgl_fmat perspective;
+} whitgl_camera_buffer;
+#define WHITGL_CAMERA_BUFFER_MAX (4)
+whitgl_camera_buffer camera_buffers[WHITGL_CAMERA_BUFFER_MAX];
+whitgl_int next_camera_buffer;
+whitgl_int bound_camera_buffer;
+
+typedef struct
+{
+	whitgl_int id;
+	GLuint buffer;
+	size_t size;
+} whitgl_uniform_block;
+#define WHITGL_UNIFORM_BLOCK_MAX (8)
+whitgl_uniform_block uniform_blocks[WHITGL_UNIFORM_BLOCK_MAX];
+whitgl_int num_uniform_blocks;
+
 GLuint vbo;
 whitgl_shader_data shaders[WHITGL_SHADER_MAX];
 whitgl_frame_capture capture;
 whitgl_bool started_drawing = false;
+whitgl_bool cpu_culling = true;
+
+// A static batch is a recording of 2D draws replayed from one vbo. Consecutive
+// vertices with the same state are merged into a single segment.
+typedef struct
+{
+	GLenum mode;
+	whitgl_shader_slot shader;
+	whitgl_int image_index;
+	whitgl_sys_color color;
+	whitgl_int first;
+	whitgl_int count;
+} whitgl_static_segment;
+typedef struct
+{
+	whitgl_int id;
+	GLuint vbo;
+	whitgl_static_segment* segments;
+	whitgl_int num_segments;
+} whitgl_static_batch;
+#define WHITGL_STATIC_BATCH_MAX (16)
+whitgl_static_batch static_batches[WHITGL_STATIC_BATCH_MAX];
+whitgl_int num_static_batches;
+whitgl_int recording_id = -1;
+float* record_vertices = NULL;
+whitgl_int record_num_vertices;
+whitgl_int record_max_vertices = 0;
+whitgl_static_segment* record_segments = NULL;
+whitgl_int record_num_segments;
+whitgl_int record_max_segments = 0;
 
 void _whitgl_check_gl_error(const char* stmt, const char *file, int line)
 {
@@ -176,6 +314,45 @@ void _whitgl_check_gl_error(const char* stmt, const char *file, int line)
 		_whitgl_check_gl_error(#stmt, __FILE__, __LINE__); \
 	} while (0)
 
+// GL calls that feed whitgl_sys_get_stats go through these
+whitgl_sys_stats frame_stats = {0, 0, {0}, 0, 0, 0, 0, 0};
+whitgl_sys_stats last_frame_stats = {0, 0, {0}, 0, 0, 0, 0, 0};
+GLuint current_program = 0;
+void _whitgl_sys_draw_arrays(GLenum mode, GLint first, GLsizei count)
+{
+	frame_stats.draw_calls++;
+	frame_stats.vertices += count;
+	GL_CHECK( glDrawArrays( mode, first, count ) );
+}
+void _whitgl_sys_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	if(data)
+		frame_stats.upload_bytes += size;
+	GL_CHECK( glBufferData( target, size, data, usage ) );
+}
+void _whitgl_sys_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	frame_stats.upload_bytes += size;
+	GL_CHECK( glBufferSubData( target, offset, size, data ) );
+}
+void _whitgl_sys_use_program(GLuint program)
+{
+	if(program == current_program)
+		return;
+	frame_stats.program_switches++;
+	current_program = program;
+	GL_CHECK( glUseProgram( program ) );
+}
+void whitgl_sys_invalidate_gl_state()
+{
+	current_program = 0;
+}
+void _whitgl_sys_bind_framebuffer(GLuint buffer)
+{
+	frame_stats.framebuffer_binds++;
+	GL_CHECK( glBindFramebuffer( GL_FRAMEBUFFER, buffer ) );
+}
+
 
 void _whitgl_sys_handle_signal(int signal);
 void _whitgl_sys_close_callback(GLFWwindow*);
@@ -197,56 +374,227 @@ void whitgl_sys_set_clear_color(whitgl_sys_color col)
 	glClearColor(r, g, b, a);
 }
 
-bool whitgl_change_shader(whitgl_shader_slot type, whitgl_shader shader)
+uint64_t _whitgl_shader_hash(const char* vertex_src, const char* fragment_src)
+{
+	// FNV-1a over both sources and the driver strings, so a driver update invalidates the cache
+	const char* parts[5];
+	parts[0] = vertex_src;
+	parts[1] = fragment_src;
+	parts[2] = (const char*)glGetString(GL_VENDOR);
+	parts[3] = (const char*)glGetString(GL_RENDERER);
+	parts[4] = (const char*)glGetString(GL_VERSION);
+	uint64_t hash = 14695981039346656037ULL;
+	whitgl_int i;
+	for(i=0; i<5; i++)
+	{
+		const char* c = parts[i] ? parts[i] : "";
+		while(*c)
+		{
+			hash ^= (unsigned char)*c++;
+			hash *= 1099511628211ULL;
+		}
+		hash ^= 0xff; // separator, so "ab"+"c" and "a"+"bc" differ
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+whitgl_bool _whitgl_shader_cache_available()
+{
+	return _setup.shader_cache_dir != NULL && GLEW_ARB_get_program_binary;
+}
+
+void _whitgl_shader_cache_filename(char* buffer, size_t size, uint64_t hash)
 {
-	if(type >= WHITGL_SHADER_MAX)
+	snprintf(buffer, size, "%s/%016llx.shader", _setup.shader_cache_dir, (unsigned long long)hash);
+}
+
+whitgl_bool _whitgl_shader_cache_load(GLuint program, uint64_t hash)
+{
+	if(!_whitgl_shader_cache_available())
+		return false;
+	char filename[PATH_MAX];
+	_whitgl_shader_cache_filename(filename, sizeof(filename), hash);
+	FILE* src = fopen(filename, "rb");
+	if(src == NULL)
+		return false;
+	GLenum format;
+	GLint length;
+	whitgl_bool ok = fread(&format, 1, sizeof(format), src) == sizeof(format);
+	ok = ok && fread(&length, 1, sizeof(length), src) == sizeof(length);
+	ok = ok && length > 0;
+	void* binary = ok ? malloc(length) : NULL;
+	ok = ok && binary && fread(binary, 1, length, src) == (size_t)length;
+	fclose(src);
+	GLint status = GL_FALSE;
+	if(ok)
+	{
+		glProgramBinary(program, format, binary, length);
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+	}
+	free(binary);
+	if(status != GL_TRUE)
 	{
-		WHITGL_PANIC("Invalid shader type %d", type);
+		WHITGL_LOG("Discarding stale shader cache %s", filename);
+		glGetError(); // a rejected binary is expected after driver changes, don't report it
 		return false;
 	}
+	return true;
+}
+
+void _whitgl_shader_cache_save(GLuint program, uint64_t hash)
+{
+	if(!_whitgl_shader_cache_available())
+		return;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+	void* binary = malloc(length);
+	GLenum format;
+	glGetProgramBinary(program, length, NULL, &format, binary);
+	char filename[PATH_MAX];
+	_whitgl_shader_cache_filename(filename, sizeof(filename), hash);
+	FILE* dest = fopen(filename, "wb");
+	if(dest == NULL)
+	{
+		WHITGL_LOG("Failed to open %s for shader cache.", filename);
+		free(binary);
+		return;
+	}
+	whitgl_bool ok = fwrite(&format, 1, sizeof(format), dest) == sizeof(format);
+	ok = ok && fwrite(&length, 1, sizeof(length), dest) == sizeof(length);
+	ok = ok && fwrite(binary, 1, length, dest) == (size_t)length;
+	fclose(dest);
+	free(binary);
+	if(!ok)
+	{
+		WHITGL_LOG("Failed to write shader cache %s", filename);
+		remove(filename);
+	}
+}
+
+void _whitgl_shader_bind_camera_block(whitgl_shader_slot type)
+{
+	GLuint index = glGetUniformBlockIndex(shaders[type].program, "whitgl_camera");
+	shaders[type].camera_block = index != GL_INVALID_INDEX;
+	if(shaders[type].camera_block)
+		glUniformBlockBinding(shaders[type].program, index, WHITGL_CAMERA_BINDING);
+}
+
+// Issues the compile and link for a slot without querying any status, so that
+// several programs can be in flight in the driver at once.
+void _whitgl_shader_begin_compile(whitgl_shader_slot type, whitgl_shader shader)
+{
 	shaders[type].shader = shader;
 
 	if(shader.vertex_src == NULL)
-		shader.vertex_src = _vertex_src;
+		shader.vertex_src = type == WHITGL_SHADER_COLOR ? _color_vertex_src : _vertex_src;
 	if(shader.fragment_src == NULL)
-		shader.fragment_src = _fragment_src;
+		shader.fragment_src = type == WHITGL_SHADER_COLOR ? _color_src : _fragment_src;
 
 	if(glIsProgram(shaders[type].program))
+	{
+		if(current_program == shaders[type].program)
+			current_program = 0; // the name may come back from glCreateProgram
 		glDeleteProgram(shaders[type].program);
+	}
+
+	shaders[type].program = glCreateProgram();
+	shaders[type].vertex_shader = 0;
+	shaders[type].fragment_shader = 0;
+	shaders[type].hash = _whitgl_shader_hash(shader.vertex_src, shader.fragment_src);
+	if(_whitgl_shader_cache_load(shaders[type].program, shaders[type].hash))
+		return;
+
+	shaders[type].vertex_shader = glCreateShader( GL_VERTEX_SHADER );
+	glShaderSource( shaders[type].vertex_shader, 1, &shader.vertex_src, NULL );
+	glCompileShader( shaders[type].vertex_shader );
+
+	shaders[type].fragment_shader = glCreateShader( GL_FRAGMENT_SHADER );
+	glShaderSource( shaders[type].fragment_shader, 1, &shader.fragment_src, NULL );
+	glCompileShader( shaders[type].fragment_shader );
+
+	glAttachShader( shaders[type].program, shaders[type].vertex_shader );
+	glAttachShader( shaders[type].program, shaders[type].fragment_shader );
+	glBindFragDataLocation( shaders[type].program, 0, "outColor" );
+	if(_whitgl_shader_cache_available())
+		glProgramParameteri( shaders[type].program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	glLinkProgram( shaders[type].program );
+}
+
+bool _whitgl_shader_finish_compile(whitgl_shader_slot type)
+{
+	GLuint vertexShader = shaders[type].vertex_shader;
+	GLuint fragmentShader = shaders[type].fragment_shader;
+	if(vertexShader == 0)
+	{
+		_whitgl_shader_bind_camera_block(type); // loaded from the cache
+		return true;
+	}
+	shaders[type].vertex_shader = 0;
+	shaders[type].fragment_shader = 0;
 
-	GLuint vertexShader = glCreateShader( GL_VERTEX_SHADER );
-	glShaderSource( vertexShader, 1, &shader.vertex_src, NULL );
-	glCompileShader( vertexShader );
+	bool result = true;
 	GLint status;
+	char buffer[512];
 	glGetShaderiv( vertexShader, GL_COMPILE_STATUS, &status );
 	if(status != GL_TRUE)
 	{
-		char buffer[512];
 		glGetShaderInfoLog( vertexShader, 512, NULL, buffer );
 		WHITGL_PANIC(buffer);
-		return false;
+		result = false;
 	}
-
-	GLuint fragmentShader = glCreateShader( GL_FRAGMENT_SHADER );
-	glShaderSource( fragmentShader, 1, &shader.fragment_src, NULL );
-	glCompileShader( fragmentShader );
-
 	glGetShaderiv( fragmentShader, GL_COMPILE_STATUS, &status );
-	if(status != GL_TRUE)
+	if(result && status != GL_TRUE)
 	{
-		char buffer[512];
 		glGetShaderInfoLog( fragmentShader, 512, NULL, buffer );
 		WHITGL_PANIC(buffer);
-		return false;
+		result = false;
+	}
+	glGetProgramiv( shaders[type].program, GL_LINK_STATUS, &status );
+	if(result && status != GL_TRUE)
+	{
+		glGetProgramInfoLog( shaders[type].program, 512, NULL, buffer );
+		WHITGL_PANIC(buffer);
+		result = false;
+	}
+	if(result)
+	{
+		_whitgl_shader_cache_save(shaders[type].program, shaders[type].hash);
+		_whitgl_shader_bind_camera_block(type);
 	}
 
-	shaders[type].program = glCreateProgram();
-	glAttachShader( shaders[type].program, vertexShader );
-	glAttachShader( shaders[type].program, fragmentShader );
-	glBindFragDataLocation( shaders[type].program, 0, "outColor" );
-	glLinkProgram( shaders[type].program );
+	glDetachShader( shaders[type].program, vertexShader );
+	glDetachShader( shaders[type].program, fragmentShader );
+	glDeleteShader( vertexShader );
+	glDeleteShader( fragmentShader );
+	return result;
+}
 
-	return true;
+bool whitgl_change_shader(whitgl_shader_slot type, whitgl_shader shader)
+{
+	return whitgl_change_shaders(1, &type, &shader);
+}
+
+bool whitgl_change_shaders(whitgl_int count, const whitgl_shader_slot* types, const whitgl_shader* shader_list)
+{
+	whitgl_int i;
+	for(i=0; i<count; i++)
+	{
+		if(types[i] >= WHITGL_SHADER_MAX)
+		{
+			WHITGL_PANIC("Invalid shader type %d", types[i]);
+			return false;
+		}
+	}
+	for(i=0; i<count; i++)
+		_whitgl_shader_begin_compile(types[i], shader_list[i]);
+	bool result = true;
+	for(i=0; i<count; i++)
+		if(!_whitgl_shader_finish_compile(types[i]))
+			result = false;
+	return result;
 }
 
 void _whitgl_check_uniform_validity(whitgl_shader_slot slot, whitgl_int uniform, whitgl_uniform_type type)
@@ -263,7 +611,7 @@ void whitgl_set_shader_float(whitgl_shader_slot type, whitgl_int uniform, float
 {
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_FLOAT);
 	if(shaders[type].uniforms[uniform].number != value)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].number = value;
 }
 void whitgl_set_shader_fvec(whitgl_shader_slot type, whitgl_int uniform, whitgl_fvec value)
@@ -271,7 +619,7 @@ void whitgl_set_shader_fvec(whitgl_shader_slot type, whitgl_int uniform, whitgl_
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_FVEC);
 	whitgl_fvec existing = shaders[type].uniforms[uniform].fvec;
 	if(existing.x != value.x || existing.y != value.y)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].fvec = value;
 }
 void whitgl_set_shader_fvec3(whitgl_shader_slot type, whitgl_int uniform, whitgl_fvec3 value)
@@ -279,7 +627,7 @@ void whitgl_set_shader_fvec3(whitgl_shader_slot type, whitgl_int uniform, whitgl
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_FVEC3);
 	whitgl_fvec3 existing = shaders[type].uniforms[uniform].fvec3;
 	if(existing.x != value.x || existing.y != value.y || existing.z != value.z)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].fvec3 = value;
 }
 void whitgl_set_shader_color(whitgl_shader_slot type, whitgl_int uniform, whitgl_sys_color value)
@@ -290,30 +638,71 @@ void whitgl_set_shader_color(whitgl_shader_slot type, whitgl_int uniform, whitgl
 	   existing.g != value.g ||
 	   existing.b != value.b ||
 	   existing.a != value.a)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].color = value;
 }
 void whitgl_set_shader_image(whitgl_shader_slot type, whitgl_int uniform, whitgl_int index)
 {
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_IMAGE);
 	if(shaders[type].uniforms[uniform].image != index)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].image = index;
 }
 void whitgl_set_shader_framebuffer(whitgl_shader_slot type, whitgl_int uniform, whitgl_int index)
 {
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_FRAMEBUFFER);
 	if(shaders[type].uniforms[uniform].framebuffer != index)
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].framebuffer = index;
 }
 void whitgl_set_shader_matrix(whitgl_shader_slot type, whitgl_int uniform, whitgl_fmat fmat)
 {
 	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_MATRIX);
 	if(!whitgl_fmat_eq(shaders[type].uniforms[uniform].matrix, fmat))
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
 	shaders[type].uniforms[uniform].matrix = fmat;
 };
+void whitgl_set_shader_block(whitgl_shader_slot type, whitgl_int uniform, whitgl_int id)
+{
+	_whitgl_check_uniform_validity(type, uniform, WHITGL_UNIFORM_BLOCK);
+	if(shaders[type].uniforms[uniform].block != id)
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
+	shaders[type].uniforms[uniform].block = id;
+}
+
+void whitgl_sys_update_uniform_block(whitgl_int id, size_t size, const void* data)
+{
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_UNIFORM);
+	int index = -1;
+	int i;
+	for(i=0; i<num_uniform_blocks; i++)
+	{
+		if(uniform_blocks[i].id == id)
+		{
+			index = i;
+			break;
+		}
+	}
+	if(index == -1)
+	{
+		if(num_uniform_blocks >= WHITGL_UNIFORM_BLOCK_MAX)
+		{
+			WHITGL_PANIC("ERR Too many uniform blocks");
+			return;
+		}
+		index = num_uniform_blocks++;
+		uniform_blocks[index].id = id;
+		uniform_blocks[index].size = 0;
+		GL_CHECK( glGenBuffers(1, &uniform_blocks[index].buffer) );
+		GL_CHECK( glBindBufferBase(GL_UNIFORM_BUFFER, WHITGL_UNIFORM_BLOCK_FIRST_BINDING+index, uniform_blocks[index].buffer) );
+	}
+	GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, uniform_blocks[index].buffer) );
+	if(uniform_blocks[index].size != size)
+		_whitgl_sys_buffer_data( GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW );
+	else
+		_whitgl_sys_buffer_sub_data(GL_UNIFORM_BUFFER, 0, size, data);
+	uniform_blocks[index].size = size;
+}
 
 void whitgl_resize_framebuffer(whitgl_int i, whitgl_ivec size, whitgl_bool one_color)
 {
@@ -329,7 +718,7 @@ void whitgl_resize_framebuffer(whitgl_int i, whitgl_ivec size, whitgl_bool one_c
 	WHITGL_LOG("Creating framebuffer %d", i);
 	// The framebuffer, which regroups 0, 1, or more textures, and 0 or 1 depth buffer.
 	GL_CHECK( glGenFramebuffers(1, &framebuffers[i].buffer) );
-	GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i].buffer) );
+	_whitgl_sys_bind_framebuffer(framebuffers[i].buffer);
 	GL_CHECK( glGenTextures(1, &framebuffers[i].texture) );
 	GL_CHECK( glBindTexture(GL_TEXTURE_2D, framebuffers[i].texture) );
 	if(one_color)
@@ -353,8 +742,9 @@ void whitgl_resize_framebuffer(whitgl_int i, whitgl_ivec size, whitgl_bool one_c
 	GL_CHECK( glDrawBuffers(1, drawBuffers) ); // "1" is the size of drawBuffers
 	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		WHITGL_LOG("Problem setting up intermediate render target");
-	GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+	_whitgl_sys_bind_framebuffer(0);
 	framebuffers[i].size = size;
+	whitgl_memory_set(WHITGL_MEMORY_FRAMEBUFFER, i, (int64_t)size.x*size.y*(one_color ? 1 : 8));
 }
 
 void _whitgl_calculate_setup_size(whitgl_sys_setup* setup, whitgl_ivec screen_size)
@@ -412,6 +802,17 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 	if(setup->start_hidden)
 		glfwInitHint(GLFW_COCOA_MENUBAR, false);
 #endif
+	if(setup->headless)
+	{
+		setup->fullscreen = false;
+		setup->start_hidden = true;
+#ifdef GLFW_PLATFORM_NULL
+		WHITGL_LOG("Using the null platform for headless rendering");
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+		WHITGL_LOG("GLFW has no null platform, headless will use a hidden window");
+#endif
+	}
 
 	WHITGL_LOG("glfwInit");
 	result = glfwInit();
@@ -435,15 +836,41 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 	if(setup->start_hidden)
 		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
-	const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	const GLFWvidmode * mode = NULL;
+	if(glfwGetPrimaryMonitor())
+		mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
 
 	// attempt to ensure that no mode changing takes place
-	glfwWindowHint(GLFW_RED_BITS, mode->redBits);
-	glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
-	glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
-	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
+	if(mode && !setup->headless)
+	{
+		glfwWindowHint(GLFW_RED_BITS, mode->redBits);
+		glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
+		glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
+		glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
+	}
 
-	if(setup->fullscreen)
+	if(setup->headless)
+	{
+		whitgl_ivec window_size;
+		window_size.x = setup->size.x*setup->pixel_size;
+		window_size.y = setup->size.y*setup->pixel_size;
+		WHITGL_LOG("Opening headless w%d h%d", window_size.x, window_size.y);
+#ifdef GLFW_EGL_CONTEXT_API
+		// EGL can make a surfaceless context, OSMesa covers boxes with no GPU driver at all
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		_window = glfwCreateWindow(window_size.x, window_size.y, setup->name, NULL, NULL);
+#endif
+#ifdef GLFW_OSMESA_CONTEXT_API
+		if(!_window)
+		{
+			WHITGL_LOG("EGL context failed, trying OSMesa");
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+			_window = glfwCreateWindow(window_size.x, window_size.y, setup->name, NULL, NULL);
+		}
+#endif
+		if(!_window)
+			_window = glfwCreateWindow(window_size.x, window_size.y, setup->name, NULL, NULL);
+	} else if(setup->fullscreen && mode)
 	{
 		WHITGL_LOG("Opening fullscreen w%d h%d", mode->width, mode->height);
 		_window = glfwCreateWindow(mode->width, mode->height, setup->name, glfwGetPrimaryMonitor(), NULL);
@@ -492,22 +919,28 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 	glGenVertexArrays(1, &VertexArrayID);
 	glBindVertexArray(VertexArrayID);
 
+	_setup = *setup; // the shader cache reads its directory from here
+
+	_whitgl_sys_init_camera_buffers();
+	num_uniform_blocks = 0;
+
 	WHITGL_LOG("Loading shaders");
+#ifdef GL_KHR_parallel_shader_compile
+	if(GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+#endif
 	whitgl_shader flat_shader = whitgl_shader_zero;
 	flat_shader.fragment_src = _flat_src;
 	flat_shader.num_uniforms = 1;
 	flat_shader.uniforms[0].type = WHITGL_UNIFORM_COLOR;
 	flat_shader.uniforms[0].name = "color";
-	if(!whitgl_change_shader( WHITGL_SHADER_FLAT, flat_shader))
-		return false;
 	whitgl_shader texture_shader = whitgl_shader_zero;
-	if(!whitgl_change_shader( WHITGL_SHADER_TEXTURE, texture_shader))
-		return false;
-	if(!whitgl_change_shader( WHITGL_SHADER_POST, texture_shader))
-		return false;
 	whitgl_shader model_shader = whitgl_shader_zero;
 	model_shader.fragment_src = _model_src;
-	if(!whitgl_change_shader( WHITGL_SHADER_MODEL, model_shader))
+	whitgl_shader color_shader = whitgl_shader_zero;
+	whitgl_shader_slot builtin_slots[] = {WHITGL_SHADER_FLAT, WHITGL_SHADER_TEXTURE, WHITGL_SHADER_POST, WHITGL_SHADER_MODEL, WHITGL_SHADER_COLOR};
+	whitgl_shader builtin_shaders[] = {flat_shader, texture_shader, texture_shader, model_shader, color_shader};
+	if(!whitgl_change_shaders(5, builtin_slots, builtin_shaders))
 		return false;
 
 	WHITGL_LOG("Creating framebuffers");
@@ -520,7 +953,7 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 		WHITGL_LOG("Creating framebuffer %d", i);
 		// The framebuffer, which regroups 0, 1, or more textures, and 0 or 1 depth buffer.
 		GL_CHECK( glGenFramebuffers(1, &framebuffers[i].buffer) );
-		GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i].buffer) );
+		_whitgl_sys_bind_framebuffer(framebuffers[i].buffer);
 		GL_CHECK( glGenTextures(1, &framebuffers[i].texture) );
 		GL_CHECK( glBindTexture(GL_TEXTURE_2D, framebuffers[i].texture) );
 		GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, setup->size.x, setup->size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0) );
@@ -538,11 +971,16 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 		GL_CHECK( glDrawBuffers(1, drawBuffers) ); // "1" is the size of drawBuffers
 		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			WHITGL_LOG("Problem setting up intermediate render target");
-		GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+		_whitgl_sys_bind_framebuffer(0);
 		framebuffers[i].size = setup->size;
+		// RGBA colour and a depth buffer most drivers pad to 32 bits
+		whitgl_memory_set(WHITGL_MEMORY_FRAMEBUFFER, i, (int64_t)setup->size.x*setup->size.y*8);
 	}
 
-	if(setup->vsync)
+	if(setup->headless)
+	{
+		WHITGL_LOG("Headless, no vsync");
+	} else if(setup->vsync)
 	{
 		WHITGL_LOG("Enabling vsync");
 		GL_CHECK( glfwSwapInterval(1) ); // some cards still wont vsync!
@@ -581,6 +1019,11 @@ bool whitgl_sys_init(whitgl_sys_setup* setup)
 	for(i=0; i<WHITGL_MODEL_MAX; i++)
 		models[i] = whitgl_model_zero;
 	num_models = 0;
+	for(i=0; i<WHITGL_TILEMAP_MAX; i++)
+		tilemaps[i] = whitgl_tilemap_zero;
+	num_tilemaps = 0;
+	num_static_batches = 0;
+	recording_id = -1;
 
 	_setup = *setup;
 	_setup_pointer = setup;
@@ -640,8 +1083,45 @@ bool whitgl_sys_should_close()
 	return _shouldClose;
 }
 
+// Offscreen colour target the size of the window, recreated when that changes
+GLuint _whitgl_sys_present_buffer()
+{
+	if(!_setup.headless)
+		return 0;
+	if(headless_target.buffer != 0 && whitgl_ivec_eq(headless_target.size, _window_size))
+		return headless_target.buffer;
+	if(headless_target.buffer != 0)
+	{
+		GL_CHECK( glDeleteTextures(1, &headless_target.texture) );
+		GL_CHECK( glDeleteFramebuffers(1, &headless_target.buffer) );
+	}
+	WHITGL_LOG("Creating headless present target %d %d", (int)_window_size.x, (int)_window_size.y);
+	GL_CHECK( glGenFramebuffers(1, &headless_target.buffer) );
+	_whitgl_sys_bind_framebuffer(headless_target.buffer);
+	GL_CHECK( glGenTextures(1, &headless_target.texture) );
+	GL_CHECK( glBindTexture(GL_TEXTURE_2D, headless_target.texture) );
+	GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _window_size.x, _window_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0) );
+	GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
+	GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+	GL_CHECK( glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, headless_target.texture, 0) );
+	GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+	GL_CHECK( glDrawBuffers(1, drawBuffers) );
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		WHITGL_LOG("Problem setting up headless render target");
+	headless_target.size = _window_size;
+	whitgl_memory_set(WHITGL_MEMORY_FRAMEBUFFER, -1, (int64_t)_window_size.x*_window_size.y*4);
+	return headless_target.buffer;
+}
+
 void whitgl_sys_close()
 {
+	if(headless_target.buffer != 0)
+	{
+		GL_CHECK( glDeleteTextures(1, &headless_target.texture) );
+		GL_CHECK( glDeleteFramebuffers(1, &headless_target.buffer) );
+		headless_target.buffer = 0;
+		whitgl_memory_release(WHITGL_MEMORY_FRAMEBUFFER, -1);
+	}
 	whitgl_profile_shutdown();
 	glfwTerminate();
 }
@@ -657,7 +1137,7 @@ void whitgl_sys_draw_init(whitgl_int framebuffer_id)
 		WHITGL_PANIC("invalid framebuffer, have you assigned enough");
 	if(started_drawing)
 	{
-		_whitgl_sys_flush_tex_iaabb();
+		_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_FRAME);
 	}
 	int w, h;
 	glfwGetFramebufferSize(_window, &w, &h);
@@ -665,7 +1145,7 @@ void whitgl_sys_draw_init(whitgl_int framebuffer_id)
 	_window_size.y = h;
 	GL_CHECK( glEnable(GL_BLEND) );
 	GL_CHECK( glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) );
-	GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[framebuffer_id].buffer) );
+	_whitgl_sys_bind_framebuffer(framebuffers[framebuffer_id].buffer);
 	_buffer_size = framebuffers[framebuffer_id].size;
 
 	GL_CHECK( glViewport( 0, 0, _buffer_size.x, _buffer_size.y ) );
@@ -674,32 +1154,99 @@ void whitgl_sys_draw_init(whitgl_int framebuffer_id)
 
 	if(!started_drawing)
 	{
+		if(_setup.late_input_sampling)
+		{
+			glfwPollEvents();
+			whitgl_input_update_cursor();
+		}
 		whitgl_profile_start_drawing();
 		started_drawing = true;
+		// user code may have used GL directly since the last frame
+		whitgl_sys_invalidate_gl_state();
 	}
 }
 
+// Two textured triangles from (ax,ay) to (bx,by), sf is the source in texture coordinates
+void _whitgl_sys_write_quad(float* vertices, float ax, float ay, float bx, float by, whitgl_faabb sf)
+{
+	whitgl_int i = 0;
+	vertices[i++] = ax; vertices[i++] = by; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.b.y;
+	vertices[i++] = bx; vertices[i++] = ay; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.a.y;
+	vertices[i++] = ax; vertices[i++] = ay; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.a.y;
+
+	vertices[i++] = ax; vertices[i++] = by; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.b.y;
+	vertices[i++] = bx; vertices[i++] = by; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.b.y;
+	vertices[i++] = bx; vertices[i++] = ay; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.a.y;
+}
+
 void _whitgl_populate_vertices(float* vertices, whitgl_iaabb s, whitgl_iaabb d, whitgl_ivec image_size)
 {
 	// cpu optimisation for "whitgl_faabb sf = whitgl_faabb_divide(whitgl_iaabb_to_faabb(s), whitgl_ivec_to_fvec(image_size));"
 	whitgl_faabb sf = {{((float)s.a.x)/((float)image_size.x),((float)s.a.y)/((float)image_size.y)},
                        {((float)s.b.x)/((float)image_size.x),((float)s.b.y)/((float)image_size.y)}};
-	whitgl_int i = 0;
-	vertices[i++] = d.a.x; vertices[i++] = d.b.y; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.b.y;
-	vertices[i++] = d.b.x; vertices[i++] = d.a.y; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.a.y;
-	vertices[i++] = d.a.x; vertices[i++] = d.a.y; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.a.y;
+	_whitgl_sys_write_quad(vertices, d.a.x, d.a.y, d.b.x, d.b.y, sf);
+}
+
+void _whitgl_sys_init_camera_buffers()
+{
+	whitgl_int i;
+	for(i=0; i<WHITGL_CAMERA_BUFFER_MAX; i++)
+	{
+		GL_CHECK( glGenBuffers(1, &camera_buffers[i].buffer) );
+		GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, camera_buffers[i].buffer) );
+		_whitgl_sys_buffer_data( GL_UNIFORM_BUFFER, sizeof(whitgl_fmat)*2, NULL, GL_DYNAMIC_DRAW );
+		camera_buffers[i].valid = false;
+	}
+	next_camera_buffer = 0;
+	bound_camera_buffer = -1;
+}
 
-	vertices[i++] = d.a.x; vertices[i++] = d.b.y; vertices[i++] = 1; vertices[i++] = sf.a.x; vertices[i++] = sf.b.y;
-	vertices[i++] = d.b.x; vertices[i++] = d.b.y; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.b.y;
-	vertices[i++] = d.b.x; vertices[i++] = d.a.y; vertices[i++] = 1; vertices[i++] = sf.b.x; vertices[i++] = sf.a.y;
+// Programs with a whitgl_camera block share a small set of uniform buffers, one
+// per distinct view/perspective pair seen recently, so switching between the
+// 2D and 3D cameras within a frame rebinds a buffer instead of re-uploading.
+void _whitgl_sys_set_camera(whitgl_shader_slot slot, whitgl_fmat view, whitgl_fmat perspective)
+{
+	GLuint program = shaders[slot].program;
+	if(!shaders[slot].camera_block)
+	{
+		glUniformMatrix4fv( glGetUniformLocation( program, "m_view"), 1, GL_FALSE, view.mat);
+		glUniformMatrix4fv( glGetUniformLocation( program, "m_perspective"), 1, GL_FALSE, perspective.mat);
+		return;
+	}
+	whitgl_int index = -1;
+	whitgl_int i;
+	for(i=0; i<WHITGL_CAMERA_BUFFER_MAX; i++)
+	{
+		if(camera_buffers[i].valid && whitgl_fmat_eq(camera_buffers[i].view, view) && whitgl_fmat_eq(camera_buffers[i].perspective, perspective))
+		{
+			index = i;
+			break;
+		}
+	}
+	if(index == -1)
+	{
+		index = next_camera_buffer;
+		next_camera_buffer = (next_camera_buffer+1)%WHITGL_CAMERA_BUFFER_MAX;
+		camera_buffers[index].valid = true;
+		camera_buffers[index].view = view;
+		camera_buffers[index].perspective = perspective;
+		GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, camera_buffers[index].buffer) );
+		_whitgl_sys_buffer_sub_data(GL_UNIFORM_BUFFER, 0, sizeof(whitgl_fmat), view.mat);
+		_whitgl_sys_buffer_sub_data(GL_UNIFORM_BUFFER, sizeof(whitgl_fmat), sizeof(whitgl_fmat), perspective.mat);
+		bound_camera_buffer = -1;
+	}
+	if(index != bound_camera_buffer)
+	{
+		GL_CHECK( glBindBufferBase(GL_UNIFORM_BUFFER, WHITGL_CAMERA_BINDING, camera_buffers[index].buffer) );
+		bound_camera_buffer = index;
+	}
 }
 
-void _whitgl_sys_orthographic(GLuint program, float left, float right, float top, float bottom)
+void _whitgl_sys_orthographic(whitgl_shader_slot slot, float left, float right, float top, float bottom)
 {
 	whitgl_fmat m = whitgl_fmat_orthographic(left, right, top, bottom, 0, 100);
-	glUniformMatrix4fv( glGetUniformLocation( program, "m_model"), 1, GL_FALSE, whitgl_fmat_identity.mat);
-	glUniformMatrix4fv( glGetUniformLocation( program, "m_view"), 1, GL_FALSE, whitgl_fmat_identity.mat);
-	glUniformMatrix4fv( glGetUniformLocation( program, "m_perspective"), 1, GL_FALSE, m.mat);
+	glUniformMatrix4fv( glGetUniformLocation( shaders[slot].program, "m_model"), 1, GL_FALSE, whitgl_fmat_identity.mat);
+	_whitgl_sys_set_camera(slot, whitgl_fmat_identity, m);
 	GL_CHECK( return );
 }
 
@@ -778,6 +1325,28 @@ void _whitgl_load_uniforms(whitgl_shader_slot slot)
 				glUniformMatrix4fv(location, 1, GL_FALSE, converted);
 				break;
 			}
+			case WHITGL_UNIFORM_BLOCK:
+			{
+				whitgl_int id = shaders[slot].uniforms[i].block;
+				int index = -1;
+				int j;
+				for(j=0; j<num_uniform_blocks; j++)
+				{
+					if(uniform_blocks[j].id == id)
+					{
+						index = j;
+						break;
+					}
+				}
+				if(index == -1)
+				{
+					WHITGL_PANIC("ERR Cannot find uniform block %d", id);
+					return;
+				}
+				GLuint block_index = glGetUniformBlockIndex(shaders[slot].program, shaders[slot].shader.uniforms[i].name);
+				glUniformBlockBinding(shaders[slot].program, block_index, WHITGL_UNIFORM_BLOCK_FIRST_BINDING+index);
+				break;
+			}
 		}
 	}
 	// for(i=0; i<shaders[slot].shader.num_matrices; i++)
@@ -794,14 +1363,14 @@ void _whitgl_load_uniforms(whitgl_shader_slot slot)
 
 void whitgl_sys_draw_finish()
 {
-	_whitgl_sys_flush_tex_iaabb();
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_FRAME);
 
 	if(capture.do_next && (capture.pre_postprocess || capture.frame_buffer != 0))
 	{
 		whitgl_ivec capture_size = _buffer_size;
 		if(capture.frame_buffer != 0)
 		{
-			GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[capture.frame_buffer].buffer) );
+			_whitgl_sys_bind_framebuffer(framebuffers[capture.frame_buffer].buffer);
 			capture_size = framebuffers[capture.frame_buffer].size;
 		}
 		unsigned char* flipped_buffer = malloc(capture_size.x*capture_size.y*4);
@@ -822,7 +1391,7 @@ void whitgl_sys_draw_finish()
 		capture.do_next = false;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	_whitgl_sys_bind_framebuffer(_whitgl_sys_present_buffer());
 
 	GL_CHECK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
 	GL_CHECK( glViewport( 0, 0, _window_size.x, _window_size.y ) );
@@ -849,13 +1418,13 @@ void whitgl_sys_draw_finish()
 
 	_whitgl_populate_vertices(vertices, src, dest, _buffer_size);
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW );
 
 	GLuint shaderProgram = shaders[WHITGL_SHADER_POST].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
+	_whitgl_sys_use_program( shaderProgram );
 	GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
 	_whitgl_load_uniforms(WHITGL_SHADER_POST);
-	_whitgl_sys_orthographic(shaderProgram, 0, _window_size.x, 0, _window_size.y);
+	_whitgl_sys_orthographic(WHITGL_SHADER_POST, 0, _window_size.x, 0, _window_size.y);
 
 	#define BUFFER_OFFSET(i) ((void*)(i))
 	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
@@ -866,7 +1435,7 @@ void whitgl_sys_draw_finish()
 	GL_CHECK( glVertexAttribPointer( texturePosAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
 	GL_CHECK( glEnableVertexAttribArray( texturePosAttrib ) );
 
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, 6 ) );
+	_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, 6 );
 
 	if(capture.do_next && !capture.pre_postprocess)
 	{
@@ -878,7 +1447,7 @@ void whitgl_sys_draw_finish()
 		unsigned char* buffer = malloc(capture_size.x*capture_size.y*4);
 		whitgl_int i;
 		for(i=0; i<capture_size.y; i++)
-			memcpy(buffer+i*capture_size.x, flipped_buffer+(capture_size.y-1-i)*capture_size.x, capture_size.x);
+			memcpy(buffer+i*capture_size.x*4, flipped_buffer+(capture_size.y-1-i)*capture_size.x*4, capture_size.x*4);
 
 		if(capture.to_file)
 			whitgl_sys_save_png(capture.file, capture_size.x, capture_size.y, buffer);
@@ -891,9 +1460,26 @@ void whitgl_sys_draw_finish()
 	}
 
 	whitgl_profile_end_frame();
+	whitgl_memory_frame();
+	last_frame_stats = frame_stats;
+	frame_stats = whitgl_sys_stats_zero;
 	started_drawing = false;
 	glfwSwapBuffers(_window);
 
+	if(_setup.max_frames_in_flight > 0)
+	{
+		whitgl_int limit = whitgl_imin(_setup.max_frames_in_flight, WHITGL_MAX_FRAMES_IN_FLIGHT);
+		frame_fences[next_frame_fence] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next_frame_fence = (next_frame_fence+1)%limit;
+		if(frame_fences[next_frame_fence])
+		{
+			// wait on the frame from limit swaps ago, so input polled below is as fresh as it can be
+			glClientWaitSync(frame_fences[next_frame_fence], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(frame_fences[next_frame_fence]);
+			frame_fences[next_frame_fence] = 0;
+		}
+	}
+
 	glfwPollEvents();
 	GL_CHECK( glDisable(GL_BLEND) );
 	whitgl_profile_start_frame();
@@ -901,7 +1487,7 @@ void whitgl_sys_draw_finish()
 
 void whitgl_sys_draw_buffer_pane(whitgl_int id, whitgl_fvec3 v[4], whitgl_shader_slot shader, whitgl_fmat m_model, whitgl_fmat m_view, whitgl_fmat m_perspective)
 {
-	_whitgl_sys_flush_tex_iaabb();
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
 
 
 	if(shader >= WHITGL_SHADER_MAX)
@@ -925,16 +1511,15 @@ void whitgl_sys_draw_buffer_pane(whitgl_int id, whitgl_fvec3 v[4], whitgl_shader
 	vertices[i++] = v[0].x; vertices[i++] = v[0].y; vertices[i++] = v[0].z; vertices[i++] = 0; vertices[i++] = 0;
 
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW );
 
 	GLuint shaderProgram = shaders[shader].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
+	_whitgl_sys_use_program( shaderProgram );
 	GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
 
 	_whitgl_load_uniforms(shader);
 	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_model"), 1, GL_FALSE, m_model.mat);
-	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_view"), 1, GL_FALSE, m_view.mat);
-	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_perspective"), 1, GL_FALSE, m_perspective.mat);
+	_whitgl_sys_set_camera(shader, m_view, m_perspective);
 
 	#define BUFFER_OFFSET(i) ((void*)(i))
 	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
@@ -946,30 +1531,332 @@ void whitgl_sys_draw_buffer_pane(whitgl_int id, whitgl_fvec3 v[4], whitgl_shader
 	GL_CHECK( glVertexAttribPointer( texturePosAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
 	GL_CHECK( glEnableVertexAttribArray( texturePosAttrib ) );
 
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, 6 ) );
+	_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, 6 );
 }
 
-void whitgl_sys_draw_iaabb(whitgl_iaabb rect, whitgl_sys_color col)
+// True if any of rect lands in the 2D render area, rect may be flipped
+whitgl_bool _whitgl_sys_rect_visible(whitgl_iaabb rect)
 {
-	_whitgl_sys_flush_tex_iaabb();
-	float vertices[6*5];
-	_whitgl_populate_vertices(vertices, whitgl_iaabb_zero, rect, whitgl_ivec_zero);
-
-	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW ) );
-
-	GLuint shaderProgram = shaders[WHITGL_SHADER_FLAT].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
-	whitgl_set_shader_color(WHITGL_SHADER_FLAT, 0, col);
-	_whitgl_load_uniforms(WHITGL_SHADER_FLAT);
-	_whitgl_sys_orthographic(shaderProgram, 0, _setup.size.x, 0, _setup.size.y);
-
-	#define BUFFER_OFFSET(i) ((void*)(i))
-	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
-	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ) );
-	GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
-
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, 6 ) );
+	if(!cpu_culling || recording_id != -1)
+		return true; // a recording can be replayed anywhere
+	if(whitgl_imax(rect.a.x, rect.b.x) > 0 && whitgl_imin(rect.a.x, rect.b.x) < _setup.size.x &&
+	   whitgl_imax(rect.a.y, rect.b.y) > 0 && whitgl_imin(rect.a.y, rect.b.y) < _setup.size.y)
+		return true;
+	frame_stats.culled_draws++;
+	return false;
+}
+
+// Tests the model's bounding sphere against the frustum planes of
+// perspective*view*model, which puts the planes in model space
+whitgl_bool _whitgl_sys_sphere_visible(whitgl_fvec3 center, whitgl_float radius, whitgl_fmat m_model, whitgl_fmat m_view, whitgl_fmat m_perspective)
+{
+	if(!cpu_culling)
+		return true;
+	whitgl_fmat m = whitgl_fmat_multiply(whitgl_fmat_multiply(m_perspective, m_view), m_model);
+	whitgl_int i;
+	for(i=0; i<6; i++)
+	{
+		whitgl_int row = i/2;
+		whitgl_float sign = (i%2) ? -1 : 1;
+		whitgl_float a = m.mat[3] + sign*m.mat[row];
+		whitgl_float b = m.mat[7] + sign*m.mat[4+row];
+		whitgl_float c = m.mat[11] + sign*m.mat[8+row];
+		whitgl_float d = m.mat[15] + sign*m.mat[12+row];
+		whitgl_float length = whitgl_fsqrt(a*a + b*b + c*c);
+		if(length == 0)
+			continue;
+		whitgl_float distance = (a*center.x + b*center.y + c*center.z + d)/length;
+		if(distance < -radius)
+		{
+			frame_stats.culled_draws++;
+			return false;
+		}
+	}
+	return true;
+}
+
+void whitgl_sys_enable_cpu_culling(whitgl_bool enable)
+{
+	cpu_culling = enable;
+}
+
+whitgl_sys_stats whitgl_sys_get_stats()
+{
+	return last_frame_stats;
+}
+whitgl_int whitgl_sys_get_culled_draws()
+{
+	return last_frame_stats.culled_draws;
+}
+
+// Recorded vertices are position, texture coords and rgba. Vertices come in
+// as position only (stride 3), the _whitgl_populate_vertices layout (5) or the
+// colour batch layout (7), and the missing parts are zeroed.
+#define WHITGL_RECORD_STRIDE (9)
+whitgl_bool _whitgl_static_segment_same_state(const whitgl_static_segment* a, const whitgl_static_segment* b)
+{
+	whitgl_bool same_color = a->color.r == b->color.r && a->color.g == b->color.g && a->color.b == b->color.b && a->color.a == b->color.a;
+	return a->mode == b->mode && a->shader == b->shader && a->image_index == b->image_index && same_color;
+}
+void _whitgl_sys_record(GLenum mode, whitgl_shader_slot shader, whitgl_int image_index, whitgl_sys_color color, const float* vertices, whitgl_int num_vertices, whitgl_int stride)
+{
+	if(record_num_vertices+num_vertices > record_max_vertices)
+	{
+		record_max_vertices = whitgl_imax(record_max_vertices*2, record_num_vertices+num_vertices);
+		record_vertices = realloc(record_vertices, sizeof(float)*WHITGL_RECORD_STRIDE*record_max_vertices);
+	}
+	whitgl_int i;
+	for(i=0; i<num_vertices; i++)
+	{
+		float* out = &record_vertices[(record_num_vertices+i)*WHITGL_RECORD_STRIDE];
+		const float* in = &vertices[i*stride];
+		memset(out, 0, sizeof(float)*WHITGL_RECORD_STRIDE);
+		out[0] = in[0]; out[1] = in[1]; out[2] = in[2];
+		if(stride == 5)
+			memcpy(&out[3], &in[3], sizeof(float)*2);
+		if(stride == 7)
+			memcpy(&out[5], &in[3], sizeof(float)*4);
+	}
+
+	whitgl_static_segment segment = {mode, shader, image_index, color, record_num_vertices, num_vertices};
+	if(record_num_segments > 0)
+	{
+		whitgl_static_segment* last = &record_segments[record_num_segments-1];
+		if(_whitgl_static_segment_same_state(last, &segment))
+		{
+			last->count += num_vertices;
+			record_num_vertices += num_vertices;
+			return;
+		}
+	}
+	if(record_num_segments >= record_max_segments)
+	{
+		record_max_segments = whitgl_imax(record_max_segments*2, 16);
+		record_segments = realloc(record_segments, sizeof(whitgl_static_segment)*record_max_segments);
+	}
+	record_segments[record_num_segments++] = segment;
+	record_num_vertices += num_vertices;
+}
+
+// Moves each recorded segment back into the last earlier segment with the same
+// state, as long as it overlaps nothing drawn in between, so that draw order
+// only changes where it can't be seen. Lines are padded since they cover the
+// pixels at their bounds.
+void _whitgl_sys_bucket_segments()
+{
+	whitgl_int* bucket_of = malloc(sizeof(whitgl_int)*record_num_segments);
+	whitgl_static_segment* buckets = malloc(sizeof(whitgl_static_segment)*record_num_segments);
+	whitgl_faabb* bucket_bounds = malloc(sizeof(whitgl_faabb)*record_num_segments);
+	whitgl_int num_buckets = 0;
+	whitgl_int i, j;
+	for(i=0; i<record_num_segments; i++)
+	{
+		whitgl_static_segment* segment = &record_segments[i];
+		const float* v = &record_vertices[segment->first*WHITGL_RECORD_STRIDE];
+		whitgl_faabb box = {{v[0], v[1]}, {v[0], v[1]}};
+		for(j=1; j<segment->count; j++)
+		{
+			v += WHITGL_RECORD_STRIDE;
+			box.a.x = whitgl_fmin(box.a.x, v[0]); box.a.y = whitgl_fmin(box.a.y, v[1]);
+			box.b.x = whitgl_fmax(box.b.x, v[0]); box.b.y = whitgl_fmax(box.b.y, v[1]);
+		}
+		if(segment->mode == GL_LINES)
+		{
+			whitgl_fvec pad = {1, 1};
+			box.a = whitgl_fvec_sub(box.a, pad);
+			box.b = whitgl_fvec_add(box.b, pad);
+		}
+
+		whitgl_int bucket = -1;
+		for(j=num_buckets-1; j>=0; j--)
+		{
+			if(_whitgl_static_segment_same_state(&buckets[j], segment))
+			{
+				bucket = j;
+				break;
+			}
+			if(whitgl_faabb_intersects(bucket_bounds[j], box))
+				break;
+		}
+		if(bucket == -1)
+		{
+			bucket = num_buckets++;
+			buckets[bucket] = *segment;
+			buckets[bucket].count = 0;
+			bucket_bounds[bucket] = box;
+		}
+		buckets[bucket].count += segment->count;
+		bucket_bounds[bucket] = whitgl_faabb_incorporate(bucket_bounds[bucket], box);
+		bucket_of[i] = bucket;
+	}
+
+	if(num_buckets < record_num_segments)
+	{
+		float* sorted = malloc(sizeof(float)*WHITGL_RECORD_STRIDE*record_num_vertices);
+		whitgl_int first = 0;
+		for(i=0; i<num_buckets; i++)
+		{
+			buckets[i].first = first;
+			first += buckets[i].count;
+			buckets[i].count = 0;
+		}
+		for(i=0; i<record_num_segments; i++)
+		{
+			whitgl_static_segment* from = &record_segments[i];
+			whitgl_static_segment* to = &buckets[bucket_of[i]];
+			memcpy(&sorted[(to->first+to->count)*WHITGL_RECORD_STRIDE], &record_vertices[from->first*WHITGL_RECORD_STRIDE], sizeof(float)*WHITGL_RECORD_STRIDE*from->count);
+			to->count += from->count;
+		}
+		memcpy(record_vertices, sorted, sizeof(float)*WHITGL_RECORD_STRIDE*record_num_vertices);
+		memcpy(record_segments, buckets, sizeof(whitgl_static_segment)*num_buckets);
+		record_num_segments = num_buckets;
+		free(sorted);
+	}
+	free(bucket_of);
+	free(buckets);
+	free(bucket_bounds);
+}
+
+void whitgl_sys_begin_static_batch(whitgl_int id)
+{
+	if(recording_id != -1)
+		WHITGL_PANIC("already recording static batch %d", recording_id);
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_FRAME);
+	recording_id = id;
+	record_num_vertices = 0;
+	record_num_segments = 0;
+}
+
+void whitgl_sys_end_static_batch()
+{
+	if(recording_id == -1)
+	{
+		WHITGL_PANIC("not recording a static batch");
+		return;
+	}
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_FRAME);
+	int index = -1;
+	int i;
+	for(i=0; i<num_static_batches; i++)
+	{
+		if(static_batches[i].id == recording_id)
+		{
+			index = i;
+			break;
+		}
+	}
+	if(index == -1)
+	{
+		if(num_static_batches >= WHITGL_STATIC_BATCH_MAX)
+		{
+			WHITGL_PANIC("ERR Too many static batches");
+			return;
+		}
+		index = num_static_batches++;
+		static_batches[index].id = recording_id;
+		static_batches[index].segments = NULL;
+		GL_CHECK( glGenBuffers( 1, &static_batches[index].vbo ) );
+	}
+	recording_id = -1;
+	_whitgl_sys_bucket_segments();
+
+	whitgl_static_batch* batch = &static_batches[index];
+	free(batch->segments);
+	batch->segments = malloc(sizeof(whitgl_static_segment)*record_num_segments);
+	memcpy(batch->segments, record_segments, sizeof(whitgl_static_segment)*record_num_segments);
+	batch->num_segments = record_num_segments;
+	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, batch->vbo ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof(float)*WHITGL_RECORD_STRIDE*record_num_vertices, record_vertices, GL_STATIC_DRAW );
+	whitgl_memory_set(WHITGL_MEMORY_STATIC_BATCH, batch->id, sizeof(float)*WHITGL_RECORD_STRIDE*record_num_vertices + sizeof(whitgl_static_segment)*record_num_segments);
+}
+
+void whitgl_sys_draw_static_batch(whitgl_int id, whitgl_fmat m_model)
+{
+	int index = -1;
+	int i;
+	for(i=0; i<num_static_batches; i++)
+	{
+		if(static_batches[i].id == id)
+		{
+			index = i;
+			break;
+		}
+	}
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find static batch %d", id);
+		return;
+	}
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
+	whitgl_static_batch* batch = &static_batches[index];
+	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, batch->vbo ) );
+	GL_CHECK( glActiveTexture( GL_TEXTURE0 ) );
+	for(i=0; i<batch->num_segments; i++)
+	{
+		whitgl_static_segment* segment = &batch->segments[i];
+		GLuint shaderProgram = shaders[segment->shader].program;
+		_whitgl_sys_use_program( shaderProgram );
+		if(segment->shader == WHITGL_SHADER_FLAT)
+			shaders[WHITGL_SHADER_FLAT].uniforms[0].color = segment->color;
+		else if(segment->shader == WHITGL_SHADER_TEXTURE)
+		{
+			GL_CHECK( glBindTexture( GL_TEXTURE_2D, images[segment->image_index].gluint ) );
+			GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
+		}
+		_whitgl_load_uniforms(segment->shader);
+		_whitgl_sys_orthographic(segment->shader, 0, _setup.size.x, 0, _setup.size.y);
+		glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_model"), 1, GL_FALSE, m_model.mat);
+
+		#define BUFFER_OFFSET(i) ((void*)(i))
+		GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
+		GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, WHITGL_RECORD_STRIDE*sizeof(float), 0 ) );
+		GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
+		GLint texturePosAttrib = glGetAttribLocation( shaderProgram, "texturepos" );
+		if(texturePosAttrib > -1)
+		{
+			GL_CHECK( glVertexAttribPointer( texturePosAttrib, 2, GL_FLOAT, GL_FALSE, WHITGL_RECORD_STRIDE*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
+			GL_CHECK( glEnableVertexAttribArray( texturePosAttrib ) );
+		}
+		GLint vertexColor = glGetAttribLocation( shaderProgram, "vertexColor" );
+		if(segment->shader == WHITGL_SHADER_COLOR && vertexColor > -1)
+		{
+			GL_CHECK( glVertexAttribPointer( vertexColor, 4, GL_FLOAT, GL_FALSE, WHITGL_RECORD_STRIDE*sizeof(float), BUFFER_OFFSET(sizeof(float)*5) ) );
+			GL_CHECK( glEnableVertexAttribArray( vertexColor ) );
+		}
+		_whitgl_sys_draw_arrays( segment->mode, segment->first, segment->count );
+		if(segment->shader == WHITGL_SHADER_COLOR && vertexColor > -1)
+			GL_CHECK( glDisableVertexAttribArray( vertexColor ) );
+	}
+}
+
+void whitgl_sys_draw_iaabb(whitgl_iaabb rect, whitgl_sys_color col)
+{
+	if(!_whitgl_sys_rect_visible(rect))
+		return;
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
+	float vertices[6*5];
+	_whitgl_populate_vertices(vertices, whitgl_iaabb_zero, rect, whitgl_ivec_zero);
+	if(recording_id != -1)
+	{
+		_whitgl_sys_record(GL_TRIANGLES, WHITGL_SHADER_FLAT, -1, col, vertices, 6, 5);
+		return;
+	}
+
+	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW );
+
+	GLuint shaderProgram = shaders[WHITGL_SHADER_FLAT].program;
+	_whitgl_sys_use_program( shaderProgram );
+	whitgl_set_shader_color(WHITGL_SHADER_FLAT, 0, col);
+	_whitgl_load_uniforms(WHITGL_SHADER_FLAT);
+	_whitgl_sys_orthographic(WHITGL_SHADER_FLAT, 0, _setup.size.x, 0, _setup.size.y);
+
+	#define BUFFER_OFFSET(i) ((void*)(i))
+	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
+	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ) );
+	GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
+
+	_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, 6 );
 }
 
 void whitgl_sys_draw_hollow_iaabb(whitgl_iaabb rect, whitgl_int width, whitgl_sys_color col)
@@ -985,72 +1872,266 @@ void whitgl_sys_draw_hollow_iaabb(whitgl_iaabb rect, whitgl_int width, whitgl_sy
 }
 void whitgl_sys_draw_line(whitgl_iaabb l, whitgl_sys_color col)
 {
-	_whitgl_sys_flush_tex_iaabb();
+	whitgl_iaabb bounds = {{whitgl_imin(l.a.x, l.b.x), whitgl_imin(l.a.y, l.b.y)}, {whitgl_imax(l.a.x, l.b.x)+1, whitgl_imax(l.a.y, l.b.y)+1}};
+	if(!_whitgl_sys_rect_visible(bounds))
+		return;
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
 	float vertices[2*3];
 	whitgl_int i = 0;
 	vertices[i++] = l.a.x; vertices[i++] = l.a.y; vertices[i++] = 0;
 	vertices[i++] = l.b.x; vertices[i++] = l.b.y; vertices[i++] = 0;
+	if(recording_id != -1)
+	{
+		_whitgl_sys_record(GL_LINES, WHITGL_SHADER_FLAT, -1, col, vertices, 2, 3);
+		return;
+	}
 
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_DYNAMIC_DRAW );
 
 	GLuint shaderProgram = shaders[WHITGL_SHADER_FLAT].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
+	_whitgl_sys_use_program( shaderProgram );
 	whitgl_set_shader_color(WHITGL_SHADER_FLAT, 0, col);
 	_whitgl_load_uniforms(WHITGL_SHADER_FLAT);
-	_whitgl_sys_orthographic(shaderProgram, 0, _setup.size.x, 0, _setup.size.y);
+	_whitgl_sys_orthographic(WHITGL_SHADER_FLAT, 0, _setup.size.x, 0, _setup.size.y);
 
 	#define BUFFER_OFFSET(i) ((void*)(i))
 	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
 	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0 ) );
 	GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
 
-	GL_CHECK( glDrawArrays( GL_LINES, 0, 2 ) );
+	_whitgl_sys_draw_arrays( GL_LINES, 0, 2 );
 }
-void whitgl_sys_draw_fcircle(whitgl_fcircle c, whitgl_sys_color col, int tris)
+
+// Miter joins longer than this many half widths are drawn as bevels
+#define WHITGL_MITER_LIMIT (4.0)
+void _whitgl_sys_color_vertex(float* v, float x, float y, const float* rgba);
+void _whitgl_sys_color_to_floats(whitgl_sys_color col, float* rgba)
 {
-	_whitgl_sys_flush_tex_iaabb();
-	int num_vertices = tris*3*3;
-	whitgl_fvec scale = {c.size, c.size};
-	float *vertices = malloc(sizeof(float)*num_vertices);
-	int i;
-	for(i=0; i<tris; i++)
+	rgba[0] = col.r/255.0f; rgba[1] = col.g/255.0f; rgba[2] = col.b/255.0f; rgba[3] = col.a/255.0f;
+}
+whitgl_fvec _whitgl_sys_segment_normal(const whitgl_fvec* points, whitgl_int num_points, whitgl_int segment)
+{
+	whitgl_fvec a = points[segment];
+	whitgl_fvec b = points[(segment+1)%num_points];
+	whitgl_fvec d = whitgl_fvec_sub(b, a);
+	whitgl_float len = whitgl_fvec_magnitude(d);
+	if(len == 0)
+		return whitgl_fvec_zero;
+	whitgl_fvec n = {-d.y/len, d.x/len};
+	return n;
+}
+// Offset from a joint to the outline shared by both segments, or false if the
+// join should be bevelled
+whitgl_bool _whitgl_sys_miter_offset(whitgl_fvec n0, whitgl_fvec n1, whitgl_float half_width, whitgl_fvec* offset)
+{
+	whitgl_fvec m = whitgl_fvec_add(n0, n1);
+	whitgl_float len = whitgl_fvec_magnitude(m);
+	if(len < 0.000001)
+		return false;
+	m = whitgl_fvec_scale_val(m, 1/len);
+	whitgl_float cos_half = m.x*n0.x + m.y*n0.y;
+	if(cos_half < 1/WHITGL_MITER_LIMIT)
+		return false;
+	*offset = whitgl_fvec_scale_val(m, half_width/cos_half);
+	return true;
+}
+void _whitgl_sys_draw_polyline(const whitgl_fvec* points, const whitgl_sys_color* colors, whitgl_sys_color col, whitgl_int num_points, whitgl_float width, whitgl_sys_line_join join, whitgl_bool closed)
+{
+	if(num_points < 2)
+		return;
+	if(num_points < 3)
+		closed = false;
+	whitgl_int num_segments = closed ? num_points : num_points-1;
+	whitgl_float half_width = width/2;
+	whitgl_float reach = half_width*WHITGL_MITER_LIMIT+1;
+	float rgba0[4], rgba1[4];
+	_whitgl_sys_color_to_floats(col, rgba0);
+	_whitgl_sys_color_to_floats(col, rgba1);
+	whitgl_fvec n_prev = closed ? _whitgl_sys_segment_normal(points, num_points, num_segments-1) : whitgl_fvec_zero;
+	whitgl_fvec n = _whitgl_sys_segment_normal(points, num_points, 0);
+	whitgl_int s;
+	for(s=0; s<num_segments; s++)
 	{
-		whitgl_float dir;
-		whitgl_fvec off;
-		int vertex_offset = 3*3*i;
-		vertices[vertex_offset++] = c.pos.x; vertices[vertex_offset++] = c.pos.y; vertices[vertex_offset++] = 0;
-
-		dir = ((whitgl_float)(i+1))/tris * whitgl_pi * 2;
-		off = whitgl_fvec_scale(whitgl_angle_to_fvec(dir), scale);
-		vertices[vertex_offset++] = c.pos.x+off.x; vertices[vertex_offset++] = c.pos.y+off.y; vertices[vertex_offset++] = 0;
-
-		dir = ((whitgl_float)i)/tris * whitgl_pi * 2 ;
-		off = whitgl_fvec_scale(whitgl_angle_to_fvec(dir), scale);
-		vertices[vertex_offset++] = c.pos.x+off.x; vertices[vertex_offset++] = c.pos.y+off.y; vertices[vertex_offset++] = 0;
+		whitgl_int i0 = s;
+		whitgl_int i1 = (s+1)%num_points;
+		whitgl_bool has_next = closed || s < num_segments-1;
+		whitgl_fvec n_next = has_next ? _whitgl_sys_segment_normal(points, num_points, (s+1)%num_segments) : whitgl_fvec_zero;
+		whitgl_fvec a = points[i0];
+		whitgl_fvec b = points[i1];
+
+		whitgl_fvec start = whitgl_fvec_scale_val(n, half_width);
+		whitgl_fvec end = start;
+		whitgl_bool bevel = false;
+		if((closed || s > 0) && join == WHITGL_LINE_JOIN_MITER)
+			_whitgl_sys_miter_offset(n_prev, n, half_width, &start);
+		if(has_next)
+			bevel = join == WHITGL_LINE_JOIN_BEVEL || !_whitgl_sys_miter_offset(n, n_next, half_width, &end);
+
+		whitgl_faabb bounds = {{whitgl_fmin(a.x, b.x)-reach, whitgl_fmin(a.y, b.y)-reach}, {whitgl_fmax(a.x, b.x)+reach, whitgl_fmax(a.y, b.y)+reach}};
+		if(_whitgl_sys_rect_visible(whitgl_faabb_to_iaabb(bounds)))
+		{
+			if(colors)
+			{
+				_whitgl_sys_color_to_floats(colors[i0], rgba0);
+				_whitgl_sys_color_to_floats(colors[i1], rgba1);
+			}
+			// wound the same way as _whitgl_sys_write_quad, or culling drops them
+			float* v = _whitgl_sys_batch_reserve(WHITGL_BATCH_COLOR, -1, bevel ? 9 : 6);
+			_whitgl_sys_color_vertex(v, a.x-start.x, a.y-start.y, rgba0); v += 7;
+			_whitgl_sys_color_vertex(v, a.x+start.x, a.y+start.y, rgba0); v += 7;
+			_whitgl_sys_color_vertex(v, b.x+end.x, b.y+end.y, rgba1); v += 7;
+			_whitgl_sys_color_vertex(v, a.x-start.x, a.y-start.y, rgba0); v += 7;
+			_whitgl_sys_color_vertex(v, b.x+end.x, b.y+end.y, rgba1); v += 7;
+			_whitgl_sys_color_vertex(v, b.x-end.x, b.y-end.y, rgba1); v += 7;
+			if(bevel)
+			{
+				// fill the wedge on the outside of the turn, its winding
+				// follows the turn so order the outer corners by it
+				whitgl_float turn = n.x*n_next.y - n.y*n_next.x;
+				whitgl_float side = turn > 0 ? -half_width : half_width;
+				whitgl_fvec first = turn > 0 ? n_next : n;
+				whitgl_fvec second = turn > 0 ? n : n_next;
+				_whitgl_sys_color_vertex(v, b.x, b.y, rgba1); v += 7;
+				_whitgl_sys_color_vertex(v, b.x+first.x*side, b.y+first.y*side, rgba1); v += 7;
+				_whitgl_sys_color_vertex(v, b.x+second.x*side, b.y+second.y*side, rgba1); v += 7;
+			}
+		}
+		n_prev = n;
+		n = n_next;
 	}
+}
+void whitgl_sys_draw_polyline(const whitgl_fvec* points, whitgl_int num_points, whitgl_float width, whitgl_sys_line_join join, whitgl_bool closed, whitgl_sys_color col)
+{
+	_whitgl_sys_draw_polyline(points, NULL, col, num_points, width, join, closed);
+}
+void whitgl_sys_draw_polyline_colored(const whitgl_fvec* points, const whitgl_sys_color* colors, whitgl_int num_points, whitgl_float width, whitgl_sys_line_join join, whitgl_bool closed)
+{
+	_whitgl_sys_draw_polyline(points, colors, whitgl_sys_color_zero, num_points, width, join, closed);
+}
+void whitgl_sys_draw_thick_line(whitgl_fvec a, whitgl_fvec b, whitgl_float width, whitgl_sys_color col)
+{
+	whitgl_fvec points[2] = {a, b};
+	_whitgl_sys_draw_polyline(points, NULL, col, 2, width, WHITGL_LINE_JOIN_BEVEL, false);
+}
+// Unit circle points for each tessellation level in use, so circles don't
+// need any trig once their level has been seen
+typedef struct
+{
+	int tris;
+	float* points;
+} whitgl_circle_table;
+#define WHITGL_CIRCLE_TABLE_MAX (16)
+whitgl_circle_table circle_tables[WHITGL_CIRCLE_TABLE_MAX];
+whitgl_int num_circle_tables = 0;
+whitgl_int next_circle_table = 0;
+const float* _whitgl_sys_circle_table(int tris)
+{
+	whitgl_int i;
+	for(i=0; i<num_circle_tables; i++)
+		if(circle_tables[i].tris == tris)
+			return circle_tables[i].points;
+	if(num_circle_tables < WHITGL_CIRCLE_TABLE_MAX)
+	{
+		i = num_circle_tables++;
+	}
+	else
+	{
+		i = next_circle_table;
+		next_circle_table = (next_circle_table+1)%WHITGL_CIRCLE_TABLE_MAX;
+		free(circle_tables[i].points);
+	}
+	circle_tables[i].tris = tris;
+	circle_tables[i].points = malloc(sizeof(float)*2*(tris+1));
+	whitgl_int j;
+	for(j=0; j<=tris; j++)
+	{
+		whitgl_fvec dir = whitgl_angle_to_fvec(((whitgl_float)j)/tris * whitgl_pi * 2);
+		circle_tables[i].points[j*2] = dir.x;
+		circle_tables[i].points[j*2+1] = dir.y;
+	}
+	return circle_tables[i].points;
+}
 
-	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof(float)*num_vertices , vertices, GL_DYNAMIC_DRAW ) );
-
-	GLuint shaderProgram = shaders[WHITGL_SHADER_FLAT].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
-	whitgl_set_shader_color(WHITGL_SHADER_FLAT, 0, col);
-	_whitgl_load_uniforms(WHITGL_SHADER_FLAT);
-	_whitgl_sys_orthographic(shaderProgram, 0, _setup.size.x, 0, _setup.size.y);
+void _whitgl_sys_color_vertex(float* v, float x, float y, const float* rgba)
+{
+	v[0] = x; v[1] = y; v[2] = 0;
+	v[3] = rgba[0]; v[4] = rgba[1]; v[5] = rgba[2]; v[6] = rgba[3];
+}
 
-	#define BUFFER_OFFSET(i) ((void*)(i))
-	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
-	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), 0 ) );
-	GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
+// Triangles between an inner and outer ellipse, or a fan from the centre
+// when inner is zero
+void _whitgl_sys_draw_ellipse_band(whitgl_fvec pos, whitgl_fvec outer, whitgl_fvec inner, whitgl_sys_color col, int tris)
+{
+	if(tris < 1)
+		return;
+	whitgl_faabb bounds = {{pos.x-outer.x, pos.y-outer.y}, {pos.x+outer.x+1, pos.y+outer.y+1}};
+	if(!_whitgl_sys_rect_visible(whitgl_faabb_to_iaabb(bounds)))
+		return;
+	const float* table = _whitgl_sys_circle_table(tris);
+	float rgba[4];
+	_whitgl_sys_color_to_floats(col, rgba);
+	whitgl_bool fan = inner.x == 0 && inner.y == 0;
+	whitgl_int verts_per_step = fan ? 3 : 6;
+	whitgl_int max_steps = WHITGL_BATCH_MAX_VERTICES/verts_per_step;
+	int i = 0;
+	while(i < tris)
+	{
+		whitgl_int steps = whitgl_imin(tris-i, max_steps);
+		float* v = _whitgl_sys_batch_reserve(WHITGL_BATCH_COLOR, -1, steps*verts_per_step);
+		whitgl_int end = i+steps;
+		for(; i<end; i++)
+		{
+			const float* p0 = &table[i*2];
+			const float* p1 = &table[(i+1)*2];
+			float ox0 = pos.x+p0[0]*outer.x, oy0 = pos.y+p0[1]*outer.y;
+			float ox1 = pos.x+p1[0]*outer.x, oy1 = pos.y+p1[1]*outer.y;
+			if(fan)
+			{
+				_whitgl_sys_color_vertex(v, pos.x, pos.y, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ox1, oy1, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ox0, oy0, rgba); v += 7;
+			}
+			else
+			{
+				float ix0 = pos.x+p0[0]*inner.x, iy0 = pos.y+p0[1]*inner.y;
+				float ix1 = pos.x+p1[0]*inner.x, iy1 = pos.y+p1[1]*inner.y;
+				_whitgl_sys_color_vertex(v, ix0, iy0, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ox1, oy1, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ox0, oy0, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ix0, iy0, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ix1, iy1, rgba); v += 7;
+				_whitgl_sys_color_vertex(v, ox1, oy1, rgba); v += 7;
+			}
+		}
+	}
+}
 
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, tris*3 ) );
-	free(vertices);
+void whitgl_sys_draw_fcircle(whitgl_fcircle c, whitgl_sys_color col, int tris)
+{
+	whitgl_fvec radius = {c.size, c.size};
+	_whitgl_sys_draw_ellipse_band(c.pos, radius, whitgl_fvec_zero, col, tris);
+}
+void whitgl_sys_draw_fellipse(whitgl_fvec pos, whitgl_fvec radius, whitgl_sys_color col, int tris)
+{
+	_whitgl_sys_draw_ellipse_band(pos, radius, whitgl_fvec_zero, col, tris);
+}
+void whitgl_sys_draw_fring(whitgl_fcircle c, whitgl_float thickness, whitgl_sys_color col, int tris)
+{
+	whitgl_fvec outer = {c.size, c.size};
+	whitgl_float inner_size = whitgl_fmax(c.size-thickness, 0);
+	if(inner_size == 0)
+	{
+		_whitgl_sys_draw_ellipse_band(c.pos, outer, whitgl_fvec_zero, col, tris);
+		return;
+	}
+	whitgl_fvec inner = {inner_size, inner_size};
+	_whitgl_sys_draw_ellipse_band(c.pos, outer, inner, col, tris);
 }
 
 void whitgl_sys_draw_model(whitgl_int id, whitgl_shader_slot shader, whitgl_fmat m_model, whitgl_fmat m_view, whitgl_fmat m_perspective)
 {
-	_whitgl_sys_flush_tex_iaabb();
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
 
 	int index = -1;
 	int i;
@@ -1072,15 +2153,16 @@ void whitgl_sys_draw_model(whitgl_int id, whitgl_shader_slot shader, whitgl_fmat
 		WHITGL_PANIC("Invalid shader type %d", shader);
 		return;
 	}
+	if(!_whitgl_sys_sphere_visible(models[index].bounds_center, models[index].bounds_radius, m_model, m_view, m_perspective))
+		return;
 
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, models[index].vbo ) );
 
 	GLuint shaderProgram = shaders[shader].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
+	_whitgl_sys_use_program( shaderProgram );
 	_whitgl_load_uniforms(shader);
 	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_model"), 1, GL_FALSE, m_model.mat);
-	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_view"), 1, GL_FALSE, m_view.mat);
-	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_perspective"), 1, GL_FALSE, m_perspective.mat);
+	_whitgl_sys_set_camera(shader, m_view, m_perspective);
 
 
 	#define BUFFER_OFFSET(i) ((void*)(i))
@@ -1108,7 +2190,7 @@ void whitgl_sys_draw_model(whitgl_int id, whitgl_shader_slot shader, whitgl_fmat
 		GL_CHECK( glEnableVertexAttribArray( vertexNormal ) );
 	}
 
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, models[index].num_vertices ) );
+	_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, models[index].num_vertices );
 
         if(texturePosAttrib > -1)
                 GL_CHECK( glDisableVertexAttribArray(texturePosAttrib) );
@@ -1118,41 +2200,88 @@ void whitgl_sys_draw_model(whitgl_int id, whitgl_shader_slot shader, whitgl_fmat
 		GL_CHECK( glDisableVertexAttribArray(vertexNormal) );
 }
 
+float buffer_vertices[WHITGL_BATCH_MAX_VERTICES*7];
+whitgl_batch_mode buffer_mode = WHITGL_BATCH_TEXTURE;
 whitgl_int buffer_curindex = -1;
-static const whitgl_int buffer_num_quads = 128;
-float buffer_vertices[128*6*5];
-whitgl_int buffer_index = 0;
-void _whitgl_sys_flush_tex_iaabb()
+whitgl_int buffer_num_vertices = 0;
+
+// Space for num_vertices in the shared batch, flushing first if the batch
+// holds another kind of primitive or texture, or is full
+float* _whitgl_sys_batch_reserve(whitgl_batch_mode mode, whitgl_int image_index, whitgl_int num_vertices)
+{
+	whitgl_int stride = mode == WHITGL_BATCH_TEXTURE ? 5 : 7;
+	if(num_vertices > WHITGL_BATCH_MAX_VERTICES)
+		WHITGL_PANIC("batch reserve of %d vertices is too large", (int)num_vertices);
+	if(buffer_num_vertices > 0)
+	{
+		if(buffer_mode != mode)
+			_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
+		else if(buffer_curindex != image_index)
+			_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_TEXTURE);
+		else if(buffer_num_vertices+num_vertices > WHITGL_BATCH_MAX_VERTICES)
+			_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_FULL);
+	}
+	buffer_mode = mode;
+	buffer_curindex = image_index;
+	float* out = &buffer_vertices[buffer_num_vertices*stride];
+	buffer_num_vertices += num_vertices;
+	return out;
+}
+
+void _whitgl_sys_flush_tex_iaabb(whitgl_sys_flush_reason reason)
 {
-	if(buffer_index == 0 || buffer_curindex == -1)
+	if(buffer_num_vertices == 0)
 		return;
-	GL_CHECK( glActiveTexture( GL_TEXTURE0 ) );
-	GL_CHECK( glBindTexture( GL_TEXTURE_2D, images[buffer_curindex].gluint ) );
+	frame_stats.flushes++;
+	frame_stats.flush_reasons[reason]++;
+	whitgl_bool texture = buffer_mode == WHITGL_BATCH_TEXTURE;
+	whitgl_int stride = texture ? 5 : 7;
+	whitgl_shader_slot slot = texture ? WHITGL_SHADER_TEXTURE : WHITGL_SHADER_COLOR;
+	if(recording_id != -1)
+	{
+		_whitgl_sys_record(GL_TRIANGLES, slot, buffer_curindex, whitgl_sys_color_zero, buffer_vertices, buffer_num_vertices, stride);
+		buffer_curindex = -1;
+		buffer_num_vertices = 0;
+		return;
+	}
+	if(texture)
+	{
+		GL_CHECK( glActiveTexture( GL_TEXTURE0 ) );
+		GL_CHECK( glBindTexture( GL_TEXTURE_2D, images[buffer_curindex].gluint ) );
+	}
 
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, sizeof(float)*buffer_index*6*5, buffer_vertices, GL_DYNAMIC_DRAW ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof(float)*buffer_num_vertices*stride, buffer_vertices, GL_DYNAMIC_DRAW );
 
-	GLuint shaderProgram = shaders[WHITGL_SHADER_TEXTURE].program;
-	GL_CHECK( glUseProgram( shaderProgram ) );
-	GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
-	_whitgl_load_uniforms(WHITGL_SHADER_TEXTURE);
-	_whitgl_sys_orthographic(shaderProgram, 0, _setup.size.x, 0, _setup.size.y);
+	GLuint shaderProgram = shaders[slot].program;
+	_whitgl_sys_use_program( shaderProgram );
+	if(texture)
+		GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
+	_whitgl_load_uniforms(slot);
+	_whitgl_sys_orthographic(slot, 0, _setup.size.x, 0, _setup.size.y);
 
 	#define BUFFER_OFFSET(i) ((void*)(i))
 	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
-	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ) );
+	GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, stride*sizeof(float), 0 ) );
 	GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
 
-	GLint texturePosAttrib = glGetAttribLocation( shaderProgram, "texturepos" );
-	GL_CHECK( glVertexAttribPointer( texturePosAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
-	GL_CHECK( glEnableVertexAttribArray( texturePosAttrib ) );
+	GLint extraAttrib = glGetAttribLocation( shaderProgram, texture ? "texturepos" : "vertexColor" );
+	if(extraAttrib > -1)
+	{
+		GL_CHECK( glVertexAttribPointer( extraAttrib, texture ? 2 : 4, GL_FLOAT, GL_FALSE, stride*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
+		GL_CHECK( glEnableVertexAttribArray( extraAttrib ) );
+	}
 
-	GL_CHECK( glDrawArrays( GL_TRIANGLES, 0, buffer_index*6 ) );
+	_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, buffer_num_vertices );
+	if(!texture && extraAttrib > -1)
+		GL_CHECK( glDisableVertexAttribArray( extraAttrib ) );
 	buffer_curindex = -1;
-	buffer_index = 0;
+	buffer_num_vertices = 0;
 }
 void whitgl_sys_draw_tex_iaabb(int id, whitgl_iaabb src, whitgl_iaabb dest)
 {
+	if(!_whitgl_sys_rect_visible(dest))
+		return;
 	int index = -1;
 	int i;
 	for(i=0; i<num_images; i++)
@@ -1168,14 +2297,8 @@ void whitgl_sys_draw_tex_iaabb(int id, whitgl_iaabb src, whitgl_iaabb dest)
 		WHITGL_PANIC("ERR Cannot find image %d", id);
 		return;
 	}
-	if(buffer_curindex != index || buffer_index+1 >= buffer_num_quads)
-	{
-		if(buffer_curindex != -1)
-			_whitgl_sys_flush_tex_iaabb();
-		buffer_curindex = index;
-	}
-	_whitgl_populate_vertices(&buffer_vertices[buffer_index*6*5], src, dest, images[index].size);
-	buffer_index++;
+	float* vertices = _whitgl_sys_batch_reserve(WHITGL_BATCH_TEXTURE, index, 6);
+	_whitgl_populate_vertices(vertices, src, dest, images[index].size);
 }
 
 void whitgl_sys_draw_sprite(whitgl_sprite sprite, whitgl_ivec frame, whitgl_ivec pos)
@@ -1195,6 +2318,51 @@ void whitgl_sys_draw_sprite_sized(whitgl_sprite sprite, whitgl_ivec frame, whitg
 	whitgl_sys_draw_tex_iaabb(sprite.image, src, dest);
 }
 
+void whitgl_sys_draw_sprite_soa(whitgl_sprite sprite, whitgl_ivec frame, const whitgl_fvec_soa* pos)
+{
+	int index = -1;
+	int i;
+	for(i=0; i<num_images; i++)
+	{
+		if(images[i].id == sprite.image)
+		{
+			index = i;
+			break;
+		}
+	}
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find image %d", (int)sprite.image);
+		return;
+	}
+	whitgl_ivec image_size = images[index].size;
+	whitgl_ivec src = whitgl_ivec_add(sprite.top_left, whitgl_ivec_scale(sprite.size, frame));
+	whitgl_faabb sf = {{((float)src.x)/((float)image_size.x),((float)src.y)/((float)image_size.y)},
+                       {((float)(src.x+sprite.size.x))/((float)image_size.x),((float)(src.y+sprite.size.y))/((float)image_size.y)}};
+	float w = sprite.size.x;
+	float h = sprite.size.y;
+	// the same test as _whitgl_sys_rect_visible, with the size's sign folded in
+	whitgl_bool cull = cpu_culling && recording_id == -1;
+	float lo_x = whitgl_fmin(0, w);
+	float hi_x = whitgl_fmax(0, w);
+	float lo_y = whitgl_fmin(0, h);
+	float hi_y = whitgl_fmax(0, h);
+	whitgl_int n;
+	for(n=0; n<pos->count; n++)
+	{
+		// truncated to whole pixels like whitgl_fvec_to_ivec
+		float x = (int32_t)pos->x[n];
+		float y = (int32_t)pos->y[n];
+		if(cull && !(x+hi_x > 0 && x+lo_x < _setup.size.x && y+hi_y > 0 && y+lo_y < _setup.size.y))
+		{
+			frame_stats.culled_draws++;
+			continue;
+		}
+		float* vertices = _whitgl_sys_batch_reserve(WHITGL_BATCH_TEXTURE, index, 6);
+		_whitgl_sys_write_quad(vertices, x, y, x+w, y+h, sf);
+	}
+}
+
 void whitgl_sys_draw_text(whitgl_sprite sprite, const char* string, whitgl_ivec pos)
 {
 	whitgl_ivec draw_pos = pos;
@@ -1213,6 +2381,208 @@ void whitgl_sys_draw_text(whitgl_sprite sprite, const char* string, whitgl_ivec
 	}
 }
 
+whitgl_int _whitgl_sys_tilemap_index(whitgl_int id)
+{
+	whitgl_int i;
+	for(i=0; i<num_tilemaps; i++)
+		if(tilemaps[i].id == id)
+			return i;
+	return -1;
+}
+
+void _whitgl_sys_account_tilemap(const whitgl_tilemap* map)
+{
+	whitgl_int chunk_count = map->num_chunks.x*map->num_chunks.y;
+	int64_t bytes = (sizeof(whitgl_int)+sizeof(GLuint)+sizeof(whitgl_bool))*chunk_count;
+	bytes += (int64_t)sizeof(whitgl_int)*map->size.x*map->size.y;
+	whitgl_int i;
+	for(i=0; i<chunk_count; i++)
+		bytes += sizeof(float)*5*map->chunk_vertices[i];
+	whitgl_memory_set(WHITGL_MEMORY_TILEMAP, map->id, bytes);
+}
+
+void whitgl_sys_update_tilemap(whitgl_int id, whitgl_sprite sheet, whitgl_ivec size, const whitgl_int* tiles)
+{
+	if(size.x <= 0 || size.y <= 0)
+		WHITGL_PANIC("invalid tilemap size");
+	// tile frames are found by dividing the image by the sheet size
+	if(sheet.size.x <= 0 || sheet.size.y <= 0)
+		WHITGL_PANIC("invalid tilemap sheet size %d %d", (int)sheet.size.x, (int)sheet.size.y);
+	whitgl_int index = _whitgl_sys_tilemap_index(id);
+	if(index == -1)
+	{
+		if(num_tilemaps >= WHITGL_TILEMAP_MAX)
+		{
+			WHITGL_PANIC("ERR Too many tilemaps");
+			return;
+		}
+		index = num_tilemaps++;
+		tilemaps[index] = whitgl_tilemap_zero;
+		tilemaps[index].id = id;
+	}
+	whitgl_tilemap* map = &tilemaps[index];
+	whitgl_ivec num_chunks = {(size.x+WHITGL_TILEMAP_CHUNK-1)/WHITGL_TILEMAP_CHUNK, (size.y+WHITGL_TILEMAP_CHUNK-1)/WHITGL_TILEMAP_CHUNK};
+	if(!whitgl_ivec_eq(map->size, size))
+	{
+		if(map->chunk_vbos)
+			GL_CHECK( glDeleteBuffers(map->num_chunks.x*map->num_chunks.y, map->chunk_vbos) );
+		free(map->tiles);
+		free(map->chunk_vbos);
+		free(map->chunk_vertices);
+		free(map->chunk_dirty);
+		whitgl_int chunk_count = num_chunks.x*num_chunks.y;
+		map->tiles = malloc(sizeof(whitgl_int)*size.x*size.y);
+		map->chunk_vbos = malloc(sizeof(GLuint)*chunk_count);
+		map->chunk_vertices = malloc(sizeof(whitgl_int)*chunk_count);
+		map->chunk_dirty = malloc(sizeof(whitgl_bool)*chunk_count);
+		GL_CHECK( glGenBuffers(chunk_count, map->chunk_vbos) );
+		map->size = size;
+		map->num_chunks = num_chunks;
+	}
+	map->sheet = sheet;
+	memcpy(map->tiles, tiles, sizeof(whitgl_int)*size.x*size.y);
+	whitgl_int i;
+	for(i=0; i<num_chunks.x*num_chunks.y; i++)
+	{
+		map->chunk_vertices[i] = 0;
+		map->chunk_dirty[i] = true;
+	}
+	_whitgl_sys_account_tilemap(map);
+}
+
+void whitgl_sys_set_tilemap_tile(whitgl_int id, whitgl_ivec pos, whitgl_int tile)
+{
+	whitgl_int index = _whitgl_sys_tilemap_index(id);
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find tilemap %d", id);
+		return;
+	}
+	whitgl_tilemap* map = &tilemaps[index];
+	if(pos.x < 0 || pos.y < 0 || pos.x >= map->size.x || pos.y >= map->size.y)
+		return;
+	whitgl_int* existing = &map->tiles[pos.x+pos.y*map->size.x];
+	if(*existing == tile)
+		return;
+	*existing = tile;
+	map->chunk_dirty[pos.x/WHITGL_TILEMAP_CHUNK + (pos.y/WHITGL_TILEMAP_CHUNK)*map->num_chunks.x] = true;
+}
+
+whitgl_int whitgl_sys_get_tilemap_tile(whitgl_int id, whitgl_ivec pos)
+{
+	whitgl_int index = _whitgl_sys_tilemap_index(id);
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find tilemap %d", id);
+		return -1;
+	}
+	whitgl_tilemap* map = &tilemaps[index];
+	if(pos.x < 0 || pos.y < 0 || pos.x >= map->size.x || pos.y >= map->size.y)
+		return -1;
+	return map->tiles[pos.x+pos.y*map->size.x];
+}
+
+void _whitgl_sys_rebuild_tilemap_chunk(whitgl_tilemap* map, whitgl_int image_index, whitgl_ivec chunk)
+{
+	whitgl_ivec image_size = images[image_index].size;
+	whitgl_int columns = whitgl_imax(1, image_size.x/map->sheet.size.x);
+	whitgl_int num_quads = 0;
+	whitgl_ivec tile;
+	for(tile.y = chunk.y*WHITGL_TILEMAP_CHUNK; tile.y < whitgl_imin(map->size.y, (chunk.y+1)*WHITGL_TILEMAP_CHUNK); tile.y++)
+	{
+		for(tile.x = chunk.x*WHITGL_TILEMAP_CHUNK; tile.x < whitgl_imin(map->size.x, (chunk.x+1)*WHITGL_TILEMAP_CHUNK); tile.x++)
+		{
+			whitgl_int value = map->tiles[tile.x+tile.y*map->size.x];
+			if(value < 0)
+				continue;
+			whitgl_ivec frame = {value%columns, value/columns};
+			whitgl_iaabb src;
+			src.a = whitgl_ivec_add(map->sheet.top_left, whitgl_ivec_scale(map->sheet.size, frame));
+			src.b = whitgl_ivec_add(src.a, map->sheet.size);
+			whitgl_iaabb dest;
+			dest.a = whitgl_ivec_scale(tile, map->sheet.size);
+			dest.b = whitgl_ivec_add(dest.a, map->sheet.size);
+			_whitgl_populate_vertices(&tilemap_chunk_buffer[num_quads*6*5], src, dest, image_size);
+			num_quads++;
+		}
+	}
+	whitgl_int chunk_index = chunk.x+chunk.y*map->num_chunks.x;
+	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, map->chunk_vbos[chunk_index] ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, sizeof(float)*num_quads*6*5, tilemap_chunk_buffer, GL_STATIC_DRAW );
+	whitgl_memory_set(WHITGL_MEMORY_TILEMAP, map->id, whitgl_memory_get(WHITGL_MEMORY_TILEMAP, map->id) + (int64_t)sizeof(float)*5*(num_quads*6-map->chunk_vertices[chunk_index]));
+	map->chunk_vertices[chunk_index] = num_quads*6;
+	map->chunk_dirty[chunk_index] = false;
+}
+
+void whitgl_sys_draw_tilemap(whitgl_int id, whitgl_ivec offset)
+{
+	whitgl_int index = _whitgl_sys_tilemap_index(id);
+	if(index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find tilemap %d", id);
+		return;
+	}
+	whitgl_tilemap* map = &tilemaps[index];
+	int image_index = -1;
+	int i;
+	for(i=0; i<num_images; i++)
+	{
+		if(images[i].id == map->sheet.image)
+		{
+			image_index = i;
+			break;
+		}
+	}
+	if(image_index == -1)
+	{
+		WHITGL_PANIC("ERR Cannot find image %d", map->sheet.image);
+		return;
+	}
+	_whitgl_sys_flush_tex_iaabb(WHITGL_FLUSH_PRIMITIVE);
+
+	GL_CHECK( glActiveTexture( GL_TEXTURE0 ) );
+	GL_CHECK( glBindTexture( GL_TEXTURE_2D, images[image_index].gluint ) );
+
+	GLuint shaderProgram = shaders[WHITGL_SHADER_TEXTURE].program;
+	_whitgl_sys_use_program( shaderProgram );
+	GL_CHECK( glUniform1i( glGetUniformLocation( shaderProgram, "tex" ), 0 ) );
+	_whitgl_load_uniforms(WHITGL_SHADER_TEXTURE);
+	_whitgl_sys_orthographic(WHITGL_SHADER_TEXTURE, 0, _setup.size.x, 0, _setup.size.y);
+	// scrolling is a uniform offset, the chunk vertices never move
+	whitgl_fvec3 translate = {offset.x, offset.y, 0};
+	whitgl_fmat m_model = whitgl_fmat_translate(translate);
+	glUniformMatrix4fv( glGetUniformLocation( shaderProgram, "m_model"), 1, GL_FALSE, m_model.mat);
+	GLint posAttrib = glGetAttribLocation( shaderProgram, "position" );
+	GLint texturePosAttrib = glGetAttribLocation( shaderProgram, "texturepos" );
+
+	whitgl_ivec chunk_pixels = whitgl_ivec_scale_val(map->sheet.size, WHITGL_TILEMAP_CHUNK);
+	whitgl_ivec chunk;
+	for(chunk.y=0; chunk.y<map->num_chunks.y; chunk.y++)
+	{
+		for(chunk.x=0; chunk.x<map->num_chunks.x; chunk.x++)
+		{
+			whitgl_iaabb bounds;
+			bounds.a = whitgl_ivec_add(offset, whitgl_ivec_scale(chunk, chunk_pixels));
+			bounds.b = whitgl_ivec_add(bounds.a, chunk_pixels);
+			if(!_whitgl_sys_rect_visible(bounds))
+				continue;
+			whitgl_int chunk_index = chunk.x+chunk.y*map->num_chunks.x;
+			if(map->chunk_dirty[chunk_index])
+				_whitgl_sys_rebuild_tilemap_chunk(map, image_index, chunk);
+			if(map->chunk_vertices[chunk_index] == 0)
+				continue;
+
+			#define BUFFER_OFFSET(i) ((void*)(i))
+			GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, map->chunk_vbos[chunk_index] ) );
+			GL_CHECK( glVertexAttribPointer( posAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), 0 ) );
+			GL_CHECK( glEnableVertexAttribArray( posAttrib ) );
+			GL_CHECK( glVertexAttribPointer( texturePosAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), BUFFER_OFFSET(sizeof(float)*3) ) );
+			GL_CHECK( glEnableVertexAttribArray( texturePosAttrib ) );
+			_whitgl_sys_draw_arrays( GL_TRIANGLES, 0, map->chunk_vertices[chunk_index] );
+		}
+	}
+}
+
 bool whitgl_sys_load_png(const char *name, whitgl_int *width, whitgl_int *height, unsigned char **data)
 {
 	png_image image;
@@ -1275,6 +2645,8 @@ void whitgl_sys_add_image_from_data(int id, whitgl_ivec size, unsigned char* dat
 	GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x,
 				 size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
 				 data) );
+	frame_stats.upload_bytes += size.x*size.y*4;
+	whitgl_memory_set(WHITGL_MEMORY_TEXTURE, id, (int64_t)size.x*size.y*4);
 
 	images[num_images].id = id;
 	num_images++;
@@ -1324,6 +2696,7 @@ void whitgl_sys_update_image_from_data(int id, whitgl_ivec size, unsigned char*
 	GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x,
 				 size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
 				 data) );
+	frame_stats.upload_bytes += size.x*size.y*4;
 }
 
 void whitgl_sys_add_image(int id, const char* filename)
@@ -1336,8 +2709,10 @@ void whitgl_sys_add_image(int id, const char* filename)
 	{
 		WHITGL_PANIC("loadPngImage error");
 	}
+	whitgl_memory_set(WHITGL_MEMORY_DECODE, id, (int64_t)size.x*size.y*4);
 	whitgl_sys_add_image_from_data(id, size, textureImage);
 	free(textureImage);
+	whitgl_memory_release(WHITGL_MEMORY_DECODE, id);
 }
 
 whitgl_bool whitgl_load_model(whitgl_int id, const char* filename)
@@ -1373,8 +2748,10 @@ whitgl_bool whitgl_load_model(whitgl_int id, const char* filename)
 	{
 		WHITGL_LOG("Failed to read object from %s", filename);
 		fclose(src);
+		free(data);
 		return false;
 	}
+	whitgl_memory_set(WHITGL_MEMORY_DECODE, id, readSize);
 	WHITGL_LOG("Loaded data from %s", filename);
 	fclose(src);
 
@@ -1382,6 +2759,7 @@ whitgl_bool whitgl_load_model(whitgl_int id, const char* filename)
 
 	whitgl_sys_update_model_from_data(id, num_vertices, (char*)data);
 	free(data);
+	whitgl_memory_release(WHITGL_MEMORY_DECODE, id);
 	return true;
 }
 
@@ -1419,9 +2797,34 @@ void whitgl_sys_update_model_from_data(int id, whitgl_int num_vertices, const ch
 	}
 	models[index].num_vertices = num_vertices;
 
+	// bounding sphere for culling, around the centre of the vertex AABB
+	const float* floats = (const float*)data;
+	whitgl_fvec3 min = whitgl_fvec3_val(whitgl_float_max);
+	whitgl_fvec3 max = whitgl_fvec3_val(-whitgl_float_max);
+	for(i=0; i<num_vertices; i++)
+	{
+		const float* p = &floats[i*11];
+		min.x = whitgl_fmin(min.x, p[0]); min.y = whitgl_fmin(min.y, p[1]); min.z = whitgl_fmin(min.z, p[2]);
+		max.x = whitgl_fmax(max.x, p[0]); max.y = whitgl_fmax(max.y, p[1]); max.z = whitgl_fmax(max.z, p[2]);
+	}
+	models[index].bounds_center = whitgl_fvec3_zero;
+	models[index].bounds_radius = 0;
+	if(num_vertices > 0)
+		models[index].bounds_center = whitgl_fvec3_scale_val(whitgl_fvec3_add(min, max), 0.5);
+	for(i=0; i<num_vertices; i++)
+	{
+		const float* p = &floats[i*11];
+		whitgl_fvec3 v = {p[0], p[1], p[2]};
+		whitgl_float sqdistance = whitgl_fvec3_sqmagnitude(whitgl_fvec3_sub(v, models[index].bounds_center));
+		models[index].bounds_radius = whitgl_fmax(models[index].bounds_radius, sqdistance);
+	}
+	models[index].bounds_radius = whitgl_fsqrt(models[index].bounds_radius);
+
 
 	GL_CHECK( glBindBuffer( GL_ARRAY_BUFFER, models[index].vbo ) );
-	GL_CHECK( glBufferData( GL_ARRAY_BUFFER, 4*11*num_vertices, data, GL_DYNAMIC_DRAW ) );
+	_whitgl_sys_buffer_data( GL_ARRAY_BUFFER, 4*11*num_vertices, data, GL_DYNAMIC_DRAW );
+	// glBufferData reallocates, so the store is sized to this upload rather than max_vertices
+	whitgl_memory_set(WHITGL_MEMORY_MODEL, id, (int64_t)4*11*num_vertices);
 }
 
 whitgl_ivec whitgl_sys_get_image_size(whitgl_int id)
@@ -1444,7 +2847,7 @@ whitgl_ivec whitgl_sys_get_image_size(whitgl_int id)
 	return images[index].size;
 }
 
-whitgl_float whitgl_sys_get_time()
+double whitgl_sys_get_time()
 {
 	return glfwGetTime();
 }
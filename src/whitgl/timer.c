@@ -2,8 +2,8 @@
 #include <whitgl/timer.h>
 #include <whitgl/sys.h>
 
-whitgl_float _whitgl_timer_now;
-whitgl_float _whitgl_timer_then;
+double _whitgl_timer_now;
+double _whitgl_timer_then;
 whitgl_float _whitgl_timer_dt;
 whitgl_int _whitgl_timer_frames;
 whitgl_float _whitgl_timer_fps_timer;
@@ -73,3 +73,70 @@ void whitgl_timer_sleep(whitgl_float seconds) // cross-platform sleep function
     nanosleep(&ts, NULL);
 #endif
 }
+
+// Sleep until just short of the deadline, then spin the rest. The part
+// left to spin is the sleep overshoot seen so far plus a small margin.
+#define WHITGL_PACER_SPIN_MARGIN (0.0002)
+whitgl_float _whitgl_pacer_period;
+double _whitgl_pacer_deadline;
+whitgl_float _whitgl_pacer_overshoot;
+whitgl_float _whitgl_pacer_lateness;
+whitgl_int _whitgl_pacer_missed;
+
+void whitgl_timer_pacer_init(whitgl_float period)
+{
+	_whitgl_pacer_period = period;
+	_whitgl_pacer_deadline = whitgl_sys_get_time() + period;
+	_whitgl_pacer_overshoot = 0.001;
+	_whitgl_pacer_lateness = 0;
+	_whitgl_pacer_missed = 0;
+}
+void whitgl_timer_pacer_set_period(whitgl_float period)
+{
+	_whitgl_pacer_deadline += period - _whitgl_pacer_period;
+	_whitgl_pacer_period = period;
+}
+whitgl_float whitgl_timer_pacer_wait()
+{
+	double now = whitgl_sys_get_time();
+	if(now < _whitgl_pacer_deadline)
+	{
+		whitgl_float sleep_for = _whitgl_pacer_deadline - now - _whitgl_pacer_overshoot - WHITGL_PACER_SPIN_MARGIN;
+		if(sleep_for > 0)
+		{
+			whitgl_timer_sleep(sleep_for);
+			double woke = whitgl_sys_get_time();
+			whitgl_float overshoot = whitgl_fmax(0, (woke-now) - sleep_for);
+			// rise quickly after a long oversleep, fall back slowly
+			if(overshoot > _whitgl_pacer_overshoot)
+				_whitgl_pacer_overshoot = overshoot;
+			else
+				_whitgl_pacer_overshoot = _whitgl_pacer_overshoot*0.95 + overshoot*0.05;
+		}
+		do
+		{
+			now = whitgl_sys_get_time();
+		} while(now < _whitgl_pacer_deadline);
+	} else
+	{
+		_whitgl_pacer_missed++;
+	}
+	_whitgl_pacer_lateness = now - _whitgl_pacer_deadline;
+	_whitgl_pacer_deadline += _whitgl_pacer_period;
+	// more than a whole frame behind, start again from now rather than catching up
+	if(_whitgl_pacer_deadline < now)
+		_whitgl_pacer_deadline = now + _whitgl_pacer_period;
+	return _whitgl_pacer_lateness;
+}
+whitgl_float whitgl_timer_pacer_budget()
+{
+	return _whitgl_pacer_deadline - whitgl_sys_get_time();
+}
+whitgl_float whitgl_timer_pacer_lateness()
+{
+	return _whitgl_pacer_lateness;
+}
+whitgl_int whitgl_timer_pacer_missed()
+{
+	return _whitgl_pacer_missed;
+}